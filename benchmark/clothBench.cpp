@@ -0,0 +1,471 @@
+// Headless cloth simulation benchmark
+// Runs the standard scenes from ClothScenes.hpp for a fixed number of steps and prints one JSON
+// document (steps/sec, ns per particle step, per phase breakdown, memory) for the perf dashboard.
+//
+// usage: clothBench [options], every flag is optional (README.md has the details):
+//   --scene NAME             hanging|sphere|bunny|grid|flag|banner|curtain|patchwork|all (default all)
+//   --steps N                timed steps per scene
+//   --grid N                 resolution of the grid scene
+//   --resources DIR          models and sidecars, default ../resources
+//   --out FILE               also write the JSON there
+//   --trace FILE             chrome trace of the cpu zones
+//   --threads N              solver threads
+//   --deterministic          reproducible mode, the checksum has to match across runs and --threads
+//   --check-allocations      fail if the steady state steps allocate (stepAllocations is always reported)
+//   --cache DIR              bake every scene into DIR/<scene>.ccache, report size and ratio
+//   --export DIR             write every timed step as DIR/<scene>_NNNNN.obj, --export-format obj|ply
+//   --contact-reuse F        SolverParams::contactReuse, 0 queries the colliders every substep
+//   --friction F             SolverParams::frictionScale, 0 = frictionless colliders
+//   --tear S                 tear past strain S (ClothTearing.hpp)
+//   --remesh N               remesh every N steps (ClothRemesh.hpp), not with --cache/--export/--tear
+//   --lod N                  N simulation levels on a flying camera (ClothLod.hpp), not with --tear/--remesh
+//   --embed K                render mesh subdivided K times, deformed every step (ClothEmbedding.hpp)
+//   --mesh-cache DIR         keep parsed OBJ files and --embed embeddings between runs
+//   --strain-limit W[,F[,N]] warp/weft strain limits in N passes per substep (ClothStrainLimit.hpp)
+//   --substeps N             SolverParams::substeps, to compare against limits and elements
+//   --fem E[,NU]             StVK triangle elements instead of stretch springs (ClothFem.hpp)
+// --strain-limit and --fem need uvs, so neither combines with --remesh. Every scene reports maxWarpStrain,
+// maxWeftStrain and meanStrain (mean |strain| over triangles and timed steps, measured outside the timing).
+
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include "AllocationCounter.hpp"
+#include "ClothEmbedding.hpp"
+#include "ClothLod.hpp"
+#include "ClothScenes.hpp"
+#include "ClothRemesh.hpp"
+#include "ClothSolver.hpp"
+#include "ClothTearing.hpp"
+#include "CpuProfiler.hpp"
+#include "JobSystem.hpp"
+#include "MeshExport.hpp"
+#include "SimCache.hpp"
+#include "SolverSnapshot.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// peak resident set size of the whole process so far; it never goes down, so it's reported once for the run
+// (processPeakRssBytes) and solverBytes is the per scene figure
+static uint64_t processPeakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+struct BenchOptions {
+    std::vector<std::string> scenes = standardSceneNames();
+    uint32_t steps = 600;
+    uint32_t warmupSteps = 30;
+    uint32_t threads = 1;       // 1 = solver runs on the main thread only
+    bool deterministic = false;
+    bool checkAllocations = false;
+    uint32_t allocationSteps = 20;
+    float tearStrain = 0.0f;    // 0 = no tearing
+    uint32_t remeshInterval = 0; // 0 = no remeshing
+    uint32_t lodLevels = 0;      // 0 or 1 = no simulation lods
+    uint32_t embedLevels = 0;    // subdivisions of the render mesh, 0 = no render embedding
+    bool strainLimit = false;
+    StrainLimitSettings strainLimits;
+    bool fem = false;
+    FemSettings femSettings;
+    std::string cacheDir;
+    std::string exportDir;
+    ExportFormat exportFormat = ExportFormat::OBJ;
+    std::string outFile;
+    std::string traceFile;
+    SceneOptions scene;
+};
+
+// pixels a full resolution edge covers for the --lod camera: 16 at the first and last timed step, 0.5 halfway,
+// moving geometrically so every doubling of the distance takes as long (scenes differ in size, so the flight
+// is in edges on screen rather than meters)
+static float lodCameraEdgePixels(uint32_t step, uint32_t steps) {
+    float t = steps > 1 ? static_cast<float>(step) / (steps - 1) : 0.0f;
+    return 16.0f / std::pow(32.0f, 1.0f - std::abs(2.0f * t - 1.0f));
+}
+
+static std::string runScene(const std::string& name, const BenchOptions& options, JobSystem* jobs) {
+    ClothSolver solver;
+    SceneOptions sceneOptions = options.scene;
+    sceneOptions.params.deterministic = options.deterministic;
+    ClothMesh cloth = buildScene(name, sceneOptions, solver);
+    solver.jobs = jobs;
+
+    // the limits go on before tearing adds its spare particles; the probe measures strain either way
+    StrainLimits strainProbe;
+    strainProbe.build(cloth, options.strainLimits);
+    if (options.strainLimit) {
+        if (options.remeshInterval > 0) { throw std::runtime_error("--strain-limit can't be combined with --remesh!"); }
+        solver.setStrainLimits(cloth, options.strainLimits);
+    }
+    if (options.fem) {
+        if (options.remeshInterval > 0) { throw std::runtime_error("--fem can't be combined with --remesh!"); }
+        solver.setElements(cloth, options.femSettings);
+    }
+
+    ClothTearing tearing;
+    bool tearingOn = options.tearStrain > 0.0f;
+    if (tearingOn) {
+        TearSettings tearSettings;
+        tearSettings.strain = options.tearStrain;
+        tearing.attach(solver, tearSettings);
+    }
+    ClothRemesher remesher;
+    bool remeshing = options.remeshInterval > 0;
+    if (remeshing) {
+        if (tearingOn || !options.cacheDir.empty() || !options.exportDir.empty()) {
+            throw std::runtime_error("--remesh changes the particle count, it can't be combined with --tear, --cache or --export!");
+        }
+        remesher.attach(solver, RemeshSettings{});
+    }
+    ClothLod lod;
+    bool lodOn = options.lodLevels > 1;
+    if (lodOn) {
+        if (tearingOn || remeshing) {
+            throw std::runtime_error("--lod can't be combined with --tear or --remesh!");
+        }
+        LodSettings lodSettings;
+        lodSettings.levels = options.lodLevels;
+        lod.attach(solver, lodSettings);
+    }
+    RenderEmbedding embedding;
+    bool embeddingOn = options.embedLevels > 0;
+    std::vector<float> renderX, renderY, renderZ;
+    double embedBuildMs = 0.0;
+    bool embedCached = false;
+    if (embeddingOn) {
+        if (tearingOn || remeshing) {
+            throw std::runtime_error("--embed needs a fixed simulation mesh, it can't be combined with --tear or --remesh!");
+        }
+        ClothMesh renderMesh = cloth;
+        for (uint32_t k = 0; k < options.embedLevels; k++) { renderMesh = subdivideMesh(renderMesh); }
+        std::vector<glm::vec3> rest(solver.particles.size());
+        for (size_t i = 0; i < rest.size(); i++) { rest[i] = solver.particles.position(i); }
+        std::vector<uint32_t> indices;
+        solver.triangles.indices(indices);
+        int64_t buildStart = CpuProfiler::nowNs();
+        embedCached = embedding.buildCached(renderMesh.positions, rest, indices, options.scene.meshCacheDir,
+            name + "_x" + std::to_string(options.embedLevels), jobs);
+        embedBuildMs = (CpuProfiler::nowNs() - buildStart) * 1e-6;
+        for (auto* v : { &renderX, &renderY, &renderZ }) { v->resize(embedding.size()); }
+    }
+    int64_t tearNs = 0, tearMaxNs = 0, remeshNs = 0, remeshMaxNs = 0, embedNs = 0;
+    uint32_t remeshes = 0, splits = 0, collapses = 0;
+    auto advance = [&] {
+        if (lodOn) { lod.step(solver); }
+        else { solver.step(); }
+        if (remeshing && solver.stats.steps % options.remeshInterval == 0) {
+            const RemeshStats& r = remesher.remesh(solver);
+            remeshNs += r.ns;
+            remeshMaxNs = std::max(remeshMaxNs, r.ns);
+            remeshes++;
+            splits += r.splits;
+            collapses += r.collapses;
+        }
+        if (embeddingOn) {
+            int64_t embedStart = CpuProfiler::nowNs();
+            embedding.deform(solver, renderX.data(), renderY.data(), renderZ.data());
+            embedNs += CpuProfiler::nowNs() - embedStart;
+        }
+        if (!tearingOn) { return; }
+        int64_t tearStart = CpuProfiler::nowNs();
+        tearing.update(solver);
+        int64_t ns = CpuProfiler::nowNs() - tearStart;
+        tearNs += ns;
+        tearMaxNs = std::max(tearMaxNs, ns);
+    };
+
+    // a few untimed steps so first touch page faults and cold caches don't skew short runs
+    for (uint32_t i = 0; i < options.warmupSteps; i++) { advance(); }
+    solver.stats.reset();
+    tearNs = tearMaxNs = remeshNs = remeshMaxNs = embedNs = 0;
+    remeshes = splits = collapses = 0;
+    uint64_t tearsBefore = tearing.totalTears();
+
+    CacheWriter cache;
+    bool baking = !options.cacheDir.empty();
+    if (baking) {
+        cache.open(options.cacheDir + "/" + name + ".ccache", static_cast<uint32_t>(solver.particles.size()), solver.params.timeStep);
+    }
+
+    FrameExporter exporter;
+    bool exporting = !options.exportDir.empty();
+    if (exporting) {
+        ExportSettings settings;
+        settings.format = options.exportFormat;
+        settings.prefix = name;
+        exporter.open(options.exportDir, cloth, settings);
+    }
+
+    uint64_t switchesBefore = lod.switchCount();
+    int64_t transferBefore = lod.transferTimeNs();
+    double simulatedParticles = 0.0;
+    float maxWarpStrain = 0.0f, maxWeftStrain = 0.0f;
+    double meanStrain = 0.0;
+    int64_t measureNs = 0;
+    int64_t start = CpuProfiler::nowNs();
+    for (uint32_t i = 0; i < options.steps; i++) {
+        if (lodOn) { lod.select(solver, lodCameraEdgePixels(i, options.steps) / lod.levelEdge(0)); }
+        simulatedParticles += lodOn ? lod.simulatedParticles(solver) : solver.particles.size();
+        advance();
+        if (baking) { cache.addFrame(solver.particles); }
+        if (exporting) { exporter.addFrame(solver.particles); }
+        if (!remeshing) {
+            int64_t measureStart = CpuProfiler::nowNs();
+            float warp, weft, mean;
+            const ParticleStore& p = solver.particles;
+            strainProbe.measure(p.x.data(), p.y.data(), p.z.data(), solver.triangles.a.data(), solver.triangles.b.data(),
+                solver.triangles.c.data(), warp, weft, mean);
+            maxWarpStrain = std::max(maxWarpStrain, warp);
+            maxWeftStrain = std::max(maxWeftStrain, weft);
+            meanStrain += mean / options.steps;
+            measureNs += CpuProfiler::nowNs() - measureStart;
+        }
+    }
+    int64_t elapsedNs = CpuProfiler::nowNs() - start - measureNs;
+    cache.close();
+    const CacheWriter::Stats& c = cache.getStats();
+    int64_t exportStart = CpuProfiler::nowNs();
+    exporter.close();
+    int64_t exportDrainNs = CpuProfiler::nowNs() - exportStart; // frames still queued when the sim finished
+    FrameExporter::Stats e = exporter.getStats();
+
+    SolverStats s = solver.stats;
+    uint64_t tears = tearing.totalTears() - tearsBefore;
+    double tearMeanUs = tearNs * 1e-3 / options.steps, tearMaxUs = tearMaxNs * 1e-3;
+    double remeshMeanUs = remeshes ? remeshNs * 1e-3 / remeshes : 0.0, remeshMaxUs = remeshMaxNs * 1e-3;
+    double embedUsPerStep = embedNs * 1e-3 / options.steps;
+    double embedVerticesPerSecond = embedNs ? double(embedding.size()) * options.steps * 1e9 / embedNs : 0.0;
+    remeshing = false; // remeshing reallocates by design, steady state is what runs between remeshes
+    uint64_t lodSwitches = lod.switchCount() - switchesBefore;
+    double lodTransferUs = lodSwitches ? (lod.transferTimeNs() - transferBefore) * 1e-3 / lodSwitches : 0.0;
+    if (lodOn) {
+        lod.setLevel(solver, 0); // the camera is back close by anyway, the snapshot replay runs on level 0
+        lodOn = false;
+    }
+
+    // steady state has to run without touching the heap; writers are closed, so anything counted here
+    // happened inside step()
+    AllocationCounter::Scope allocationScope;
+    for (uint32_t i = 0; i < options.allocationSteps; i++) { advance(); }
+    uint64_t stepAllocations = allocationScope.count();
+    if (options.checkAllocations && stepAllocations != 0) {
+        throw std::runtime_error("scene " + name + " allocated " + std::to_string(stepAllocations) + " times in " +
+            std::to_string(options.allocationSteps) + " steady state steps!");
+    }
+
+    // snapshot round trip of the final state; in deterministic mode the steps after a restore have to
+    // reproduce the steps taken right after the capture bit for bit (without tearing, a snapshot only restores
+    // onto the topology it was taken from)
+    SolverSnapshot snapshot;
+    int64_t captureStart = CpuProfiler::nowNs();
+    captureSnapshot(solver, snapshot);
+    int64_t captureNs = CpuProfiler::nowNs() - captureStart;
+    const uint32_t replaySteps = 10;
+    for (uint32_t i = 0; i < replaySteps; i++) { solver.step(); }
+    uint64_t expected = solver.stats.checksum;
+    int64_t restoreStart = CpuProfiler::nowNs();
+    restoreSnapshot(solver, snapshot);
+    int64_t restoreNs = CpuProfiler::nowNs() - restoreStart;
+    for (uint32_t i = 0; i < replaySteps; i++) { solver.step(); }
+    if (options.deterministic && solver.stats.checksum != expected) {
+        throw std::runtime_error("snapshot replay of scene " + name + " diverged!");
+    }
+    double seconds = elapsedNs * 1e-9;
+    double steps = static_cast<double>(s.steps);
+    size_t particles = solver.particles.size();
+
+    char buffer[4096];
+    std::snprintf(buffer, sizeof(buffer),
+        "    {\"scene\": \"%s\", \"particles\": %zu, \"triangles\": %zu, \"constraints\": %zu, \"substeps\": %u,\n"
+        "     \"steps\": %u, \"seconds\": %.6f, \"stepsPerSecond\": %.3f, \"nsPerParticleStep\": %.3f,\n"
+        "     \"phasesNsPerStep\": {\"integrate\": %.1f, \"constraints\": %.1f, \"collisions\": %.1f, \"velocities\": %.1f, \"aero\": %.1f, \"strainLimit\": %.1f},\n"
+        "     \"threads\": %u, \"deterministic\": %s, \"kineticEnergy\": %.9g, \"checksum\": \"%016llx\",\n"
+        "     \"snapshotBytes\": %zu, \"snapshotCaptureUs\": %.1f, \"snapshotRestoreUs\": %.1f,\n"
+        "     \"cacheBytesPerFrame\": %.1f, \"cacheRatio\": %.2f, \"cacheEncodeUsPerFrame\": %.1f, \"cacheMaxQueued\": %zu,\n"
+        "     \"exportFrames\": %llu, \"exportBytesPerFrame\": %.0f, \"exportFormatMsPerFrame\": %.3f, \"exportWriteMsPerFrame\": %.3f,\n"
+        "     \"exportStalls\": %llu, \"exportDrainMs\": %.1f,\n"
+        "     \"contactsPerStep\": %.1f, \"contactQueriesPerStep\": %.1f, \"contactReuseRate\": %.3f,\n"
+        "     \"contactsPerSecond\": %.4g, \"tears\": %llu, \"tearMeanUs\": %.1f, \"tearMaxUs\": %.1f,\n"
+        "     \"remeshes\": %u, \"remeshMeanUs\": %.1f, \"remeshMaxUs\": %.1f, \"remeshSplits\": %u, \"remeshCollapses\": %u,\n"
+        "     \"renderVertices\": %zu, \"embedBuildMs\": %.1f, \"embedCached\": %s, \"embedUsPerStep\": %.1f, \"embedVerticesPerSecond\": %.4g,\n"
+        "     \"lodLevels\": %u, \"sceneParticles\": %zu, \"simulatedParticles\": %.1f, \"lodSwitches\": %llu, \"lodTransferUs\": %.1f,\n"
+        "     \"pinGroups\": %zu, \"kinematicParticles\": %zu,\n"
+        "     \"fem\": %s, \"strainLimit\": %s, \"maxWarpStrain\": %.4f, \"maxWeftStrain\": %.4f, \"meanStrain\": %.5f, \"strainLimitedPerStep\": %.1f,\n"
+        "     \"stepAllocations\": %llu, \"solverBytes\": %zu}",
+        name.c_str(), particles, solver.triangles.size(), solver.constraintCount(), solver.params.substeps,
+        options.steps, seconds, steps / seconds, elapsedNs / (steps * particles),
+        s.integrateNs / steps, s.constraintNs / steps, s.collisionNs / steps, s.velocityNs / steps, s.aeroNs / steps, s.strainLimitNs / steps,
+        jobs ? jobs->threadCount() : 1u, options.deterministic ? "true" : "false", s.kineticEnergy,
+        static_cast<unsigned long long>(s.checksum), snapshot.size(), captureNs * 1e-3, restoreNs * 1e-3,
+        c.bytesPerFrame(), c.ratio(), c.frames ? c.encodeNs * 1e-3 / c.frames : 0.0, c.maxQueued,
+        static_cast<unsigned long long>(e.frames), e.frames ? double(e.bytes) / e.frames : 0.0,
+        e.frames ? e.formatNs * 1e-6 / e.frames : 0.0, e.frames ? e.writeNs * 1e-6 / e.frames : 0.0,
+        static_cast<unsigned long long>(e.stalls), exportDrainNs * 1e-6,
+        s.contacts / steps, s.contactQueries / steps,
+        s.contactQueries + s.contactReuses ? double(s.contactReuses) / (s.contactQueries + s.contactReuses) : 0.0,
+        s.collisionNs ? s.contacts * 1e9 / s.collisionNs : 0.0,
+        static_cast<unsigned long long>(tears), tearMeanUs, tearMaxUs,
+        remeshes, remeshMeanUs, remeshMaxUs, splits, collapses,
+        embedding.size(), embedBuildMs, embedCached ? "true" : "false", embedUsPerStep, embedVerticesPerSecond,
+        lod.levelCount(), particles, simulatedParticles / options.steps, static_cast<unsigned long long>(lodSwitches), lodTransferUs,
+        solver.pins ? solver.pins->groups.size() : 0, solver.pins ? solver.pins->kinematicCount() : 0,
+        solver.elements ? "true" : "false", solver.strainLimits ? "true" : "false", maxWarpStrain, maxWeftStrain, meanStrain, s.strainLimited / steps,
+        static_cast<unsigned long long>(stepAllocations), solver.memoryBytes() + lod.memoryBytes() + embedding.memoryBytes());
+    return buffer;
+}
+
+// contacts/second of ContactBatch::solveFriction on 64k random contacts, about half of them sticking
+double measureFrictionKernel() {
+    const size_t count = 64 * 1024;
+    const int passes = 200;
+    FrameArena arena;
+    ContactBatch batch;
+    batch.allocate(arena, count, count);
+    std::vector<float> slip(count * 3);
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (size_t k = 0; k < count; k++) {
+        glm::vec3 n = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        batch.nx[k] = n.x;
+        batch.ny[k] = n.y;
+        batch.nz[k] = n.z;
+        batch.depth[k] = 0.01f * (uniform(random) + 1.0f);
+        batch.staticFriction[k] = 0.5f;
+        batch.kineticFriction[k] = 0.4f;
+        for (int axis = 0; axis < 3; axis++) { slip[3 * k + axis] = 0.01f * uniform(random); }
+    }
+
+    int64_t ns = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t k = 0; k < count; k++) {
+            batch.dx[k] = slip[3 * k];
+            batch.dy[k] = slip[3 * k + 1];
+            batch.dz[k] = slip[3 * k + 2];
+        }
+        int64_t start = CpuProfiler::nowNs();
+        batch.solveFriction(0, count);
+        ns += CpuProfiler::nowNs() - start;
+    }
+    return ns ? double(count) * passes * 1e9 / ns : 0.0;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--scene" && hasValue) {
+                std::string scene = argv[++i];
+                if (scene != "all") { options.scenes = { scene }; }
+            }
+            else if (arg == "--steps" && hasValue) { options.steps = static_cast<uint32_t>(std::stoul(argv[++i])); }
+            else if (arg == "--grid" && hasValue) { options.scene.gridResolution = static_cast<uint32_t>(std::stoul(argv[++i])); }
+            else if (arg == "--resources" && hasValue) { options.scene.resourceDir = argv[++i]; }
+            else if (arg == "--out" && hasValue) { options.outFile = argv[++i]; }
+            else if (arg == "--trace" && hasValue) { options.traceFile = argv[++i]; }
+            else if (arg == "--threads" && hasValue) { options.threads = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i]))); }
+            else if (arg == "--deterministic") { options.deterministic = true; }
+            else if (arg == "--check-allocations") { options.checkAllocations = true; }
+            else if (arg == "--contact-reuse" && hasValue) { options.scene.params.contactReuse = std::stof(argv[++i]); }
+            else if (arg == "--friction" && hasValue) { options.scene.params.frictionScale = std::stof(argv[++i]); }
+            else if (arg == "--tear" && hasValue) { options.tearStrain = std::stof(argv[++i]); }
+            else if (arg == "--remesh" && hasValue) { options.remeshInterval = static_cast<uint32_t>(std::stoul(argv[++i])); }
+            else if (arg == "--lod" && hasValue) { options.lodLevels = static_cast<uint32_t>(std::stoul(argv[++i])); }
+            else if (arg == "--embed" && hasValue) { options.embedLevels = static_cast<uint32_t>(std::stoul(argv[++i])); }
+            else if (arg == "--mesh-cache" && hasValue) { options.scene.meshCacheDir = argv[++i]; }
+            else if (arg == "--substeps" && hasValue) { options.scene.params.substeps = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i]))); }
+            else if (arg == "--fem" && hasValue) {
+                // E[,NU]
+                std::string fem = argv[++i];
+                size_t comma = fem.find(',');
+                options.fem = true;
+                options.femSettings.youngsModulus = std::stof(fem.substr(0, comma));
+                if (comma != std::string::npos) { options.femSettings.poissonRatio = std::stof(fem.substr(comma + 1)); }
+            }
+            else if (arg == "--strain-limit" && hasValue) {
+                // W[,F[,N]]
+                std::istringstream limits(argv[++i]);
+                std::string value;
+                options.strainLimit = true;
+                for (int field = 0; field < 3 && std::getline(limits, value, ','); field++) {
+                    if (field == 0) { options.strainLimits.warp = options.strainLimits.weft = std::stof(value); }
+                    else if (field == 1) { options.strainLimits.weft = std::stof(value); }
+                    else { options.strainLimits.iterations = std::max(1u, static_cast<uint32_t>(std::stoul(value))); }
+                }
+            }
+            else if (arg == "--cache" && hasValue) { options.cacheDir = argv[++i]; }
+            else if (arg == "--export" && hasValue) { options.exportDir = argv[++i]; }
+            else if (arg == "--export-format" && hasValue) {
+                std::string format = argv[++i];
+                if (format != "obj" && format != "ply") { throw std::runtime_error("unknown export format: " + format); }
+                options.exportFormat = format == "obj" ? ExportFormat::OBJ : ExportFormat::PLY;
+            }
+            else {
+                throw std::runtime_error("unknown argument: " + arg);
+            }
+        }
+
+        CpuProfiler::setEnabled(!options.traceFile.empty());
+
+        std::unique_ptr<JobSystem> jobs;
+        if (options.threads > 1) {
+            jobs.reset(new JobSystem(options.threads - 1));
+        }
+
+        std::ostringstream json;
+        json << "{\n  \"benchmark\": \"vulkanClothSim\",\n  \"gridResolution\": " << options.scene.gridResolution
+             << ",\n  \"frictionContactsPerSecond\": " << measureFrictionKernel() << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < options.scenes.size(); i++) {
+            json << runScene(options.scenes[i], options, jobs.get()) << (i + 1 < options.scenes.size() ? ",\n" : "\n");
+        }
+        json << "  ],\n  \"processPeakRssBytes\": " << processPeakRssBytes() << "\n}\n";
+
+        std::cout << json.str();
+        if (!options.outFile.empty()) {
+            std::ofstream(options.outFile) << json.str();
+        }
+        if (!options.traceFile.empty()) {
+            CpuProfiler::instance().writeChromeTrace(options.traceFile);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+// Parameter sweep batch runner
+// Runs every parameter combination of a sweep spec (format in ClothSweep.hpp) and writes a CSV summary
+// with one row per run.
+//
+// usage: clothSweep SPEC [--workers N] [--resources DIR] [--mesh-cache DIR] [--out summary.csv] [--trace trace.json]
+//        clothSweep SPEC --serve [HOST:]PORT [--checkpoint FILE] [--lease-seconds S] [...]
+//        clothSweep --connect [HOST:]PORT [--resources DIR] [--mesh-cache DIR]
+//
+// The first form runs all runs in this process, one simulation per worker thread (--workers defaults to
+// one per hardware thread). --serve makes this process the coordinator of a distributed sweep
+// (SweepCluster.hpp): it runs nothing itself and hands runs to the --connect worker processes, start one
+// per core on each box. Throughput (sims/hour) goes to stderr so stdout can be redirected into a CSV file.
+
+#include "ClothSweep.hpp"
+#include "CpuProfiler.hpp"
+#include "SweepCluster.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+    std::string specFile;
+    std::string resourceDir;
+    std::string meshCacheDir;
+    std::string outFile;
+    std::string traceFile;
+    std::string connectAddress;
+    SweepCoordinatorSettings coordinator;
+    bool serving = false;
+    uint32_t workers = 0;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--workers" && hasValue) { workers = static_cast<uint32_t>(std::stoul(argv[++i])); }
+            else if (arg == "--resources" && hasValue) { resourceDir = argv[++i]; }
+            else if (arg == "--mesh-cache" && hasValue) { meshCacheDir = argv[++i]; }
+            else if (arg == "--out" && hasValue) { outFile = argv[++i]; }
+            else if (arg == "--trace" && hasValue) { traceFile = argv[++i]; }
+            else if (arg == "--serve" && hasValue) { serving = true; coordinator.address = argv[++i]; }
+            else if (arg == "--checkpoint" && hasValue) { coordinator.checkpointFile = argv[++i]; }
+            else if (arg == "--lease-seconds" && hasValue) { coordinator.leaseSeconds = std::stod(argv[++i]); }
+            else if (arg == "--connect" && hasValue) { connectAddress = argv[++i]; }
+            else if (specFile.empty() && arg.rfind("--", 0) != 0) { specFile = arg; }
+            else {
+                throw std::runtime_error("unknown argument: " + arg);
+            }
+        }
+
+        CpuProfiler::setEnabled(!traceFile.empty());
+
+        if (!connectAddress.empty()) {
+            SweepWorkerSettings settings;
+            settings.address = connectAddress;
+            settings.resourceDir = resourceDir;
+            settings.meshCacheDir = meshCacheDir;
+            SweepWorkerStats stats = runSweepWorker(settings);
+            std::fprintf(stderr, "worker: %zu runs, setup %.2f s, runs %.2f s\n", stats.runs, stats.setupSeconds, stats.seconds);
+        }
+        else {
+            if (specFile.empty()) {
+                throw std::runtime_error("usage: clothSweep SPEC [--workers N | --serve [HOST:]PORT] or clothSweep --connect [HOST:]PORT");
+            }
+            std::string specText;
+            SweepSpec spec = loadSweepSpec(specFile, &specText);
+            if (!resourceDir.empty()) { spec.sceneOptions.resourceDir = resourceDir; }
+            spec.sceneOptions.meshCacheDir = meshCacheDir;
+
+            SweepStats stats;
+            std::vector<SweepResult> results = serving ?
+                SweepCoordinator().run(spec, specText, coordinator, stats) :
+                runSweep(spec, workers, stats);
+
+            if (outFile.empty()) {
+                writeSweepTable(std::cout, spec, results);
+            }
+            else {
+                std::ofstream out(outFile);
+                writeSweepTable(out, spec, results);
+            }
+            std::fprintf(stderr, "%s: %zu runs x %u steps on %u workers, setup %.2f s, runs %.2f s, %.0f sims/hour\n",
+                spec.scene.c_str(), stats.runs, spec.steps, stats.workers, stats.setupSeconds, stats.seconds, stats.simsPerHour());
+        }
+
+        if (!traceFile.empty()) {
+            CpuProfiler::instance().writeChromeTrace(traceFile);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+// CachePlayer playback test
+// Bakes tiny caches whose frame count isn't a multiple of the player's slot count, so the decode window wraps
+// past the last frame onto frame 0, and checks that
+// - every frame handed out holds that frame's positions, also when read over and over while paused
+// - a paused player stops decoding once its window is ready (no slot ping-pong between two frames)
+// - looping playback sees every frame intact
+//
+// build: g++ -std=c++20 -O2 -pthread -Iext -IvulkanClothSim tests/cachePlayerTest.cpp -o cachePlayerTest
+// run: cachePlayerTest (writes its caches to the temp directory), exits nonzero on the first failure
+
+#include "CachePlayer.hpp"
+#include "SimCache.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+static const uint32_t PARTICLES = 64;
+
+// particle i of frame f sits at (f, i / 1000, -f)
+static void bakeCache(const std::string& filename, uint32_t frames) {
+    CacheSettings settings;
+    settings.keyframeInterval = 3;
+    CacheWriter writer;
+    writer.open(filename, PARTICLES, 1.0f / 60.0f, settings);
+    ParticleStore particles;
+    particles.resize(PARTICLES);
+    for (uint32_t f = 0; f < frames; f++) {
+        for (uint32_t i = 0; i < PARTICLES; i++) { particles.setPosition(i, glm::vec3(float(f), i * 1e-3f, -float(f))); }
+        writer.addFrame(particles);
+    }
+    writer.close();
+}
+
+static bool holdsFrame(const float* xyz, uint32_t f) {
+    for (uint32_t i = 0; i < PARTICLES; i++) {
+        if (std::abs(xyz[i] - float(f)) > 1e-3f || std::abs(xyz[PARTICLES + i] - i * 1e-3f) > 1e-3f ||
+            std::abs(xyz[2 * PARTICLES + i] + float(f)) > 1e-3f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// polls until the worker has decoded frame f, a second is plenty for a handful of tiny frames
+static const float* waitForFrame(CachePlayer& player, uint32_t f) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (const float* xyz = player.frame(f)) { return xyz; }
+        std::this_thread::yield();
+    }
+    throw std::runtime_error("frame " + std::to_string(f) + " was never decoded!");
+}
+
+static void testCache(const std::string& filename, uint32_t frames, uint32_t slots) {
+    const std::string name = std::to_string(frames) + " frames, " + std::to_string(slots) + " slots";
+    bakeCache(filename, frames);
+    CachePlayer player;
+    player.open(filename, slots);
+
+    // paused on every frame, the ones near the end have windows that wrap to 0
+    for (uint32_t f = 0; f < frames; f++) {
+        waitForFrame(player, f);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20)); // let the rest of the window decode
+        uint64_t decoded = player.getStats().decodedFrames;
+        uint32_t reads = 0;
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+        while (std::chrono::steady_clock::now() < end) {
+            const float* xyz = player.frame(f);
+            if (xyz == nullptr || !holdsFrame(xyz, f)) {
+                throw std::runtime_error(name + ": paused on frame " + std::to_string(f) + ", read " +
+                    std::to_string(reads) + " handed out " + (xyz ? "another frame's positions" : "nothing") + "!");
+            }
+            reads++;
+        }
+        uint64_t decodedWhilePaused = player.getStats().decodedFrames - decoded;
+        if (decodedWhilePaused != 0) {
+            throw std::runtime_error(name + ": paused on frame " + std::to_string(f) + ", the worker kept decoding (" +
+                std::to_string(decodedWhilePaused) + " frames in 50 ms)!");
+        }
+    }
+
+    // three loops through the cache, every frame read a few times while it's current
+    for (uint32_t k = 0; k < 3 * frames; k++) {
+        const uint32_t f = k % frames;
+        for (int read = 0; read < 8; read++) {
+            if (!holdsFrame(waitForFrame(player, f), f)) {
+                throw std::runtime_error(name + ": looping playback handed out the wrong positions for frame " + std::to_string(f) + "!");
+            }
+        }
+    }
+
+    player.close();
+    CachePlayer::Stats stats = player.getStats();
+    std::printf("%-22s ok (%llu frames decoded, %llu misses)\n", name.c_str(),
+        static_cast<unsigned long long>(stats.decodedFrames), static_cast<unsigned long long>(stats.misses));
+}
+
+int main() {
+    try {
+        const std::string filename = (std::filesystem::temp_directory_path() / "cachePlayerTest.ccache").string();
+        testCache(filename, 5, 4);  // the window of frame 4 wraps onto 0, which f % 4 also put in slot 0
+        testCache(filename, 7, 4);
+        testCache(filename, 9, 2);
+        testCache(filename, 3, 4);  // fewer frames than slots
+        testCache(filename, 8, 4);  // multiple of the slot count
+        std::filesystem::remove(filename);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
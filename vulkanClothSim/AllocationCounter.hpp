@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Heap allocation counter for benchmarks and checks
+// Counts every call of the global operator new. The replacement operators are only compiled into the
+// one translation unit that defines ALLOCATION_COUNTER_IMPLEMENTATION before including this header (same
+// idea as TINYOBJLOADER_IMPLEMENTATION), programs that don't want counting keep the standard ones.
+// Counts are process wide: measure while nothing else (cache/export writers...) is allocating.
+//
+//   AllocationCounter::Scope scope;
+//   solver.step();
+//   if (scope.count() != 0) { fail }
+
+struct AllocationCounter {
+    static inline std::atomic<uint64_t> allocations{ 0 };
+
+    static uint64_t total() { return allocations.load(std::memory_order_relaxed); }
+
+    class Scope {
+    public:
+        Scope() : start(total()) {}
+        uint64_t count() const { return total() - start; }
+    private:
+        uint64_t start;
+    };
+};
+
+#ifdef ALLOCATION_COUNTER_IMPLEMENTATION
+#if defined(__GNUC__) && !defined(__clang__)
+// gcc pairs the inlined malloc with the free below and flags it as a new/free mismatch
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+// plain, array and nothrow forms are counted and come from malloc, so every delete below frees what one of
+// them returned (std::stable_sort's buffer uses nothrow new). The align_val_t forms aren't replaced: they
+// aren't counted and keep the library's matching new/delete pair.
+void* operator new(std::size_t size) {
+    AllocationCounter::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) { return p; }
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    AllocationCounter::allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
@@ -0,0 +1,329 @@
+#pragma once
+#include "CpuProfiler.hpp"
+#include "SimCache.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Baked cache playback
+// The cache file is memory mapped, so opening it costs nothing up front and only the frames actually
+// played get paged in. A worker thread decodes a few frames ahead of the one being shown into a small
+// ring of buffers; the render loop just picks up the finished frame and copies it into the vertex buffer.
+// Seeking is a lookup in the frame index (read straight from the mapping) plus decoding from the closest
+// keyframe, so it costs at most keyframeInterval frame decodes no matter where in the file it lands.
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    void open(const std::string& filename) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("failed to open cache file!");
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        bytes = static_cast<size_t>(fileSize.QuadPart);
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            close();
+            throw std::runtime_error("failed to map cache file!");
+        }
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open cache file!");
+        }
+        struct stat info;
+        fstat(fd, &info);
+        bytes = static_cast<size_t>(info.st_size);
+        void* view = bytes ? mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        data = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+#endif
+        if (data == nullptr) {
+            close();
+            throw std::runtime_error("failed to map cache file!");
+        }
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data) { UnmapViewOfFile(data); }
+        if (mapping) { CloseHandle(mapping); }
+        if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data) { munmap(const_cast<uint8_t*>(data), bytes); }
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+#endif
+        data = nullptr;
+        bytes = 0;
+    }
+
+    const uint8_t* begin() const { return data; }
+    size_t size() const { return bytes; }
+
+private:
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// random access decoding on top of a mapped cache, not thread safe (CachePlayer owns one on its worker)
+class CacheReader {
+public:
+    void open(const std::string& filename) {
+        file.open(filename);
+        if (file.size() < sizeof(CacheHeader)) {
+            throw std::runtime_error("failed to read cache, file is too small!");
+        }
+        std::memcpy(&header, file.begin(), sizeof(header));
+        CacheHeader expected;
+        if (header.magic != expected.magic || header.version > expected.version) {
+            throw std::runtime_error("failed to read cache, unknown format!");
+        }
+        if (header.frameCount == 0 || header.keyframeInterval == 0 ||
+            header.indexOffset + uint64_t(header.frameCount) * sizeof(CacheIndexEntry) > file.size()) {
+            throw std::runtime_error("failed to read cache, missing frame index (was the writer closed?)!");
+        }
+        index = reinterpret_cast<const CacheIndexEntry*>(file.begin() + header.indexOffset);
+        codec.reset(header.particleCount, header.quantization);
+        lastDecoded = NONE;
+    }
+
+    const CacheHeader& getHeader() const { return header; }
+    uint32_t frameCount() const { return header.frameCount; }
+    uint32_t particleCount() const { return header.particleCount; }
+
+    // xyz gets particleCount x values, then y, then z. The next frame after the last decoded one is a single
+    // decode, anything else rolls forward from the keyframe at or before `frame`.
+    void decode(uint32_t frame, float* xyz) {
+        if (frame >= header.frameCount) {
+            throw std::runtime_error("cache frame out of range!");
+        }
+        uint32_t first = frame;
+        if (lastDecoded == NONE || frame != lastDecoded + 1 || isKeyframe(frame)) {
+            first = frame - frame % header.keyframeInterval;
+        }
+        for (uint32_t f = first; f <= frame; f++) {
+            const CacheIndexEntry entry = readEntry(f);
+            if (entry.offset + entry.bytes > file.size()) {
+                throw std::runtime_error("failed to read cache, frame is outside the file!");
+            }
+            codec.decode(file.begin() + entry.offset, entry.bytes, entry.keyframe != 0, xyz);
+        }
+        lastDecoded = frame;
+    }
+
+private:
+    static const uint32_t NONE = ~0u;
+
+    MappedFile file;
+    CacheHeader header;
+    const CacheIndexEntry* index = nullptr;
+    CacheFrameCodec codec;
+    uint32_t lastDecoded = NONE;
+
+    CacheIndexEntry readEntry(uint32_t frame) const {
+        CacheIndexEntry entry;
+        std::memcpy(&entry, index + frame, sizeof(entry)); // the mapping gives no alignment guarantee past the header
+        return entry;
+    }
+
+    bool isKeyframe(uint32_t frame) const { return readEntry(frame).keyframe != 0; }
+};
+
+// decode-ahead playback: frame(f) hands out frame f if the worker already has it, and moves the decode
+// window to start at f. Playback loops, frames after the last one wrap to 0.
+// Slots aren't tied to frame numbers (f % slots collides when the window wraps past the last frame and the
+// frame count isn't a multiple of the slot count): every slot remembers its frame, and the worker only reuses
+// a slot whose frame left the window. The window never holds more frames than there are slots, so there is
+// always one to reuse while a frame is missing, and the slot of the cursor's frame is never overwritten.
+class CachePlayer {
+public:
+    struct Stats {
+        uint64_t decodedFrames = 0;
+        int64_t decodeNs = 0;
+        uint64_t misses = 0; // frame() calls that found their frame not decoded yet
+    };
+
+    ~CachePlayer() { close(); }
+
+    void open(const std::string& filename, uint32_t framesAhead = 4) {
+        close();
+        reader.open(filename);
+        const size_t floats = size_t(reader.particleCount()) * 3;
+        slots.resize(std::max(2u, framesAhead));
+        for (auto& slot : slots) {
+            slot.frame = NONE;
+            slot.xyz.resize(floats);
+        }
+        cursor = 0;
+        stopping = false;
+        failure = nullptr;
+        stats = Stats{};
+        worker = std::thread([this] { decodeLoop(); });
+    }
+
+    void close() {
+        if (!worker.joinable()) { return; }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    uint32_t frameCount() const { return reader.frameCount(); }
+    uint32_t particleCount() const { return reader.particleCount(); }
+    float frameTime() const { return reader.getHeader().frameTime; }
+
+    // positions of frame f (x values, then y, then z) or nullptr if it isn't decoded yet. The pointer stays
+    // valid until the next call, the worker never touches the slot of the current frame.
+    // Rethrows if the worker failed to decode (corrupt file).
+    const float* frame(uint32_t f) {
+        f %= frameCount();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+        if (f != cursor) {
+            cursor = f;
+            wake.notify_one();
+        }
+        if (const Slot* slot = find(f)) {
+            return slot->xyz.data();
+        }
+        stats.misses++;
+        return nullptr;
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    static const uint32_t NONE = ~0u;
+
+    struct Slot {
+        uint32_t frame = NONE; // NONE while empty or being decoded
+        std::vector<float> xyz;
+    };
+
+    CacheReader reader;
+    std::vector<Slot> slots;
+    uint32_t cursor = 0;
+    bool stopping = false;
+    std::exception_ptr failure;
+    Stats stats;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    // frames decoded ahead, cursor included: one per slot, or every frame of a shorter cache
+    uint32_t windowSize() const { return std::min(static_cast<uint32_t>(slots.size()), frameCount()); }
+
+    const Slot* find(uint32_t f) const {
+        for (const Slot& slot : slots) {
+            if (slot.frame == f) { return &slot; }
+        }
+        return nullptr;
+    }
+
+    // first frame of [cursor, cursor + windowSize()) that isn't decoded, NONE if the whole window is ready
+    uint32_t nextMissing() const {
+        for (uint32_t k = 0; k < windowSize(); k++) {
+            uint32_t f = (cursor + k) % frameCount();
+            if (!find(f)) { return f; }
+        }
+        return NONE;
+    }
+
+    bool inWindow(uint32_t f) const {
+        uint32_t distance = (f + frameCount() - cursor) % frameCount();
+        return distance < windowSize();
+    }
+
+    // an empty slot or one whose frame left the window; one exists whenever nextMissing() found a frame
+    Slot* reusableSlot() {
+        for (Slot& slot : slots) {
+            if (slot.frame == NONE || !inWindow(slot.frame)) { return &slot; }
+        }
+        return nullptr;
+    }
+
+    void decodeLoop() {
+        while (true) {
+            uint32_t f;
+            Slot* slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || nextMissing() != NONE; });
+                if (stopping) { return; }
+                f = nextMissing();
+                slot = reusableSlot();
+                slot->frame = NONE;
+            }
+
+            PROFILE_ZONE("CachePlayer::decode");
+            int64_t start = CpuProfiler::nowNs();
+            try {
+                reader.decode(f, slot->xyz.data());
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failure = std::current_exception();
+                return;
+            }
+            int64_t elapsed = CpuProfiler::nowNs() - start;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.decodedFrames++;
+            stats.decodeNs += elapsed;
+            // the window may have moved on while decoding, then the slot just stays empty
+            if (inWindow(f)) {
+                slot->frame = f;
+            }
+        }
+    }
+};
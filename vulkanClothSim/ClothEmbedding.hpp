@@ -0,0 +1,420 @@
+#pragma once
+#include "ClothSimd.hpp"
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+#include "JobSystem.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Embedding points of one mesh in the triangles of another
+// embedPoints() ties every point to the closest rest triangle of a mesh: the triangle's corners, barycentric
+// weights of the closest point and the offset along the normal. ClothLod.hpp uses it to move state between
+// simulation levels, RenderEmbedding below to drive a high resolution render mesh with a coarse cloth:
+// - the render mesh is embedded once at load (build(), or buildCached() which keeps the result in a cache file
+//   next to the binary meshes, keyed by a hash of both meshes)
+// - deform() then places every render vertex from the current particle positions, with the offset along the
+//   interpolated vertex normal of the simulation mesh (skipped when the render mesh lies on the cloth, the
+//   usual case). Weights and indices are stored as structure of arrays, four vertices go through SSE at a
+//   time and chunks run on the solver's job system.
+// So a 100k vertex render mesh costs one pass over 100k vertices per frame, not 100k simulated particles.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+// a point tied to a triangle of another mesh
+struct MeshAnchor {
+    uint32_t v[3];
+    float w[3];
+    float offset; // along the unit normal of the triangle
+};
+
+// closest point to p on triangle (a, b, c) as barycentric weights (Ericson, Real-Time Collision Detection 5.1.5)
+inline glm::vec3 closestBarycentric(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) { return { 1.0f, 0.0f, 0.0f }; }
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) { return { 0.0f, 1.0f, 0.0f }; }
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        float v = d1 / (d1 - d3);
+        return { 1.0f - v, v, 0.0f };
+    }
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) { return { 0.0f, 0.0f, 1.0f }; }
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        float w = d2 / (d2 - d6);
+        return { 1.0f - w, 0.0f, w };
+    }
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return { 0.0f, 1.0f - w, w };
+    }
+    float denom = va + vb + vc;
+    if (denom <= 0.0f) { return { 1.0f, 0.0f, 0.0f }; } // degenerate triangle
+    float v = vb / denom, w = vc / denom;
+    return { 1.0f - v - w, v, w };
+}
+
+// ties every point to the closest triangle of a rest mesh. Triangles go into a uniform grid (every cell their
+// bounds touch), each point searches rings of cells around its own until nothing closer can be left. Points
+// are independent, so with `jobs` they are split over the job system.
+inline std::vector<MeshAnchor> embedPoints(const std::vector<glm::vec3>& points, const std::vector<glm::vec3>& rest,
+        const std::vector<uint32_t>& indices, JobSystem* jobs = nullptr) {
+    PROFILE_ZONE("embedPoints");
+    const size_t triangles = indices.size() / 3;
+    if (triangles == 0) { throw std::runtime_error("can't embed points in a mesh without triangles!"); }
+
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    double edgeSum = 0.0;
+    for (size_t t = 0; t < triangles; t++) {
+        for (int k = 0; k < 3; k++) {
+            const glm::vec3& p = rest[indices[3 * t + k]];
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+            edgeSum += glm::distance(p, rest[indices[3 * t + (k + 1) % 3]]);
+        }
+    }
+    const int MAX_CELLS = 128; // per axis
+    float cell = std::max(static_cast<float>(2.0 * edgeSum / (3 * triangles)), 1e-6f);
+    glm::vec3 extent = hi - lo;
+    cell = std::max(cell, std::max(extent.x, std::max(extent.y, extent.z)) / MAX_CELLS);
+    int dims[3];
+    for (int axis = 0; axis < 3; axis++) { dims[axis] = std::min(MAX_CELLS, static_cast<int>(extent[axis] / cell) + 1); }
+    auto cellOf = [&](const glm::vec3& p, int axis) {
+        return std::clamp(static_cast<int>((p[axis] - lo[axis]) / cell), 0, dims[axis] - 1);
+    };
+    auto cellIndex = [&](int x, int y, int z) { return (size_t(z) * dims[1] + y) * dims[0] + x; };
+
+    // triangles per cell, counted first and then filled (CSR)
+    const size_t cellCount = size_t(dims[0]) * dims[1] * dims[2];
+    std::vector<uint32_t> start(cellCount + 1, 0), cellTriangles;
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        for (uint32_t t = 0; t < triangles; t++) {
+            glm::vec3 a = rest[indices[3 * t]], b = rest[indices[3 * t + 1]], c = rest[indices[3 * t + 2]];
+            glm::vec3 tlo = glm::min(a, glm::min(b, c)), thi = glm::max(a, glm::max(b, c));
+            for (int z = cellOf(tlo, 2); z <= cellOf(thi, 2); z++) {
+                for (int y = cellOf(tlo, 1); y <= cellOf(thi, 1); y++) {
+                    for (int x = cellOf(tlo, 0); x <= cellOf(thi, 0); x++) {
+                        if (pass == 0) { start[cellIndex(x, y, z) + 1]++; }
+                        else { cellTriangles[fill[cellIndex(x, y, z)]++] = t; }
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (size_t i = 0; i < cellCount; i++) { start[i + 1] += start[i]; }
+            cellTriangles.resize(start[cellCount]);
+        }
+    }
+
+    std::vector<MeshAnchor> anchors(points.size());
+    const int maxRing = std::max(dims[0], std::max(dims[1], dims[2]));
+    auto embed = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const glm::vec3& p = points[i];
+            int cx = cellOf(p, 0), cy = cellOf(p, 1), cz = cellOf(p, 2);
+            float best = std::numeric_limits<float>::max();
+            uint32_t bestTriangle = 0;
+            glm::vec3 bestWeights(1.0f, 0.0f, 0.0f);
+            // the point can sit anywhere in its cell, so triangles only in ring r or further are at least r - 1 cells away
+            for (int r = 0; r <= maxRing && best > (r - 1) * cell; r++) {
+                for (int z = std::max(0, cz - r); z <= std::min(dims[2] - 1, cz + r); z++) {
+                    for (int y = std::max(0, cy - r); y <= std::min(dims[1] - 1, cy + r); y++) {
+                        for (int x = std::max(0, cx - r); x <= std::min(dims[0] - 1, cx + r); x++) {
+                            if (std::max(std::abs(x - cx), std::max(std::abs(y - cy), std::abs(z - cz))) != r) { continue; }
+                            size_t c = cellIndex(x, y, z);
+                            for (uint32_t s = start[c]; s < start[c + 1]; s++) {
+                                uint32_t t = cellTriangles[s];
+                                const glm::vec3& a = rest[indices[3 * t]];
+                                const glm::vec3& b = rest[indices[3 * t + 1]];
+                                const glm::vec3& d = rest[indices[3 * t + 2]];
+                                glm::vec3 w = closestBarycentric(p, a, b, d);
+                                float distance = glm::distance(p, w.x * a + w.y * b + w.z * d);
+                                if (distance < best) {
+                                    best = distance;
+                                    bestTriangle = t;
+                                    bestWeights = w;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            MeshAnchor& anchor = anchors[i];
+            for (int k = 0; k < 3; k++) {
+                anchor.v[k] = indices[3 * bestTriangle + k];
+                anchor.w[k] = bestWeights[k];
+            }
+            const glm::vec3& a = rest[anchor.v[0]];
+            glm::vec3 n = glm::cross(rest[anchor.v[1]] - a, rest[anchor.v[2]] - a);
+            float length = glm::length(n);
+            glm::vec3 q = bestWeights.x * a + bestWeights.y * rest[anchor.v[1]] + bestWeights.z * rest[anchor.v[2]];
+            anchor.offset = length > 0.0f ? glm::dot(p - q, n / length) : 0.0f;
+        }
+    };
+    const size_t grain = 1024;
+    if (jobs) {
+        jobs->parallelFor(points.size(), grain, embed);
+    }
+    else {
+        embed(0, points.size());
+    }
+    return anchors;
+}
+
+struct EmbeddingCacheHeader {
+    uint32_t magic = 0x424d4543; // "CEMB"
+    uint32_t version = 1;
+    uint64_t sourceHash = 0;     // both meshes, see RenderEmbedding::sourceHash()
+    uint64_t vertexCount = 0;
+};
+
+class RenderEmbedding {
+public:
+    // ties the render vertices to the rest triangles of the simulation mesh (the solver's particles at rest)
+    void build(const std::vector<glm::vec3>& renderPositions, const std::vector<glm::vec3>& simRest,
+            const std::vector<uint32_t>& simIndices, JobSystem* jobs = nullptr) {
+        std::vector<MeshAnchor> anchors = embedPoints(renderPositions, simRest, simIndices, jobs);
+        const size_t n = anchors.size();
+        for (auto* v : { &i0, &i1, &i2 }) { v->resize(n); }
+        for (auto* v : { &w0, &w1, &w2, &offset }) { v->resize(n); }
+
+        // offsets below a hundred thousandth of an edge are float noise of a render mesh lying on the cloth
+        double edgeSum = 0.0;
+        for (size_t t = 0; t + 2 < simIndices.size(); t += 3) { edgeSum += glm::distance(simRest[simIndices[t]], simRest[simIndices[t + 1]]); }
+        const float flat = simIndices.size() ? static_cast<float>(1e-5 * edgeSum / (simIndices.size() / 3)) : 0.0f;
+        for (size_t k = 0; k < n; k++) {
+            const MeshAnchor& anchor = anchors[k];
+            i0[k] = anchor.v[0];
+            i1[k] = anchor.v[1];
+            i2[k] = anchor.v[2];
+            w0[k] = anchor.w[0];
+            w1[k] = anchor.w[1];
+            w2[k] = anchor.w[2];
+            offset[k] = std::abs(anchor.offset) > flat ? anchor.offset : 0.0f;
+        }
+        finishBuild(simRest.size());
+    }
+
+    // build() through <cacheDir>/<name>.cembed, rebuilt when either mesh changed; an empty cacheDir just builds.
+    // Returns true if the embedding came from the cache.
+    bool buildCached(const std::vector<glm::vec3>& renderPositions, const std::vector<glm::vec3>& simRest,
+            const std::vector<uint32_t>& simIndices, const std::string& cacheDir, const std::string& name, JobSystem* jobs = nullptr) {
+        if (cacheDir.empty()) {
+            build(renderPositions, simRest, simIndices, jobs);
+            return false;
+        }
+        EmbeddingCacheHeader source;
+        source.sourceHash = sourceHash(renderPositions, simRest, simIndices);
+        source.vertexCount = renderPositions.size();
+        const std::filesystem::path cachePath = std::filesystem::path(cacheDir) / (name + ".cembed");
+        if (readCache(cachePath, source, simRest.size())) {
+            return true;
+        }
+        build(renderPositions, simRest, simIndices, jobs);
+        writeCache(cachePath, source);
+        return false;
+    }
+
+    size_t size() const { return i0.size(); }
+    bool hasOffsets() const { return offsets; }
+
+    // render vertex positions from the solver's current particles into x, y, z (size() each)
+    void deform(const ClothSolver& solver, float* x, float* y, float* z) {
+        PROFILE_ZONE("RenderEmbedding::deform");
+        const ParticleStore& p = solver.particles;
+        if (offsets) {
+            forChunks(solver.jobs, p.size(), [&](size_t begin, size_t end) { vertexNormals(solver, begin, end); });
+        }
+        forChunks(solver.jobs, size(), [&](size_t begin, size_t end) { place(p, x, y, z, begin, end); });
+    }
+
+    size_t memoryBytes() const {
+        return (i0.capacity() + i1.capacity() + i2.capacity()) * sizeof(uint32_t) +
+            (w0.capacity() + w1.capacity() + w2.capacity() + offset.capacity() + nx.capacity() + ny.capacity() + nz.capacity()) * sizeof(float);
+    }
+
+private:
+    static const size_t GRAIN = 8192;
+
+    std::vector<uint32_t> i0, i1, i2;   // corners of the simulation triangle, per render vertex
+    std::vector<float> w0, w1, w2;      // barycentric weights
+    std::vector<float> offset;          // along the interpolated normal, 0 = on the cloth
+    bool offsets = false;               // any offset at all, otherwise deform() skips the normals
+    std::vector<float> nx, ny, nz;      // area weighted vertex normals of the simulation mesh, per frame
+
+    void finishBuild(size_t particles) {
+        offsets = std::any_of(offset.begin(), offset.end(), [](float o) { return o != 0.0f; });
+        for (auto* v : { &nx, &ny, &nz }) { v->assign(offsets ? particles : 0, 0.0f); }
+    }
+
+    template <typename Fn>
+    static void forChunks(JobSystem* jobs, size_t count, const Fn& fn) {
+        if (jobs) {
+            jobs->parallelFor(count, GRAIN, fn);
+        }
+        else {
+            for (size_t begin = 0; begin < count; begin += GRAIN) { fn(begin, std::min(count, begin + GRAIN)); }
+        }
+    }
+
+    // sum of the (area weighted) normals of the triangles around each particle, not normalized: place()
+    // normalizes after interpolating anyway
+    void vertexNormals(const ClothSolver& solver, size_t begin, size_t end) {
+        const ParticleStore& p = solver.particles;
+        const ClothTriangles& tris = solver.triangles;
+        for (size_t i = begin; i < end; i++) {
+            float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+            for (uint32_t s = tris.vertexStart[i]; s < tris.vertexStart[i] + tris.vertexValence[i]; s++) {
+                uint32_t t = tris.vertexTriangles[s];
+                glm::vec3 a = p.position(tris.a[t]);
+                glm::vec3 n = glm::cross(p.position(tris.b[t]) - a, p.position(tris.c[t]) - a);
+                sx += n.x;
+                sy += n.y;
+                sz += n.z;
+            }
+            nx[i] = sx;
+            ny[i] = sy;
+            nz[i] = sz;
+        }
+    }
+
+    // p = w0 a + w1 b + w2 c (+ offset along the normalized w0 na + w1 nb + w2 nc). SSE does four vertices at
+    // a time with the corners gathered lane by lane (SSE2 has no gather), the scalar tail runs the same
+    // operations in the same order so both give the same bits
+    void place(const ParticleStore& p, float* x, float* y, float* z, size_t begin, size_t end) const {
+        const float* px = p.x.data();
+        const float* py = p.y.data();
+        const float* pz = p.z.data();
+        size_t k = begin;
+#if CLOTH_SOLVER_SSE
+        auto gather = [](const float* values, const uint32_t* index) {
+            return _mm_setr_ps(values[index[0]], values[index[1]], values[index[2]], values[index[3]]);
+        };
+        const __m128 zero = _mm_setzero_ps();
+        for (; k + 4 <= end; k += 4) {
+            const uint32_t* a = i0.data() + k;
+            const uint32_t* b = i1.data() + k;
+            const uint32_t* c = i2.data() + k;
+            __m128 u = _mm_loadu_ps(w0.data() + k), v = _mm_loadu_ps(w1.data() + k), w = _mm_loadu_ps(w2.data() + k);
+            __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, gather(px, a)), _mm_mul_ps(v, gather(px, b))), _mm_mul_ps(w, gather(px, c)));
+            __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, gather(py, a)), _mm_mul_ps(v, gather(py, b))), _mm_mul_ps(w, gather(py, c)));
+            __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, gather(pz, a)), _mm_mul_ps(v, gather(pz, b))), _mm_mul_ps(w, gather(pz, c)));
+            if (offsets) {
+                const float* fx = nx.data();
+                const float* fy = ny.data();
+                const float* fz = nz.data();
+                __m128 mx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, gather(fx, a)), _mm_mul_ps(v, gather(fx, b))), _mm_mul_ps(w, gather(fx, c)));
+                __m128 my = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, gather(fy, a)), _mm_mul_ps(v, gather(fy, b))), _mm_mul_ps(w, gather(fy, c)));
+                __m128 mz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, gather(fz, a)), _mm_mul_ps(v, gather(fz, b))), _mm_mul_ps(w, gather(fz, c)));
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), _mm_mul_ps(mz, mz)));
+                __m128 valid = _mm_cmpgt_ps(length, zero);
+                __m128 scale = _mm_and_ps(valid, _mm_div_ps(_mm_loadu_ps(offset.data() + k), _mm_or_ps(length, _mm_andnot_ps(valid, _mm_set1_ps(1.0f)))));
+                rx = _mm_add_ps(rx, _mm_mul_ps(mx, scale));
+                ry = _mm_add_ps(ry, _mm_mul_ps(my, scale));
+                rz = _mm_add_ps(rz, _mm_mul_ps(mz, scale));
+            }
+            _mm_storeu_ps(x + k, rx);
+            _mm_storeu_ps(y + k, ry);
+            _mm_storeu_ps(z + k, rz);
+        }
+#endif
+        for (; k < end; k++) {
+            uint32_t a = i0[k], b = i1[k], c = i2[k];
+            float u = w0[k], v = w1[k], w = w2[k];
+            float rx = u * px[a] + v * px[b] + w * px[c];
+            float ry = u * py[a] + v * py[b] + w * py[c];
+            float rz = u * pz[a] + v * pz[b] + w * pz[c];
+            if (offsets) {
+                float mx = u * nx[a] + v * nx[b] + w * nx[c];
+                float my = u * ny[a] + v * ny[b] + w * ny[c];
+                float mz = u * nz[a] + v * nz[b] + w * nz[c];
+                float length = std::sqrt(mx * mx + my * my + mz * mz);
+                float scale = length > 0.0f ? offset[k] / length : 0.0f;
+                rx += mx * scale;
+                ry += my * scale;
+                rz += mz * scale;
+            }
+            x[k] = rx;
+            y[k] = ry;
+            z[k] = rz;
+        }
+    }
+
+    // FNV-1a over both meshes, so a cache file only matches the exact pair it was built from
+    static uint64_t sourceHash(const std::vector<glm::vec3>& renderPositions, const std::vector<glm::vec3>& simRest, const std::vector<uint32_t>& simIndices) {
+        uint64_t hash = ClothSolver::fnv1a(ClothSolver::FNV_OFFSET, renderPositions.data(), renderPositions.size() * sizeof(glm::vec3));
+        hash = ClothSolver::fnv1a(hash, simRest.data(), simRest.size() * sizeof(glm::vec3));
+        return ClothSolver::fnv1a(hash, simIndices.data(), simIndices.size() * sizeof(uint32_t));
+    }
+
+    // same layout as the arrays: header, i0 i1 i2, w0 w1 w2 offset
+    bool readCache(const std::filesystem::path& cachePath, const EmbeddingCacheHeader& source, size_t particles) {
+        std::FILE* file = std::fopen(cachePath.string().c_str(), "rb");
+        if (file == nullptr) { return false; }
+        EmbeddingCacheHeader header;
+        bool ok = std::fread(&header, sizeof(header), 1, file) == 1 && header.magic == source.magic &&
+            header.version == source.version && header.sourceHash == source.sourceHash && header.vertexCount == source.vertexCount;
+        if (ok) {
+            const size_t n = header.vertexCount;
+            for (auto* v : { &i0, &i1, &i2 }) {
+                v->resize(n);
+                ok = ok && std::fread(v->data(), sizeof(uint32_t), n, file) == n;
+            }
+            for (auto* v : { &w0, &w1, &w2, &offset }) {
+                v->resize(n);
+                ok = ok && std::fread(v->data(), sizeof(float), n, file) == n;
+            }
+            for (size_t k = 0; ok && k < n; k++) { ok = i0[k] < particles && i1[k] < particles && i2[k] < particles; }
+        }
+        std::fclose(file);
+        if (ok) { finishBuild(particles); }
+        return ok;
+    }
+
+    // written under a temporary name and renamed into place, like MeshCache.hpp
+    void writeCache(const std::filesystem::path& cachePath, EmbeddingCacheHeader header) const {
+        std::error_code error;
+        std::filesystem::create_directories(cachePath.parent_path(), error);
+        std::filesystem::path temporary = cachePath;
+        temporary += ".tmp" + std::to_string(std::random_device{}());
+
+        std::FILE* file = std::fopen(temporary.string().c_str(), "wb");
+        if (file == nullptr) {
+            throw std::runtime_error("failed to create embedding cache file " + temporary.string() + "!");
+        }
+        const size_t n = size();
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        for (const auto* v : { &i0, &i1, &i2 }) { ok = ok && std::fwrite(v->data(), sizeof(uint32_t), n, file) == n; }
+        for (const auto* v : { &w0, &w1, &w2, &offset }) { ok = ok && std::fwrite(v->data(), sizeof(float), n, file) == n; }
+        ok = std::fclose(file) == 0 && ok;
+        if (ok) {
+            std::filesystem::rename(temporary, cachePath, error);
+            ok = !error;
+        }
+        if (!ok) {
+            std::filesystem::remove(temporary, error);
+            throw std::runtime_error("failed to write embedding cache file " + cachePath.string() + "!");
+        }
+    }
+};
+
+#include "ClothFloatPreciseEnd.hpp"
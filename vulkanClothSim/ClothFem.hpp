@@ -0,0 +1,231 @@
+#pragma once
+#include "ClothMesh.hpp"
+#include "ClothSimd.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Triangle FEM elements (StVK membrane)
+// Springs only resist length changes along mesh edges: pulling a cloth doesn't narrow it (no Poisson effect)
+// and how it shears depends on how the mesh was triangulated. Elements model the membrane as a continuum
+// instead: per triangle the deformation gradient F = [x1 - x0, x2 - x0] Dm^-1 (3x2, Dm = rest shape in the
+// material frame, inverted once at build from the rest positions), Green strain E = (F^T F - I) / 2 and the
+// Saint Venant-Kirchhoff energy A (mu |E|^2 + lambda / 2 tr(E)^2) with plane stress Lame parameters from
+// Young's modulus and Poisson's ratio.
+// In the XPBD solver an element is one constraint block C = (E11, E22, E12) with compliance (A K)^-1, K the
+// StVK elasticity in those coordinates, so lambda couples the two stretch directions: that is the Poisson
+// effect, which separate springs can't give. Each substep solves every block once (3x3 system per triangle,
+// with the multipliers starting at zero every substep like the distance constraints).
+// The gradients of all three strains are combinations of the two columns of F with rest shape coefficients,
+// so the whole block only needs F, its three dot products and three mass weighted sums per triangle.
+// Triangles are colored (no two of a color share a particle) and a color is solved in parallel; within a
+// chunk four triangles at a time go through SSE (corners gathered lane by lane) and write their corrections
+// straight back, which is safe since a color never touches a particle twice. The scalar tail does the same
+// operations in the same order, so both give the same bits.
+// The solver runs elements instead of its stretch constraints (ClothSolver::setElements()); bending stays.
+// Painted fabric compliances (ClothMaterials.hpp) only reach the springs, elements use one modulus for the cloth.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct FemSettings {
+    float youngsModulus = 1e4f; // N/m, membrane stiffness (thickness included)
+    float poissonRatio = 0.3f;  // < 0.5
+};
+
+class TriangleElements {
+public:
+    FemSettings settings;
+
+    // rest shapes of `mesh`, whose triangles must be the solver's in the same order
+    void build(const ClothMesh& mesh, const FemSettings& femSettings) {
+        settings = femSettings;
+        const float E = settings.youngsModulus, nu = settings.poissonRatio;
+        if (!(E > 0.0f) || !std::isfinite(E) || !(nu > -1.0f && nu < 0.5f)) {
+            throw std::runtime_error("elements need a positive Young's modulus and a Poisson ratio in (-1, 0.5)!");
+        }
+        // plane stress: mu = E / 2(1 + nu), lambda = E nu / (1 - nu^2); K in (E11, E22, E12) is
+        // [[2 mu + lambda, lambda, 0], [lambda, 2 mu + lambda, 0], [0, 0, 4 mu]], kept inverted
+        const double mu = E / (2.0 * (1.0 + nu)), lambda = E * nu / (1.0 - double(nu) * nu);
+        const double a = 2.0 * mu + lambda, b = lambda;
+        k11 = static_cast<float>(a / (a * a - b * b));
+        k12 = static_cast<float>(-b / (a * a - b * b));
+        k33 = static_cast<float>(1.0 / (4.0 * mu));
+
+        colorTriangles(mesh, triangle, colorOffsets);
+        const size_t count = triangle.size();
+        for (auto* v : { &i11, &i12, &i21, &i22, &invArea }) { v->resize(count); }
+        for (size_t k = 0; k < count; k++) {
+            glm::vec2 m1, m2;
+            triangleMaterialCoords(mesh, triangle[k], m1, m2);
+            float det = m1.x * m2.y - m2.x * m1.y;
+            float inv = det != 0.0f ? 1.0f / det : 0.0f; // degenerate rest triangles get F = 0 and no stiffness
+            i11[k] = m2.y * inv;
+            i12[k] = -m2.x * inv;
+            i21[k] = -m1.y * inv;
+            i22[k] = m1.x * inv;
+            invArea[k] = det != 0.0f ? 2.0f / std::abs(det) : 0.0f;
+        }
+    }
+
+    size_t size() const { return triangle.size(); }
+    size_t colorCount() const { return colorOffsets.empty() ? 0 : colorOffsets.size() - 1; }
+    uint32_t colorBegin(size_t color) const { return colorOffsets[color]; }
+    uint32_t colorEnd(size_t color) const { return colorOffsets[color + 1]; }
+
+    // one XPBD iteration over color order slots [begin, end) (one color at most) with substep h
+    void solve(float* x, float* y, float* z, const float* invMass, const uint32_t* ta, const uint32_t* tb,
+            const uint32_t* tc, size_t begin, size_t end, float h) const {
+        const float invH2 = 1.0f / (h * h);
+        size_t k = begin;
+#if CLOTH_SOLVER_SSE
+        auto gather = [](const float* values, const uint32_t* v0, const uint32_t* v1, const uint32_t* v2, const uint32_t* v3) {
+            return _mm_setr_ps(values[*v0], values[*v1], values[*v2], values[*v3]);
+        };
+        auto dot = [](__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+        };
+        const __m128 half = _mm_set1_ps(0.5f), quarter = _mm_set1_ps(0.25f), one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+        const __m128 K11 = _mm_set1_ps(k11), K12 = _mm_set1_ps(k12), K33 = _mm_set1_ps(k33), H = _mm_set1_ps(invH2);
+        for (; k + 4 <= end; k += 4) {
+            uint32_t v[3][4];
+            for (int lane = 0; lane < 4; lane++) {
+                const uint32_t t = triangle[k + lane];
+                v[0][lane] = ta[t];
+                v[1][lane] = tb[t];
+                v[2][lane] = tc[t];
+            }
+            auto corner = [&](const float* values, int c) { return gather(values, &v[c][0], &v[c][1], &v[c][2], &v[c][3]); };
+            __m128 x0 = corner(x, 0), y0 = corner(y, 0), z0 = corner(z, 0);
+            __m128 e1x = _mm_sub_ps(corner(x, 1), x0), e1y = _mm_sub_ps(corner(y, 1), y0), e1z = _mm_sub_ps(corner(z, 1), z0);
+            __m128 e2x = _mm_sub_ps(corner(x, 2), x0), e2y = _mm_sub_ps(corner(y, 2), y0), e2z = _mm_sub_ps(corner(z, 2), z0);
+            __m128 w0 = corner(invMass, 0), w1 = corner(invMass, 1), w2 = corner(invMass, 2);
+
+            // F = [e1 e2] Dm^-1; corner i's strain gradients are r_i f1 (E11), s_i f2 (E22), (s_i f1 + r_i f2) / 2 (E12)
+            __m128 r1 = _mm_loadu_ps(i11.data() + k), s1 = _mm_loadu_ps(i12.data() + k);
+            __m128 r2 = _mm_loadu_ps(i21.data() + k), s2 = _mm_loadu_ps(i22.data() + k);
+            __m128 r0 = _mm_sub_ps(zero, _mm_add_ps(r1, r2)), s0 = _mm_sub_ps(zero, _mm_add_ps(s1, s2));
+            __m128 f1x = _mm_add_ps(_mm_mul_ps(e1x, r1), _mm_mul_ps(e2x, r2));
+            __m128 f1y = _mm_add_ps(_mm_mul_ps(e1y, r1), _mm_mul_ps(e2y, r2));
+            __m128 f1z = _mm_add_ps(_mm_mul_ps(e1z, r1), _mm_mul_ps(e2z, r2));
+            __m128 f2x = _mm_add_ps(_mm_mul_ps(e1x, s1), _mm_mul_ps(e2x, s2));
+            __m128 f2y = _mm_add_ps(_mm_mul_ps(e1y, s1), _mm_mul_ps(e2y, s2));
+            __m128 f2z = _mm_add_ps(_mm_mul_ps(e1z, s1), _mm_mul_ps(e2z, s2));
+            __m128 f11 = dot(f1x, f1y, f1z, f1x, f1y, f1z);
+            __m128 f12 = dot(f1x, f1y, f1z, f2x, f2y, f2z);
+            __m128 f22 = dot(f2x, f2y, f2z, f2x, f2y, f2z);
+
+            // J W J^T + compliance / h^2
+            __m128 wrr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_mul_ps(r0, r0)), _mm_mul_ps(w1, _mm_mul_ps(r1, r1))), _mm_mul_ps(w2, _mm_mul_ps(r2, r2)));
+            __m128 wss = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_mul_ps(s0, s0)), _mm_mul_ps(w1, _mm_mul_ps(s1, s1))), _mm_mul_ps(w2, _mm_mul_ps(s2, s2)));
+            __m128 wrs = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_mul_ps(r0, s0)), _mm_mul_ps(w1, _mm_mul_ps(r1, s1))), _mm_mul_ps(w2, _mm_mul_ps(r2, s2)));
+            __m128 alpha = _mm_mul_ps(_mm_loadu_ps(invArea.data() + k), H);
+            __m128 m11 = _mm_add_ps(_mm_mul_ps(wrr, f11), _mm_mul_ps(K11, alpha));
+            __m128 m22 = _mm_add_ps(_mm_mul_ps(wss, f22), _mm_mul_ps(K11, alpha));
+            __m128 m33 = _mm_add_ps(_mm_mul_ps(quarter, _mm_add_ps(_mm_add_ps(_mm_mul_ps(wss, f11), _mm_mul_ps(_mm_add_ps(wrs, wrs), f12)), _mm_mul_ps(wrr, f22))), _mm_mul_ps(K33, alpha));
+            __m128 m12 = _mm_add_ps(_mm_mul_ps(wrs, f12), _mm_mul_ps(K12, alpha));
+            __m128 m13 = _mm_mul_ps(half, _mm_add_ps(_mm_mul_ps(wrs, f11), _mm_mul_ps(wrr, f12)));
+            __m128 m23 = _mm_mul_ps(half, _mm_add_ps(_mm_mul_ps(wss, f12), _mm_mul_ps(wrs, f22)));
+
+            // dLambda = -M^-1 C by cofactors, C = (f11 - 1, f22 - 1, f12) / 2
+            __m128 c1 = _mm_mul_ps(half, _mm_sub_ps(f11, one)), c2 = _mm_mul_ps(half, _mm_sub_ps(f22, one)), c3 = _mm_mul_ps(half, f12);
+            __m128 a00 = _mm_sub_ps(_mm_mul_ps(m22, m33), _mm_mul_ps(m23, m23));
+            __m128 a01 = _mm_sub_ps(_mm_mul_ps(m13, m23), _mm_mul_ps(m12, m33));
+            __m128 a02 = _mm_sub_ps(_mm_mul_ps(m12, m23), _mm_mul_ps(m13, m22));
+            __m128 a11 = _mm_sub_ps(_mm_mul_ps(m11, m33), _mm_mul_ps(m13, m13));
+            __m128 a12 = _mm_sub_ps(_mm_mul_ps(m12, m13), _mm_mul_ps(m11, m23));
+            __m128 a22 = _mm_sub_ps(_mm_mul_ps(m11, m22), _mm_mul_ps(m12, m12));
+            __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m11, a00), _mm_mul_ps(m12, a01)), _mm_mul_ps(m13, a02));
+            __m128 valid = _mm_cmpgt_ps(det, zero);
+            __m128 scale = _mm_and_ps(valid, _mm_div_ps(one, _mm_or_ps(det, _mm_andnot_ps(valid, one))));
+            __m128 l1 = _mm_mul_ps(_mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a00, c1), _mm_mul_ps(a01, c2)), _mm_mul_ps(a02, c3))), scale);
+            __m128 l2 = _mm_mul_ps(_mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a01, c1), _mm_mul_ps(a11, c2)), _mm_mul_ps(a12, c3))), scale);
+            __m128 l3 = _mm_mul_ps(_mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a02, c1), _mm_mul_ps(a12, c2)), _mm_mul_ps(a22, c3))), scale);
+
+            // dx_i = w_i ((l1 r_i + l3 s_i / 2) f1 + (l2 s_i + l3 r_i / 2) f2), scattered lane by lane
+            __m128 l3h = _mm_mul_ps(half, l3);
+            const __m128 r[3] = { r0, r1, r2 }, s[3] = { s0, s1, s2 }, w[3] = { w0, w1, w2 };
+            for (int c = 0; c < 3; c++) {
+                __m128 a = _mm_mul_ps(w[c], _mm_add_ps(_mm_mul_ps(l1, r[c]), _mm_mul_ps(l3h, s[c])));
+                __m128 b = _mm_mul_ps(w[c], _mm_add_ps(_mm_mul_ps(l2, s[c]), _mm_mul_ps(l3h, r[c])));
+                alignas(16) float dx[4], dy[4], dz[4];
+                _mm_store_ps(dx, _mm_add_ps(_mm_mul_ps(a, f1x), _mm_mul_ps(b, f2x)));
+                _mm_store_ps(dy, _mm_add_ps(_mm_mul_ps(a, f1y), _mm_mul_ps(b, f2y)));
+                _mm_store_ps(dz, _mm_add_ps(_mm_mul_ps(a, f1z), _mm_mul_ps(b, f2z)));
+                for (int lane = 0; lane < 4; lane++) {
+                    x[v[c][lane]] += dx[lane];
+                    y[v[c][lane]] += dy[lane];
+                    z[v[c][lane]] += dz[lane];
+                }
+            }
+        }
+#endif
+        for (; k < end; k++) {
+            const uint32_t t = triangle[k];
+            const uint32_t v[3] = { ta[t], tb[t], tc[t] };
+            float e1x = x[v[1]] - x[v[0]], e1y = y[v[1]] - y[v[0]], e1z = z[v[1]] - z[v[0]];
+            float e2x = x[v[2]] - x[v[0]], e2y = y[v[2]] - y[v[0]], e2z = z[v[2]] - z[v[0]];
+            float w0 = invMass[v[0]], w1 = invMass[v[1]], w2 = invMass[v[2]];
+
+            float r1 = i11[k], s1 = i12[k], r2 = i21[k], s2 = i22[k];
+            float r0 = 0.0f - (r1 + r2), s0 = 0.0f - (s1 + s2);
+            float f1x = e1x * r1 + e2x * r2, f1y = e1y * r1 + e2y * r2, f1z = e1z * r1 + e2z * r2;
+            float f2x = e1x * s1 + e2x * s2, f2y = e1y * s1 + e2y * s2, f2z = e1z * s1 + e2z * s2;
+            float f11 = f1x * f1x + f1y * f1y + f1z * f1z;
+            float f12 = f1x * f2x + f1y * f2y + f1z * f2z;
+            float f22 = f2x * f2x + f2y * f2y + f2z * f2z;
+
+            float wrr = w0 * (r0 * r0) + w1 * (r1 * r1) + w2 * (r2 * r2);
+            float wss = w0 * (s0 * s0) + w1 * (s1 * s1) + w2 * (s2 * s2);
+            float wrs = w0 * (r0 * s0) + w1 * (r1 * s1) + w2 * (r2 * s2);
+            float alpha = invArea[k] * invH2;
+            float m11 = wrr * f11 + k11 * alpha;
+            float m22 = wss * f22 + k11 * alpha;
+            float m33 = 0.25f * (wss * f11 + (wrs + wrs) * f12 + wrr * f22) + k33 * alpha;
+            float m12 = wrs * f12 + k12 * alpha;
+            float m13 = 0.5f * (wrs * f11 + wrr * f12);
+            float m23 = 0.5f * (wss * f12 + wrs * f22);
+
+            float c1 = 0.5f * (f11 - 1.0f), c2 = 0.5f * (f22 - 1.0f), c3 = 0.5f * f12;
+            float a00 = m22 * m33 - m23 * m23;
+            float a01 = m13 * m23 - m12 * m33;
+            float a02 = m12 * m23 - m13 * m22;
+            float a11 = m11 * m33 - m13 * m13;
+            float a12 = m12 * m13 - m11 * m23;
+            float a22 = m11 * m22 - m12 * m12;
+            float det = m11 * a00 + m12 * a01 + m13 * a02;
+            float scale = det > 0.0f ? 1.0f / det : 0.0f;
+            float l1 = (0.0f - (a00 * c1 + a01 * c2 + a02 * c3)) * scale;
+            float l2 = (0.0f - (a01 * c1 + a11 * c2 + a12 * c3)) * scale;
+            float l3 = (0.0f - (a02 * c1 + a12 * c2 + a22 * c3)) * scale;
+
+            float l3h = 0.5f * l3;
+            const float r[3] = { r0, r1, r2 }, s[3] = { s0, s1, s2 }, w[3] = { w0, w1, w2 };
+            for (int c = 0; c < 3; c++) {
+                float a = w[c] * (l1 * r[c] + l3h * s[c]);
+                float b = w[c] * (l2 * s[c] + l3h * r[c]);
+                x[v[c]] += a * f1x + b * f2x;
+                y[v[c]] += a * f1y + b * f2y;
+                z[v[c]] += a * f1z + b * f2z;
+            }
+        }
+    }
+
+    size_t memoryBytes() const {
+        return (triangle.capacity() + colorOffsets.capacity()) * sizeof(uint32_t) +
+            (i11.capacity() + i12.capacity() + i21.capacity() + i22.capacity() + invArea.capacity()) * sizeof(float);
+    }
+
+private:
+    float k11 = 0.0f, k12 = 0.0f, k33 = 0.0f; // inverse StVK elasticity, times 1 / (A h^2) is the compliance
+    // everything below is in color order: slot k is triangle[k]
+    std::vector<uint32_t> triangle;
+    std::vector<uint32_t> colorOffsets;
+    std::vector<float> i11, i12, i21, i22; // Dm^-1
+    std::vector<float> invArea;            // 1 / rest area
+};
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,16 @@
+// no #pragma once: every include opens one region, closed by ClothFloatPreciseEnd.hpp
+// Solver side code is compiled without FMA contraction (and with precise float semantics on MSVC/clang), so the
+// same inputs give the same bits on every compiler, CPU and -march; deterministic mode relies on it. Include this
+// after a header's own includes and ClothFloatPreciseEnd.hpp at its end; regions nest.
+
+#if defined(_MSC_VER) || defined(__clang__)
+#pragma float_control(precise, on, push)
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#else
+#pragma fp_contract(off)
+#endif
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
@@ -0,0 +1,7 @@
+// no #pragma once: closes the region the matching ClothFloatPreciseBegin.hpp opened
+
+#if defined(_MSC_VER) || defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,278 @@
+#pragma once
+#include "ClothMesh.hpp"
+#include "ClothSolver.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Procedural cloth grids
+// Builds columns x rows quads straight into the solver (particles, stretch and bend constraints) and the
+// render arrays, without an intermediate OBJ or edge hash map: every edge and bending pair of a grid can be
+// written down from the cell it belongs to. Topology matches makeGridMesh() + buildClothEdges() for the
+// default diagonal, so the two give the same cloth.
+//
+// cell (i, j) has corners a = (i, j), b = (i + 1, j), c = (i, j + 1), d = (i + 1, j + 1); vertex (i, j) has
+// index j * (columns + 1) + i. Unflipped cells are split along b-c, flipped cells along a-d.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+enum class GridDiagonal {
+    SAME,        // every cell split the same way (makeGridMesh layout)
+    ALTERNATING, // checkerboard, no preferred shear direction
+    RANDOM,      // per cell coin flip from GridSettings::seed
+};
+
+// pin sets, combine with |; row 0 is the top edge
+enum GridPins : uint32_t {
+    GRID_PIN_NONE = 0,
+    GRID_PIN_TOP_CORNERS = 1 << 0,
+    GRID_PIN_TOP_EDGE = 1 << 1,
+    GRID_PIN_BOTTOM_CORNERS = 1 << 2,
+    GRID_PIN_LEFT_EDGE = 1 << 3,
+    GRID_PIN_RIGHT_EDGE = 1 << 4,
+};
+
+struct GridSettings {
+    uint32_t columns = 64;
+    uint32_t rows = 64;
+    float width = 2.0f;
+    float height = 2.0f;
+    bool vertical = false;       // false: XZ plane like clothplane.obj, true: hanging in XY with row 0 on top
+    glm::vec3 center{ 0.0f };
+    GridDiagonal diagonal = GridDiagonal::SAME;
+    uint32_t seed = 1;
+    uint32_t pins = GRID_PIN_NONE;
+
+    size_t vertexCount() const { return (size_t(columns) + 1) * (size_t(rows) + 1); }
+    size_t triangleCount() const { return size_t(columns) * rows * 2; }
+};
+
+inline uint32_t gridVertex(const GridSettings& grid, uint32_t i, uint32_t j) {
+    return j * (grid.columns + 1) + i;
+}
+
+inline glm::vec2 gridUV(const GridSettings& grid, uint32_t i, uint32_t j) {
+    return { float(i) / grid.columns, float(j) / grid.rows };
+}
+
+inline glm::vec3 gridPosition(const GridSettings& grid, uint32_t i, uint32_t j) {
+    glm::vec2 uv = gridUV(grid, i, j);
+    if (grid.vertical) {
+        return grid.center + glm::vec3((uv.x - 0.5f) * grid.width, (0.5f - uv.y) * grid.height, 0.0f);
+    }
+    return grid.center + glm::vec3((uv.x - 0.5f) * grid.width, 0.0f, (uv.y - 0.5f) * grid.height);
+}
+
+// true = split along a-d
+inline bool gridCellFlipped(const GridSettings& grid, uint32_t i, uint32_t j) {
+    switch (grid.diagonal) {
+    case GridDiagonal::ALTERNATING: return ((i + j) & 1) != 0;
+    case GridDiagonal::RANDOM: {
+        uint32_t h = (i * 73856093u) ^ (j * 19349663u) ^ (grid.seed * 83492791u);
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return (h & 1) != 0;
+    }
+    default: return false;
+    }
+}
+
+inline void checkGrid(const GridSettings& grid) {
+    if (grid.columns == 0 || grid.rows == 0) {
+        throw std::runtime_error("grid needs at least one column and one row!");
+    }
+    if ((uint64_t(grid.columns) + 1) * (uint64_t(grid.rows) + 1) > UINT32_MAX) {
+        throw std::runtime_error("grid has too many vertices for 32 bit indices!");
+    }
+}
+
+// 6 indices per cell into out (size triangleCount() * 3)
+inline void writeGridIndices(const GridSettings& grid, uint32_t* out) {
+    for (uint32_t j = 0; j < grid.rows; j++) {
+        for (uint32_t i = 0; i < grid.columns; i++) {
+            uint32_t a = gridVertex(grid, i, j), b = a + 1;
+            uint32_t c = a + grid.columns + 1, d = c + 1;
+            if (gridCellFlipped(grid, i, j)) {
+                out[0] = a; out[1] = d; out[2] = b;
+                out[3] = a; out[4] = c; out[5] = d;
+            }
+            else {
+                out[0] = a; out[1] = c; out[2] = b;
+                out[3] = b; out[4] = c; out[5] = d;
+            }
+            out += 6;
+        }
+    }
+}
+
+inline std::vector<uint32_t> gridPinIndices(const GridSettings& grid) {
+    std::vector<uint32_t> pins;
+    uint32_t last = grid.columns, bottom = grid.rows;
+    if (grid.pins & GRID_PIN_TOP_EDGE) {
+        for (uint32_t i = 0; i <= last; i++) { pins.push_back(gridVertex(grid, i, 0)); }
+    }
+    else if (grid.pins & GRID_PIN_TOP_CORNERS) {
+        pins.push_back(gridVertex(grid, 0, 0));
+        pins.push_back(gridVertex(grid, last, 0));
+    }
+    if (grid.pins & GRID_PIN_BOTTOM_CORNERS) {
+        pins.push_back(gridVertex(grid, 0, bottom));
+        pins.push_back(gridVertex(grid, last, bottom));
+    }
+    if (grid.pins & GRID_PIN_LEFT_EDGE) {
+        for (uint32_t j = 0; j <= bottom; j++) { pins.push_back(gridVertex(grid, 0, j)); }
+    }
+    if (grid.pins & GRID_PIN_RIGHT_EDGE) {
+        for (uint32_t j = 0; j <= bottom; j++) { pins.push_back(gridVertex(grid, last, j)); }
+    }
+    return pins;
+}
+
+// particles, lumped masses, stretch and bend constraints, triangles and pins, then solver.finishBuild()
+inline void buildGridSolver(const GridSettings& grid, const SolverParams& params, ClothSolver& solver) {
+    PROFILE_ZONE("buildGridSolver");
+    checkGrid(grid);
+    const uint32_t cols = grid.columns, rows = grid.rows, stride = cols + 1;
+
+    solver.params = params;
+    ParticleStore& p = solver.particles;
+    p.resize(0);
+    p.resize(grid.vertexCount());
+    for (uint32_t j = 0; j <= rows; j++) {
+        for (uint32_t i = 0; i <= cols; i++) {
+            uint32_t v = gridVertex(grid, i, j);
+            glm::vec3 pos = gridPosition(grid, i, j);
+            p.x[v] = p.px[v] = pos.x;
+            p.y[v] = p.py[v] = pos.y;
+            p.z[v] = p.pz[v] = pos.z;
+        }
+    }
+
+    // every triangle has the same area, a vertex gets a third of it per triangle touching it; corners touch
+    // 1 or 2 triangles depending on the diagonals, so count instead of assuming
+    const float third = 0.5f * (grid.width / cols) * (grid.height / rows) * params.areaDensity / 3.0f;
+    for (uint32_t j = 0; j < rows; j++) {
+        for (uint32_t i = 0; i < cols; i++) {
+            uint32_t a = gridVertex(grid, i, j), b = a + 1, c = a + stride, d = c + 1;
+            bool flipped = gridCellFlipped(grid, i, j);
+            // both triangles touch the diagonal's ends, the other two corners get one each
+            p.invMass[a] += third * (flipped ? 2.0f : 1.0f);
+            p.invMass[d] += third * (flipped ? 2.0f : 1.0f);
+            p.invMass[b] += third * (flipped ? 1.0f : 2.0f);
+            p.invMass[c] += third * (flipped ? 1.0f : 2.0f);
+        }
+    }
+    for (float& m : p.invMass) { m = m > 0.0f ? 1.0f / m : 0.0f; }
+
+    const float dx = grid.width / cols, dy = grid.height / rows;
+    const float diagonal = std::sqrt(dx * dx + dy * dy);
+
+    DistanceConstraints& stretch = solver.stretch;
+    stretch = DistanceConstraints{};
+    size_t stretchCount = size_t(cols) * (size_t(rows) + 1) + (size_t(cols) + 1) * rows + size_t(cols) * rows;
+    for (auto* v : { &stretch.a, &stretch.b }) { v->reserve(stretchCount); }
+    for (auto* v : { &stretch.restLength, &stretch.compliance, &stretch.lambda }) { v->reserve(stretchCount); }
+
+    for (uint32_t j = 0; j <= rows; j++) {
+        for (uint32_t i = 0; i < cols; i++) {
+            uint32_t v = gridVertex(grid, i, j);
+            stretch.add(v, v + 1, dx, params.stretchCompliance);
+        }
+    }
+    for (uint32_t j = 0; j < rows; j++) {
+        for (uint32_t i = 0; i <= cols; i++) {
+            uint32_t v = gridVertex(grid, i, j);
+            stretch.add(v, v + stride, dy, params.stretchCompliance);
+        }
+    }
+    for (uint32_t j = 0; j < rows; j++) {
+        for (uint32_t i = 0; i < cols; i++) {
+            uint32_t a = gridVertex(grid, i, j);
+            if (gridCellFlipped(grid, i, j)) { stretch.add(a, a + stride + 1, diagonal, params.stretchCompliance); }
+            else { stretch.add(a + 1, a + stride, diagonal, params.stretchCompliance); }
+        }
+    }
+
+    // bending: the two vertices opposite each interior edge, looked up from the triangles on either side.
+    // Opposite vertex of a cell's side: top (a-b) c|d, bottom (c-d) b|a, left (a-c) b|d, right (b-d) c|a
+    // for unflipped|flipped cells.
+    DistanceConstraints& bend = solver.bend;
+    bend = DistanceConstraints{};
+    size_t bendCount = size_t(cols) * (rows - 1) + size_t(cols - 1) * rows + size_t(cols) * rows;
+    for (auto* v : { &bend.a, &bend.b }) { v->reserve(bendCount); }
+    for (auto* v : { &bend.restLength, &bend.compliance, &bend.lambda }) { v->reserve(bendCount); }
+
+    auto addBend = [&](uint32_t u, uint32_t v) {
+        float ex = p.x[u] - p.x[v], ey = p.y[u] - p.y[v], ez = p.z[u] - p.z[v];
+        bend.add(u, v, std::sqrt(ex * ex + ey * ey + ez * ez), params.bendCompliance);
+    };
+    for (uint32_t j = 0; j < rows; j++) {
+        for (uint32_t i = 0; i < cols; i++) {
+            uint32_t a = gridVertex(grid, i, j), b = a + 1, c = a + stride, d = c + 1;
+            bool flipped = gridCellFlipped(grid, i, j);
+            addBend(flipped ? b : a, flipped ? c : d); // across the diagonal
+            if (j > 0) {
+                // across the top edge, the cell above sees it as its bottom edge
+                uint32_t here = flipped ? d : c;
+                uint32_t aboveA = a - stride;
+                uint32_t above = gridCellFlipped(grid, i, j - 1) ? aboveA : aboveA + 1;
+                addBend(above, here);
+            }
+            if (i > 0) {
+                // across the left edge, the cell to the left sees it as its right edge
+                uint32_t here = flipped ? d : b;
+                uint32_t leftA = a - 1;
+                uint32_t left = gridCellFlipped(grid, i - 1, j) ? leftA : leftA + stride;
+                addBend(left, here);
+            }
+        }
+    }
+
+    std::vector<uint32_t> indices(grid.triangleCount() * 3);
+    writeGridIndices(grid, indices.data());
+    solver.triangles.assign(indices, p.size());
+
+    for (uint32_t pin : gridPinIndices(grid)) { p.invMass[pin] = 0.0f; }
+    solver.finishBuild();
+}
+
+// render arrays for any vertex type with pos, color and texCoord members (main.cpp's Vertex)
+template <typename VertexT>
+void writeGridRenderMesh(const GridSettings& grid, std::vector<VertexT>& vertices, std::vector<uint32_t>& indices) {
+    checkGrid(grid);
+    vertices.resize(grid.vertexCount());
+    for (uint32_t j = 0; j <= grid.rows; j++) {
+        for (uint32_t i = 0; i <= grid.columns; i++) {
+            VertexT& v = vertices[gridVertex(grid, i, j)];
+            v.pos = gridPosition(grid, i, j);
+            v.color = { 1.0f, 1.0f, 1.0f };
+            v.texCoord = gridUV(grid, i, j);
+        }
+    }
+    indices.resize(grid.triangleCount() * 3);
+    writeGridIndices(grid, indices.data());
+}
+
+// simulation mesh of the grid, for the things that take a ClothMesh (exporter, triangle counts)
+inline ClothMesh makeGridClothMesh(const GridSettings& grid) {
+    checkGrid(grid);
+    ClothMesh mesh;
+    mesh.positions.resize(grid.vertexCount());
+    mesh.uvs.resize(grid.vertexCount());
+    for (uint32_t j = 0; j <= grid.rows; j++) {
+        for (uint32_t i = 0; i <= grid.columns; i++) {
+            mesh.positions[gridVertex(grid, i, j)] = gridPosition(grid, i, j);
+            mesh.uvs[gridVertex(grid, i, j)] = gridUV(grid, i, j);
+        }
+    }
+    mesh.indices.resize(grid.triangleCount() * 3);
+    writeGridIndices(grid, mesh.indices.data());
+    return mesh;
+}
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,233 @@
+#pragma once
+#include "ClothEmbedding.hpp"
+#include "ClothRemesh.hpp"
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+#include "JobSystem.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Simulation levels of detail
+// A cloth far away from the camera covers a few pixels per triangle, so simulating every particle of it is
+// wasted. ClothLod keeps precomputed coarser versions of a solver and steps the coarsest one whose edges
+// still look small enough on screen:
+// - level 0 is the attached solver itself, coarser levels are solvers over the same rest shape with fewer
+//   particles. Grids can pass exact ones (fewer cells), anything else gets coarseLevel(), which remeshes a
+//   copy coarse only (ClothRemesh.hpp) until about half the particles are left
+// - every particle of every level is embedded in the closest rest triangle of every other level
+//   (embedPoints() in ClothEmbedding.hpp), once in attach()
+// - switching levels moves positions, previous positions and velocities over through that embedding
+// - while a coarse level runs, step() rebuilds the attached solver's positions from it, so rendering,
+//   caching and export keep seeing the full mesh and never know a coarse level is running
+// Levels are picked from how many pixels one meter covers at the cloth (select()), with hysteresis so a
+// cloth sitting right at a threshold doesn't switch every frame. Doesn't combine with tearing or remeshing.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct LodSettings {
+    uint32_t levels = 3;      // including the full cloth, used when attach() builds the coarse levels itself
+    float edgePixels = 4.0f;  // the coarsest level whose mean edge covers at most this many pixels runs
+    float hysteresis = 0.25f; // going coarser needs this much margin under edgePixels, staying coarse this much over
+};
+
+// a coarser copy of a cloth at rest (call before it has stepped): coarsen only remeshing until about half the
+// particles are left. Pins and boundaries stay, so coarse levels keep the outline of the cloth.
+inline void coarseLevel(const ClothSolver& finer, ClothSolver& coarse) {
+    coarse = finer;
+    coarse.stats.reset();
+    RemeshSettings settings;
+    settings.refinePasses = 0;
+    settings.coarsenAngle = 0.3f; // rest curvature is fine to lose at a distance
+    ClothRemesher remesher;
+    remesher.attach(coarse, settings);
+    const size_t target = finer.particles.size() / 2;
+    for (int pass = 0; pass < 8 && coarse.particles.size() > target; pass++) {
+        if (remesher.remesh(coarse).collapses == 0) { break; }
+    }
+}
+
+class ClothLod {
+public:
+    LodSettings settings;
+
+    // `solver` becomes level 0 and its current positions the rest shape, call right after building it.
+    // `coarser` are the coarse levels, finest first; empty = settings.levels - 1 of them from coarseLevel()
+    void attach(ClothSolver& solver, const LodSettings& lodSettings, std::vector<ClothSolver> coarser = {}) {
+        settings = lodSettings;
+        coarse = std::move(coarser);
+        if (coarse.empty()) {
+            coarse.resize(settings.levels > 1 ? settings.levels - 1 : 0);
+            for (size_t k = 0; k < coarse.size(); k++) { coarseLevel(k == 0 ? solver : coarse[k - 1], coarse[k]); }
+        }
+        for (ClothSolver& level : coarse) { level.jobs = solver.jobs; }
+
+        // rest shapes and mean edges, then every level embedded in every other one
+        const size_t count = levelCount();
+        std::vector<std::vector<glm::vec3>> rest(count);
+        std::vector<std::vector<uint32_t>> indices(count);
+        meanEdge.assign(count, 0.0f);
+        for (size_t k = 0; k < count; k++) {
+            const ClothSolver& level = at(solver, k);
+            rest[k].resize(level.particles.size());
+            for (size_t i = 0; i < rest[k].size(); i++) { rest[k][i] = level.particles.position(i); }
+            level.triangles.indices(indices[k]);
+            double sum = 0.0;
+            for (size_t c = 0; c < level.stretch.size(); c++) { sum += level.stretch.restLength[c]; }
+            meanEdge[k] = level.stretch.size() ? static_cast<float>(sum / level.stretch.size()) : 0.0f;
+        }
+        anchors.assign(count * count, {});
+        for (size_t from = 0; from < count; from++) {
+            for (size_t to = 0; to < count; to++) {
+                if (from != to) { anchors[from * count + to] = embedPoints(rest[to], rest[from], indices[from], solver.jobs); }
+            }
+        }
+        active = 0;
+        switches = 0;
+        transferNs = 0;
+    }
+
+    uint32_t levelCount() const { return static_cast<uint32_t>(coarse.size() + 1); }
+    uint32_t activeLevel() const { return active; }
+    size_t sceneParticles(const ClothSolver& solver) const { return solver.particles.size(); }
+    size_t simulatedParticles(const ClothSolver& solver) const { return at(solver, active).particles.size(); }
+    float levelEdge(uint32_t level) const { return meanEdge[level]; }
+    uint64_t switchCount() const { return switches; }
+    int64_t transferTimeNs() const { return transferNs; }
+
+    // the solver that steps right now (level 0 = `solver` itself)
+    ClothSolver& activeSolver(ClothSolver& solver) { return at(solver, active); }
+
+    // mean position of the running level, cheap enough to call every frame for the camera distance
+    glm::vec3 center(const ClothSolver& solver) const {
+        const ParticleStore& p = at(solver, active).particles;
+        glm::vec3 sum(0.0f);
+        for (size_t i = 0; i < p.size(); i++) { sum += p.position(i); }
+        return p.size() ? sum / static_cast<float>(p.size()) : sum;
+    }
+
+    // picks the level for a camera where one meter at the cloth covers pixelsPerMeter pixels, true if it switched
+    bool select(ClothSolver& solver, float pixelsPerMeter) {
+        uint32_t wanted = 0;
+        for (uint32_t k = 1; k < levelCount(); k++) {
+            float margin = k > active ? 1.0f - settings.hysteresis : k == active ? 1.0f + settings.hysteresis : 1.0f;
+            if (meanEdge[k] * pixelsPerMeter <= settings.edgePixels * margin) { wanted = k; }
+        }
+        if (wanted == active) { return false; }
+        setLevel(solver, wanted);
+        return true;
+    }
+
+    // moves the cloth state over to `level` through the embedding
+    void setLevel(ClothSolver& solver, uint32_t level) {
+        if (level >= levelCount()) { throw std::runtime_error("no such cloth lod level!"); }
+        if (level == active) { return; }
+        PROFILE_ZONE("ClothLod::setLevel");
+        int64_t start = CpuProfiler::nowNs();
+        ClothSolver& from = at(solver, active);
+        ClothSolver& to = at(solver, level);
+        const std::vector<MeshAnchor>& map = anchors[active * levelCount() + level];
+        const ParticleStore& src = from.particles;
+        ParticleStore& dst = to.particles;
+        forChunks(solver, dst.size(), [&](size_t begin, size_t end) {
+            place(map, src.x.data(), src.y.data(), src.z.data(), dst, dst.x.data(), dst.y.data(), dst.z.data(), begin, end);
+            place(map, src.px.data(), src.py.data(), src.pz.data(), dst, dst.px.data(), dst.py.data(), dst.pz.data(), begin, end);
+            for (size_t i = begin; i < end; i++) {
+                if (dst.invMass[i] == 0.0f) { continue; }
+                const MeshAnchor& anchor = map[i];
+                float vx = 0.0f, vy = 0.0f, vz = 0.0f;
+                for (int k = 0; k < 3; k++) {
+                    vx += anchor.w[k] * src.vx[anchor.v[k]];
+                    vy += anchor.w[k] * src.vy[anchor.v[k]];
+                    vz += anchor.w[k] * src.vz[anchor.v[k]];
+                }
+                dst.vx[i] = vx;
+                dst.vy[i] = vy;
+                dst.vz[i] = vz;
+            }
+        });
+        to.contacts.clear();
+        to.stats.steps = from.stats.steps; // wind time keeps going
+        to.movePins(to.stats.steps * to.params.timeStep); // kinematic pins stood still while the level was idle
+        active = level;
+        switches++;
+        transferNs += CpuProfiler::nowNs() - start;
+    }
+
+    // one frame of the running level; a coarse level also rebuilds the positions of `solver` (level 0)
+    void step(ClothSolver& solver) {
+        if (active == 0) {
+            solver.step();
+            return;
+        }
+        ClothSolver& level = at(solver, active);
+        level.step();
+        solver.stats.steps = level.stats.steps;
+        PROFILE_ZONE("ClothLod::embed");
+        const std::vector<MeshAnchor>& map = anchors[active * levelCount()];
+        const ParticleStore& src = level.particles;
+        ParticleStore& dst = solver.particles;
+        forChunks(solver, dst.size(), [&](size_t begin, size_t end) {
+            place(map, src.x.data(), src.y.data(), src.z.data(), dst, dst.x.data(), dst.y.data(), dst.z.data(), begin, end);
+        });
+        solver.movePins(solver.stats.steps * solver.params.timeStep); // place() skips pinned particles
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const ClothSolver& level : coarse) { bytes += level.memoryBytes(); }
+        for (const auto& map : anchors) { bytes += map.capacity() * sizeof(MeshAnchor); }
+        return bytes;
+    }
+
+private:
+    static const size_t GRAIN = 4096;
+
+    std::vector<ClothSolver> coarse;             // levels 1 and up, level 0 is the attached solver
+    std::vector<float> meanEdge;                 // mean rest edge per level
+    std::vector<std::vector<MeshAnchor>> anchors; // [from * levels + to]: particles of `to` in triangles of `from`
+    uint32_t active = 0;
+    uint64_t switches = 0;
+    int64_t transferNs = 0;
+
+    ClothSolver& at(ClothSolver& solver, size_t k) { return k == 0 ? solver : coarse[k - 1]; }
+    const ClothSolver& at(const ClothSolver& solver, size_t k) const { return k == 0 ? solver : coarse[k - 1]; }
+
+    template <typename Fn>
+    static void forChunks(ClothSolver& solver, size_t count, const Fn& fn) {
+        if (solver.jobs) {
+            solver.jobs->parallelFor(count, GRAIN, fn);
+        }
+        else {
+            for (size_t begin = 0; begin < count; begin += GRAIN) { fn(begin, std::min(count, begin + GRAIN)); }
+        }
+    }
+
+    // embedded positions from the corners' positions plus the offset along their current normal; pinned
+    // particles stay where their pin holds them
+    static void place(const std::vector<MeshAnchor>& map, const float* x, const float* y, const float* z, const ParticleStore& dst,
+            float* ox, float* oy, float* oz, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (dst.invMass[i] == 0.0f) { continue; }
+            const MeshAnchor& anchor = map[i];
+            glm::vec3 c[3];
+            for (int k = 0; k < 3; k++) { c[k] = { x[anchor.v[k]], y[anchor.v[k]], z[anchor.v[k]] }; }
+            glm::vec3 p = anchor.w[0] * c[0] + anchor.w[1] * c[1] + anchor.w[2] * c[2];
+            if (anchor.offset != 0.0f) {
+                glm::vec3 n = glm::cross(c[1] - c[0], c[2] - c[0]);
+                float length = glm::length(n);
+                if (length > 0.0f) { p += n * (anchor.offset / length); }
+            }
+            ox[i] = p.x;
+            oy[i] = p.y;
+            oz[i] = p.z;
+        }
+    }
+};
+
+#include "ClothFloatPreciseEnd.hpp"
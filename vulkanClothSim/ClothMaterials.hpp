@@ -0,0 +1,228 @@
+#pragma once
+#include "ClothMesh.hpp"
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Painted fabric materials
+// A garment mixes fabrics, so stiffness and weight can vary over the cloth. Fabrics are painted into a
+// texture, one flat color per fabric, and looked up with the cloth's uvs (ClothMesh::uvs, the same texCoord
+// the renderer uses). applyClothMaterials() turns that into the solver's existing per constraint compliance
+// and per particle inverse mass arrays once after build, so a patchwork cloth steps exactly like a uniform one:
+// no material lookups, indices or branches in the solver loops.
+// - every vertex takes the fabric whose color is closest to its texel (nearest texel, fabric ids don't blend)
+// - stretch constraints running along the weave (within 22.5 degrees of the u or v axis in uv space) get the
+//   stretch compliance, diagonal ones the shear compliance; edges between fabrics average the compliances of
+//   their two ends (half of the edge is each fabric, and compliances in series add)
+// - bend constraints average the bend compliances of their ends
+// - masses are lumped from the rest triangle areas like ClothSolver::build(), with the mean density of the corners
+// Pinned particles stay pinned. Remeshing carries compliances and per particle densities over (ClothRemesh.hpp),
+// tearing copies compliances and splits masses.
+//
+// fabric file, one statement per line, '#' starts a comment:
+//   texture patchwork.ppm                       binary PPM (P6), relative to the fabric file
+//   fabric denim 0 0 255 stretch 0 shear 1e-6 bend 1e-4 density 0.4
+//                                               name, painted color (0-255), then any of the parameters;
+//                                               missing ones keep the SolverParams defaults
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct FabricMaterial {
+    std::string name;
+    glm::vec3 color{ 1.0f };        // painted color, 0..1
+    float stretchCompliance = 0.0f; // along the weave
+    float shearCompliance = 0.0f;   // across it
+    float bendCompliance = 1e-3f;
+    float areaDensity = 0.2f;       // kg per m^2
+};
+
+// 8 bit rgb image sampled with nearest filtering and repeating uvs
+struct MaterialTexture {
+    uint32_t width = 0, height = 0;
+    std::vector<uint8_t> rgb;
+
+    bool empty() const { return rgb.empty(); }
+
+    glm::vec3 sample(const glm::vec2& uv) const {
+        float u = uv.x - std::floor(uv.x), v = uv.y - std::floor(uv.y);
+        uint32_t x = std::min(width - 1, static_cast<uint32_t>(u * width));
+        uint32_t y = std::min(height - 1, static_cast<uint32_t>(v * height));
+        const uint8_t* texel = &rgb[3 * (size_t(y) * width + x)];
+        return glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+    }
+};
+
+// binary PPM (P6, maxval 255); the tools only have GLM and tinyobj, and a PPM needs no decoder
+inline MaterialTexture loadPpm(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) { throw std::runtime_error("failed to open " + path + "!"); }
+    std::string magic;
+    uint32_t header[3] = {};
+    in >> magic;
+    for (uint32_t& value : header) {
+        while (in >> std::ws && in.peek() == '#') { in.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); }
+        in >> value;
+    }
+    in.get(); // the single whitespace byte before the pixels
+    MaterialTexture texture;
+    texture.width = header[0];
+    texture.height = header[1];
+    if (!in || magic != "P6" || header[2] != 255 || texture.width == 0 || texture.height == 0) {
+        throw std::runtime_error(path + " is not an 8 bit binary PPM!");
+    }
+    texture.rgb.resize(size_t(texture.width) * texture.height * 3);
+    if (!in.read(reinterpret_cast<char*>(texture.rgb.data()), static_cast<std::streamsize>(texture.rgb.size()))) {
+        throw std::runtime_error(path + " is truncated!");
+    }
+    return texture;
+}
+
+class ClothMaterials {
+public:
+    std::vector<FabricMaterial> fabrics;
+    MaterialTexture texture;
+
+    bool empty() const { return fabrics.empty(); }
+
+    // fabric index per vertex, from the texel under its uv
+    std::vector<uint32_t> vertexFabrics(const ClothMesh& mesh) const {
+        std::vector<uint32_t> result(mesh.vertexCount(), 0);
+        if (texture.empty() || fabrics.size() < 2) { return result; }
+        for (size_t i = 0; i < result.size(); i++) {
+            glm::vec3 color = texture.sample(i < mesh.uvs.size() ? mesh.uvs[i] : glm::vec2(0.0f));
+            float best = std::numeric_limits<float>::max();
+            for (uint32_t f = 0; f < fabrics.size(); f++) {
+                glm::vec3 d = fabrics[f].color - color;
+                float distance = glm::dot(d, d);
+                if (distance < best) {
+                    best = distance;
+                    result[i] = f;
+                }
+            }
+        }
+        return result;
+    }
+};
+
+inline ClothMaterials parseClothMaterials(std::istream& in, const std::string& directory) {
+    ClothMaterials materials;
+    SolverParams defaults;
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::string keyword;
+        if (!(words >> keyword)) { continue; }
+        auto fail = [&](const std::string& what) {
+            return std::runtime_error("fabric file line " + std::to_string(lineNumber) + ": " + what + "!");
+        };
+        if (keyword == "texture") {
+            std::string file;
+            if (!(words >> file)) { throw fail("texture needs a file"); }
+            materials.texture = loadPpm(directory.empty() || file.front() == '/' ? file : directory + "/" + file);
+        }
+        else if (keyword == "fabric") {
+            FabricMaterial fabric;
+            fabric.stretchCompliance = fabric.shearCompliance = defaults.stretchCompliance;
+            fabric.bendCompliance = defaults.bendCompliance;
+            fabric.areaDensity = defaults.areaDensity;
+            if (!(words >> fabric.name >> fabric.color.x >> fabric.color.y >> fabric.color.z)) { throw fail("fabric needs a name and r g b"); }
+            fabric.color = fabric.color / 255.0f;
+            std::string parameter;
+            float value;
+            while (words >> parameter) {
+                if (!(words >> value)) { throw fail(parameter + " needs a value"); }
+                if (parameter == "stretch") { fabric.stretchCompliance = value; }
+                else if (parameter == "shear") { fabric.shearCompliance = value; }
+                else if (parameter == "bend") { fabric.bendCompliance = value; }
+                else if (parameter == "density") { fabric.areaDensity = value; }
+                else { throw fail("unknown fabric parameter " + parameter); }
+            }
+            if (fabric.stretchCompliance < 0.0f || fabric.shearCompliance < 0.0f || fabric.bendCompliance < 0.0f || fabric.areaDensity <= 0.0f) {
+                throw fail("fabric " + fabric.name + " has a negative compliance or no density");
+            }
+            materials.fabrics.push_back(fabric);
+        }
+        else {
+            throw fail("unknown statement " + keyword);
+        }
+    }
+    if (materials.fabrics.size() > 1 && materials.texture.empty()) {
+        throw std::runtime_error("fabric file has several fabrics but no texture!");
+    }
+    return materials;
+}
+
+inline ClothMaterials loadClothMaterials(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) { throw std::runtime_error("failed to open " + path + "!"); }
+    size_t slash = path.find_last_of("/\\");
+    return parseClothMaterials(in, slash == std::string::npos ? std::string() : path.substr(0, slash));
+}
+
+// per constraint compliances and per particle masses from the fabrics painted on `mesh`, the mesh `solver` was
+// just built from (build() or buildGridSolver(), vertex i = particle i, before it steps)
+inline void applyClothMaterials(const ClothMesh& mesh, const ClothMaterials& materials, ClothSolver& solver) {
+    PROFILE_ZONE("applyClothMaterials");
+    if (materials.empty()) { return; }
+    if (mesh.vertexCount() != solver.particles.size()) {
+        throw std::runtime_error("fabric materials need the mesh the solver was built from!");
+    }
+    if (mesh.uvs.size() != mesh.vertexCount()) {
+        throw std::runtime_error("fabric materials need a mesh with uvs!");
+    }
+    const std::vector<uint32_t> fabric = materials.vertexFabrics(mesh);
+    const std::vector<FabricMaterial>& f = materials.fabrics;
+
+    // along the weave if the uv direction is within 22.5 degrees of an axis, a zero uv edge counts as along
+    const float tan22 = 0.41421356f;
+    DistanceConstraints& stretch = solver.stretch;
+    for (size_t k = 0; k < stretch.size(); k++) {
+        if (!stretch.active(k)) { continue; }
+        uint32_t a = stretch.a[k], b = stretch.b[k];
+        glm::vec2 d = mesh.uvs[b] - mesh.uvs[a];
+        float lo = std::min(std::abs(d.x), std::abs(d.y)), hi = std::max(std::abs(d.x), std::abs(d.y));
+        bool shear = lo > tan22 * hi;
+        stretch.compliance[k] = shear ?
+            0.5f * (f[fabric[a]].shearCompliance + f[fabric[b]].shearCompliance) :
+            0.5f * (f[fabric[a]].stretchCompliance + f[fabric[b]].stretchCompliance);
+    }
+    DistanceConstraints& bend = solver.bend;
+    for (size_t k = 0; k < bend.size(); k++) {
+        if (!bend.active(k)) { continue; }
+        bend.compliance[k] = 0.5f * (f[fabric[bend.a[k]]].bendCompliance + f[fabric[bend.b[k]]].bendCompliance);
+    }
+
+    ParticleStore& p = solver.particles;
+    std::vector<float> mass(p.size(), 0.0f);
+    for (size_t t = 0; t < mesh.triangleCount(); t++) {
+        uint32_t i0 = mesh.indices[3 * t], i1 = mesh.indices[3 * t + 1], i2 = mesh.indices[3 * t + 2];
+        float area = 0.5f * glm::length(glm::cross(mesh.positions[i1] - mesh.positions[i0], mesh.positions[i2] - mesh.positions[i0]));
+        float density = (f[fabric[i0]].areaDensity + f[fabric[i1]].areaDensity + f[fabric[i2]].areaDensity) / 3.0f;
+        float third = area * density / 3.0f;
+        mass[i0] += third;
+        mass[i1] += third;
+        mass[i2] += third;
+    }
+    for (size_t i = 0; i < p.size(); i++) {
+        if (p.invMass[i] == 0.0f) { continue; } // pinned
+        p.invMass[i] = mass[i] > 0.0f ? 1.0f / mass[i] : 0.0f;
+    }
+    solver.areaDensity.resize(p.size());
+    for (size_t i = 0; i < p.size(); i++) { solver.areaDensity[i] = f[fabric[i]].areaDensity; }
+    solver.materialCompliance = true;
+}
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,226 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Simulation side mesh
+// Unlike the render mesh built in loadModel() (which splits vertices on every unique pos/uv pair),
+// cloth vertices are welded by OBJ position index so the cloth stays one connected piece.
+// tiny_obj_loader.h re-emits its implementation on every include while TINYOBJLOADER_IMPLEMENTATION is defined,
+// so translation units include this header first and define the implementation afterwards (see main.cpp / the tools).
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct ClothMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::vector<uint32_t> indices; // triangle list
+
+    size_t vertexCount() const { return positions.size(); }
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// unique undirected edges plus the two vertices opposite each interior edge (for bending)
+struct ClothEdges {
+    std::vector<uint32_t> edges;      // pairs (a, b), a < b
+    std::vector<uint32_t> bendPairs;  // pairs of vertices opposite a shared edge
+};
+
+inline ClothMesh loadClothMesh(const std::string& path) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str())) {
+        throw std::runtime_error(err);
+    }
+
+    ClothMesh mesh;
+    size_t vertexCount = attrib.vertices.size() / 3;
+    mesh.positions.resize(vertexCount);
+    mesh.uvs.assign(vertexCount, glm::vec2(0.0f));
+    for (size_t i = 0; i < vertexCount; i++) {
+        mesh.positions[i] = { attrib.vertices[3 * i + 0], attrib.vertices[3 * i + 1], attrib.vertices[3 * i + 2] };
+    }
+
+    for (const auto& shape : shapes) {
+        for (const auto& index : shape.mesh.indices) {
+            // bunny.obj has no texcoords at all, those vertices keep uv (0, 0)
+            if (index.texcoord_index >= 0) {
+                mesh.uvs[index.vertex_index] = {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+            }
+            mesh.indices.push_back(static_cast<uint32_t>(index.vertex_index));
+        }
+    }
+
+    return mesh;
+}
+
+// n x m quads in the XZ plane centered at the origin, two triangles per quad
+inline ClothMesh makeGridMesh(uint32_t n, uint32_t m, float width, float depth) {
+    ClothMesh mesh;
+    mesh.positions.reserve((size_t(n) + 1) * (size_t(m) + 1));
+    mesh.uvs.reserve((size_t(n) + 1) * (size_t(m) + 1));
+
+    for (uint32_t j = 0; j <= m; j++) {
+        for (uint32_t i = 0; i <= n; i++) {
+            float u = float(i) / n;
+            float v = float(j) / m;
+            mesh.positions.push_back({ (u - 0.5f) * width, 0.0f, (v - 0.5f) * depth });
+            mesh.uvs.push_back({ u, v });
+        }
+    }
+
+    mesh.indices.reserve(size_t(n) * m * 6);
+    for (uint32_t j = 0; j < m; j++) {
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t a = j * (n + 1) + i;
+            uint32_t b = a + 1;
+            uint32_t c = a + (n + 1);
+            uint32_t d = c + 1;
+            mesh.indices.insert(mesh.indices.end(), { a, c, b, b, c, d });
+        }
+    }
+
+    return mesh;
+}
+
+inline ClothEdges buildClothEdges(const ClothMesh& mesh) {
+    ClothEdges result;
+
+    // key: (min, max) vertex of the edge, value: first opposite vertex seen (or UINT32_MAX once paired)
+    std::unordered_map<uint64_t, uint32_t> edgeOpposite;
+    edgeOpposite.reserve(mesh.indices.size());
+
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        for (int e = 0; e < 3; e++) {
+            uint32_t a = mesh.indices[t + e];
+            uint32_t b = mesh.indices[t + (e + 1) % 3];
+            uint32_t opposite = mesh.indices[t + (e + 2) % 3];
+            if (a > b) { std::swap(a, b); }
+            uint64_t key = (uint64_t(a) << 32) | b;
+
+            auto it = edgeOpposite.find(key);
+            if (it == edgeOpposite.end()) {
+                edgeOpposite.emplace(key, opposite);
+                result.edges.push_back(a);
+                result.edges.push_back(b);
+            }
+            else if (it->second != UINT32_MAX) {
+                result.bendPairs.push_back(it->second);
+                result.bendPairs.push_back(opposite);
+                it->second = UINT32_MAX; // non-manifold edges only bend once
+            }
+        }
+    }
+
+    return result;
+}
+
+// every triangle split into four at its edge midpoints (uvs too), shared edges get one midpoint; used to make
+// high resolution render meshes that lie exactly on a cloth (RenderEmbedding in ClothEmbedding.hpp)
+inline ClothMesh subdivideMesh(const ClothMesh& mesh) {
+    ClothMesh result;
+    result.positions = mesh.positions;
+    result.uvs = mesh.uvs;
+    result.uvs.resize(mesh.positions.size(), glm::vec2(0.0f));
+    result.indices.reserve(mesh.indices.size() * 4);
+
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    midpoints.reserve(mesh.indices.size());
+    auto midpoint = [&](uint32_t a, uint32_t b) {
+        uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+        auto it = midpoints.emplace(key, static_cast<uint32_t>(result.positions.size()));
+        if (it.second) {
+            result.positions.push_back(0.5f * (result.positions[a] + result.positions[b]));
+            result.uvs.push_back(0.5f * (result.uvs[a] + result.uvs[b]));
+        }
+        return it.first->second;
+    };
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        uint32_t a = mesh.indices[t], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+        uint32_t ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+        result.indices.insert(result.indices.end(), { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca });
+    }
+    return result;
+}
+
+// triangles sorted by a greedy coloring in mesh order, like DistanceConstraints::color(): no two triangles of a
+// color share a vertex, color c is order[colorOffsets[c]] .. order[colorOffsets[c + 1] - 1]
+inline void colorTriangles(const ClothMesh& mesh, std::vector<uint32_t>& order, std::vector<uint32_t>& colorOffsets) {
+    const uint32_t MAX_COLORS = 64;
+    const size_t count = mesh.triangleCount();
+    std::vector<uint64_t> used(mesh.vertexCount(), 0);
+    std::vector<uint32_t> colors(count);
+    uint32_t colorCount = 0;
+    for (size_t t = 0; t < count; t++) {
+        const uint32_t* tri = &mesh.indices[3 * t];
+        uint64_t taken = used[tri[0]] | used[tri[1]] | used[tri[2]];
+        uint32_t c = 0;
+        while (c < MAX_COLORS && (taken & (1ull << c))) { c++; }
+        if (c == MAX_COLORS) { throw std::runtime_error("triangle coloring needs more than 64 colors!"); }
+        colors[t] = c;
+        for (int k = 0; k < 3; k++) { used[tri[k]] |= 1ull << c; }
+        colorCount = std::max(colorCount, c + 1);
+    }
+    colorOffsets.assign(colorCount + 1, 0);
+    for (uint32_t c : colors) { colorOffsets[c + 1]++; }
+    for (uint32_t c = 0; c < colorCount; c++) { colorOffsets[c + 1] += colorOffsets[c]; }
+    std::vector<uint32_t> next(colorOffsets.begin(), colorOffsets.end() - 1);
+    order.resize(count);
+    for (uint32_t t = 0; t < count; t++) { order[next[colors[t]]++] = t; }
+}
+
+// corners 1 and 2 of triangle t relative to corner 0, in the material frame of its rest shape: x along the uv u
+// direction (the warp) in the triangle plane, y across it (the weft); the first edge when the uvs are degenerate
+inline void triangleMaterialCoords(const ClothMesh& mesh, size_t t, glm::vec2& m1, glm::vec2& m2) {
+    const uint32_t* tri = &mesh.indices[3 * t];
+    const glm::vec3 x0 = mesh.positions[tri[0]];
+    const glm::vec3 e1 = mesh.positions[tri[1]] - x0, e2 = mesh.positions[tri[2]] - x0;
+    glm::vec2 d1(0.0f), d2(0.0f);
+    if (mesh.uvs.size() == mesh.vertexCount()) {
+        d1 = mesh.uvs[tri[1]] - mesh.uvs[tri[0]];
+        d2 = mesh.uvs[tri[2]] - mesh.uvs[tri[0]];
+    }
+
+    // warp = dX/du, from [e1 e2] = [dX/du dX/dv] [d1 d2]
+    glm::vec3 n = glm::cross(e1, e2);
+    float det = d1.x * d2.y - d2.x * d1.y;
+    glm::vec3 warp = det != 0.0f ? (e1 * d2.y - e2 * d1.y) / det : e1;
+    warp = warp - n * (glm::dot(warp, n) / std::max(glm::dot(n, n), 1e-30f)); // into the triangle plane
+    if (glm::length(warp) < 1e-12f) { warp = e1; }
+    warp = glm::normalize(warp);
+    glm::vec3 weft = glm::length(n) > 0.0f ? glm::normalize(glm::cross(n, warp)) : glm::vec3(0.0f);
+    m1 = { glm::dot(e1, warp), glm::dot(e1, weft) };
+    m2 = { glm::dot(e2, warp), glm::dot(e2, weft) };
+}
+
+inline void translateMesh(ClothMesh& mesh, const glm::vec3& offset) {
+    for (auto& p : mesh.positions) { p += offset; }
+}
+
+inline void scaleMesh(ClothMesh& mesh, float scale) {
+    for (auto& p : mesh.positions) { p *= scale; }
+}
+
+inline void meshBounds(const ClothMesh& mesh, glm::vec3& lo, glm::vec3& hi) {
+    lo = glm::vec3(std::numeric_limits<float>::max());
+    hi = glm::vec3(-std::numeric_limits<float>::max());
+    for (const auto& p : mesh.positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+}
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,436 @@
+#pragma once
+#include "ClothMesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Pin groups
+// OBJ files can't say which vertices hold a cloth in place, so pins come from one of:
+// - a sidecar file next to the OBJ (<name>.pins, format below) with named groups of vertices
+// - vertex colors in the OBJ (`v x y z r g b`), one group per distinct color that isn't white
+// - spatial selections in code (selectBox(), selectSphere(), selectNearest() on a PinGroup)
+// Every vertex of every group gets invMass 0 (ClothSolver::setPins()), so pins cost the solver nothing: the
+// integrate loop is branch free and scales gravity by the inverse mass flag, constraints never move them.
+// Membership is also kept as a bitset, one bit per particle, for O(1) pinned()/kinematic() queries.
+// Groups with keys are kinematic: a rigid motion (translation plus a rotation about the group's rest
+// centroid) interpolated between the keys moves them every substep, e.g. a curtain rail or a hand holding
+// the cloth. Kinematic particles are stored as structure of arrays (particle, rest offset from the pivot)
+// so moving them is one tight loop per group.
+//
+// pin file, one statement per line, '#' starts a comment; selections are in OBJ space (before any scene
+// transform), keys in the space the cloth is simulated in:
+//   group top                       starts a group, the statements below add to it
+//   vertices 0 1 2                  explicit vertex indices
+//   box x0 y0 z0 x1 y1 z1           every vertex inside the box
+//   sphere x y z r                  every vertex inside the sphere
+//   nearest x y z                   the vertex closest to the point
+//   color r g b [tolerance]         every vertex whose OBJ color is within tolerance (default 0.1) per channel
+//   axis x y z                      rotation axis of the keys (default 0 1 0)
+//   key t tx ty tz [degrees]        kinematic key at time t seconds: offset from the rest pose, rotation angle
+//   loop                            keys repeat after the last one
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct PinKey {
+    float time = 0.0f;
+    glm::vec3 translation{ 0.0f };
+    float angle = 0.0f; // radians about the group axis
+};
+
+struct PinGroup {
+    std::string name;
+    std::vector<uint32_t> vertices; // sorted, unique
+    glm::vec3 axis{ 0.0f, 1.0f, 0.0f };
+    std::vector<PinKey> keys;       // sorted by time, empty = static pin
+    bool loop = false;
+
+    bool kinematic() const { return !keys.empty(); }
+
+    void add(uint32_t v) {
+        auto it = std::lower_bound(vertices.begin(), vertices.end(), v);
+        if (it == vertices.end() || *it != v) { vertices.insert(it, v); }
+    }
+
+    void selectBox(const ClothMesh& mesh, const glm::vec3& lo, const glm::vec3& hi) {
+        for (uint32_t i = 0; i < mesh.vertexCount(); i++) {
+            const glm::vec3& p = mesh.positions[i];
+            if (p.x >= lo.x && p.y >= lo.y && p.z >= lo.z && p.x <= hi.x && p.y <= hi.y && p.z <= hi.z) { add(i); }
+        }
+    }
+
+    void selectSphere(const ClothMesh& mesh, const glm::vec3& center, float radius) {
+        for (uint32_t i = 0; i < mesh.vertexCount(); i++) {
+            if (glm::distance(mesh.positions[i], center) <= radius) { add(i); }
+        }
+    }
+
+    void selectNearest(const ClothMesh& mesh, const glm::vec3& target) {
+        uint32_t best = 0;
+        float bestDist = std::numeric_limits<float>::max();
+        for (uint32_t i = 0; i < mesh.vertexCount(); i++) {
+            float d = glm::distance(mesh.positions[i], target);
+            if (d < bestDist) {
+                bestDist = d;
+                best = i;
+            }
+        }
+        if (mesh.vertexCount()) { add(best); }
+    }
+
+    void selectColor(const std::vector<glm::vec3>& colors, const glm::vec3& color, float tolerance) {
+        for (uint32_t i = 0; i < colors.size(); i++) {
+            glm::vec3 d = colors[i] - color;
+            if (std::abs(d.x) <= tolerance && std::abs(d.y) <= tolerance && std::abs(d.z) <= tolerance) { add(i); }
+        }
+    }
+
+    void addKey(const PinKey& key) {
+        auto it = std::upper_bound(keys.begin(), keys.end(), key.time, [](float t, const PinKey& k) { return t < k.time; });
+        keys.insert(it, key);
+    }
+
+    // motion at `time`, linear between keys, held before the first and after the last (or wrapped with loop)
+    PinKey at(float time) const {
+        if (keys.empty()) { return {}; }
+        const float first = keys.front().time, span = keys.back().time - first;
+        if (loop && span > 0.0f) { time = first + std::fmod(std::fmod(time - first, span) + span, span); }
+        if (time <= first) { return keys.front(); }
+        if (time >= keys.back().time) { return keys.back(); }
+        size_t k = 1;
+        while (keys[k].time < time) { k++; }
+        const PinKey& a = keys[k - 1];
+        const PinKey& b = keys[k];
+        float t = (time - a.time) / (b.time - a.time);
+        PinKey key;
+        key.time = time;
+        key.translation = a.translation + (b.translation - a.translation) * t;
+        key.angle = a.angle + (b.angle - a.angle) * t;
+        return key;
+    }
+};
+
+class ClothPins {
+public:
+    std::vector<PinGroup> groups;
+
+    bool empty() const { return groups.empty(); }
+
+    PinGroup& group(const std::string& name) {
+        for (PinGroup& g : groups) {
+            if (g.name == name) { return g; }
+        }
+        groups.push_back({});
+        groups.back().name = name;
+        return groups.back();
+    }
+
+    // only the named groups, in the given order; throws if one is missing
+    ClothPins subset(const std::vector<std::string>& names) const {
+        ClothPins result;
+        for (const std::string& name : names) {
+            auto it = std::find_if(groups.begin(), groups.end(), [&](const PinGroup& g) { return g.name == name; });
+            if (it == groups.end()) { throw std::runtime_error("no pin group named " + name + "!"); }
+            result.groups.push_back(*it);
+        }
+        return result;
+    }
+
+    // membership bitsets and the kinematic arrays for a cloth whose rest positions are x, y, z (particle
+    // order), called by ClothSolver::setPins(). A vertex in several kinematic groups follows the first one.
+    void bind(const float* x, const float* y, const float* z, size_t count) {
+        particleCount = count;
+        pinnedBits.assign((count + 63) / 64, 0);
+        kinematicBits.assign(pinnedBits.size(), 0);
+        particle.clear();
+        rx.clear();
+        ry.clear();
+        rz.clear();
+        groupStart.assign(1, 0);
+        moving.clear();
+        pivots.clear();
+
+        for (uint32_t g = 0; g < groups.size(); g++) {
+            const PinGroup& group = groups[g];
+            for (uint32_t v : group.vertices) {
+                if (v >= count) { throw std::runtime_error("pin group " + group.name + " has a vertex past the end of the cloth!"); }
+                pinnedBits[v >> 6] |= 1ull << (v & 63);
+            }
+            if (!group.kinematic()) { continue; }
+
+            glm::vec3 pivot(0.0f);
+            for (uint32_t v : group.vertices) { pivot += glm::vec3(x[v], y[v], z[v]); }
+            if (!group.vertices.empty()) { pivot = pivot / static_cast<float>(group.vertices.size()); }
+            for (uint32_t v : group.vertices) {
+                if (kinematic(v)) { continue; }
+                kinematicBits[v >> 6] |= 1ull << (v & 63);
+                particle.push_back(v);
+                rx.push_back(x[v] - pivot.x);
+                ry.push_back(y[v] - pivot.y);
+                rz.push_back(z[v] - pivot.z);
+            }
+            moving.push_back(g);
+            pivots.push_back(pivot);
+            groupStart.push_back(static_cast<uint32_t>(particle.size()));
+        }
+    }
+
+    bool pinned(uint32_t i) const { return i < particleCount && (pinnedBits[i >> 6] >> (i & 63)) & 1; }
+    bool kinematic(uint32_t i) const { return i < particleCount && (kinematicBits[i >> 6] >> (i & 63)) & 1; }
+    size_t pinnedCount() const {
+        size_t count = 0;
+        for (uint32_t i = 0; i < particleCount; i++) { count += pinned(i); }
+        return count;
+    }
+    size_t kinematicCount() const { return particle.size(); }
+    bool hasKinematic() const { return !particle.empty(); }
+
+    // every pinned particle, for setting inverse masses
+    template <typename Fn>
+    void forEachPinned(const Fn& fn) const {
+        for (size_t w = 0; w < pinnedBits.size(); w++) {
+            for (uint64_t bits = pinnedBits[w]; bits; bits &= bits - 1) {
+                fn(static_cast<uint32_t>(w * 64 + countTrailingZeros(bits)));
+            }
+        }
+    }
+
+    // kinematic particles where their groups are at `time`
+    void move(float time, float* x, float* y, float* z) const {
+        for (size_t k = 0; k < moving.size(); k++) {
+            const PinGroup& group = groups[moving[k]];
+            const PinKey key = group.at(time);
+            float r[9];
+            rotation(group.axis, key.angle, r);
+            const glm::vec3 t = pivots[k] + key.translation;
+            for (uint32_t e = groupStart[k]; e < groupStart[k + 1]; e++) {
+                uint32_t i = particle[e];
+                x[i] = r[0] * rx[e] + r[1] * ry[e] + r[2] * rz[e] + t.x;
+                y[i] = r[3] * rx[e] + r[4] * ry[e] + r[5] * rz[e] + t.y;
+                z[i] = r[6] * rx[e] + r[7] * ry[e] + r[8] * rz[e] + t.z;
+            }
+        }
+    }
+
+    // the same pins after the particles were renumbered (ClothRemesh.hpp compaction): oldToNew[i] is the new
+    // index of old particle i, NONE (~0u) if it's gone
+    ClothPins remapped(const std::vector<uint32_t>& oldToNew, size_t count) const {
+        ClothPins result = *this;
+        result.particleCount = count;
+        result.pinnedBits.assign((count + 63) / 64, 0);
+        result.kinematicBits.assign(result.pinnedBits.size(), 0);
+        for (PinGroup& group : result.groups) {
+            std::vector<uint32_t> vertices;
+            for (uint32_t v : group.vertices) {
+                if (v < oldToNew.size() && oldToNew[v] != ~0u) { vertices.push_back(oldToNew[v]); }
+            }
+            std::sort(vertices.begin(), vertices.end());
+            vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+            group.vertices = std::move(vertices);
+            for (uint32_t v : group.vertices) { result.pinnedBits[v >> 6] |= 1ull << (v & 63); }
+        }
+        result.particle.clear();
+        result.rx.clear();
+        result.ry.clear();
+        result.rz.clear();
+        result.groupStart.assign(1, 0);
+        for (size_t k = 0; k < moving.size(); k++) {
+            for (uint32_t e = groupStart[k]; e < groupStart[k + 1]; e++) {
+                uint32_t old = particle[e];
+                uint32_t v = old < oldToNew.size() ? oldToNew[old] : ~0u;
+                if (v == ~0u || result.kinematic(v)) { continue; }
+                result.kinematicBits[v >> 6] |= 1ull << (v & 63);
+                result.particle.push_back(v);
+                result.rx.push_back(rx[e]);
+                result.ry.push_back(ry[e]);
+                result.rz.push_back(rz[e]);
+            }
+            result.groupStart.push_back(static_cast<uint32_t>(result.particle.size()));
+        }
+        return result;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = (pinnedBits.capacity() + kinematicBits.capacity()) * sizeof(uint64_t) +
+            (particle.capacity() + groupStart.capacity() + moving.capacity()) * sizeof(uint32_t) +
+            (rx.capacity() + ry.capacity() + rz.capacity()) * sizeof(float) + pivots.capacity() * sizeof(glm::vec3);
+        for (const PinGroup& group : groups) { bytes += group.vertices.capacity() * sizeof(uint32_t) + group.keys.capacity() * sizeof(PinKey); }
+        return bytes;
+    }
+
+private:
+    size_t particleCount = 0;
+    std::vector<uint64_t> pinnedBits, kinematicBits; // bit i = particle i
+    std::vector<uint32_t> particle;                  // kinematic particles, grouped by moving group
+    std::vector<float> rx, ry, rz;                   // their rest offsets from the group pivot
+    std::vector<uint32_t> groupStart;                // moving group k owns [groupStart[k], groupStart[k + 1])
+    std::vector<uint32_t> moving;                    // kinematic group indices
+    std::vector<glm::vec3> pivots;                   // rest centroid per moving group
+
+    static uint32_t countTrailingZeros(uint64_t bits) {
+        uint32_t n = 0;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            n++;
+        }
+        return n;
+    }
+
+    // row major rotation about a unit `axis` (Rodrigues)
+    static void rotation(glm::vec3 axis, float angle, float r[9]) {
+        float length = glm::length(axis);
+        axis = length > 0.0f ? axis / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        const float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+        r[0] = c + t * axis.x * axis.x;          r[1] = t * axis.x * axis.y - s * axis.z; r[2] = t * axis.x * axis.z + s * axis.y;
+        r[3] = t * axis.x * axis.y + s * axis.z; r[4] = c + t * axis.y * axis.y;          r[5] = t * axis.y * axis.z - s * axis.x;
+        r[6] = t * axis.x * axis.z - s * axis.y; r[7] = t * axis.y * axis.z + s * axis.x; r[8] = c + t * axis.z * axis.z;
+    }
+};
+
+// per vertex colors of an OBJ (`v x y z r g b`), in vertex order; empty if no vertex has one
+// (the bundled tiny_obj_loader drops them, so this reads the vertex lines itself)
+inline std::vector<glm::vec3> loadObjVertexColors(const std::string& objPath) {
+    std::ifstream in(objPath);
+    if (!in) { throw std::runtime_error("failed to open " + objPath + "!"); }
+    std::vector<glm::vec3> colors;
+    bool any = false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.size() < 2 || line[0] != 'v' || (line[1] != ' ' && line[1] != '\t')) { continue; }
+        const char* p = line.c_str() + 1;
+        float values[6];
+        int count = 0;
+        for (char* end = nullptr; count < 6; count++) {
+            values[count] = std::strtof(p, &end);
+            if (end == p) { break; }
+            p = end;
+        }
+        any = any || count == 6;
+        colors.push_back(count == 6 ? glm::vec3(values[3], values[4], values[5]) : glm::vec3(1.0f));
+    }
+    if (!any) { colors.clear(); }
+    return colors;
+}
+
+// one group per distinct vertex color other than white, named "#rrggbb"
+inline ClothPins pinsFromVertexColors(const std::vector<glm::vec3>& colors) {
+    ClothPins pins;
+    for (uint32_t i = 0; i < colors.size(); i++) {
+        const glm::vec3& c = colors[i];
+        uint32_t r = static_cast<uint32_t>(glm::clamp(c.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+        uint32_t g = static_cast<uint32_t>(glm::clamp(c.y, 0.0f, 1.0f) * 255.0f + 0.5f);
+        uint32_t b = static_cast<uint32_t>(glm::clamp(c.z, 0.0f, 1.0f) * 255.0f + 0.5f);
+        if (r == 255 && g == 255 && b == 255) { continue; }
+        char name[8];
+        std::snprintf(name, sizeof(name), "#%02x%02x%02x", r, g, b);
+        pins.group(name).vertices.push_back(i); // ascending already
+    }
+    return pins;
+}
+
+// pin file (format at the top) resolved against `mesh`, the cloth as loaded from `objPath`
+inline ClothPins parseClothPins(std::istream& in, const std::string& objPath, const ClothMesh& mesh) {
+    ClothPins pins;
+    PinGroup* group = nullptr;
+    std::vector<glm::vec3> colors;
+    bool colorsLoaded = false;
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::string keyword;
+        if (!(words >> keyword)) { continue; }
+        auto fail = [&](const std::string& what) {
+            return std::runtime_error("pin file line " + std::to_string(lineNumber) + ": " + what + "!");
+        };
+        if (keyword == "group") {
+            std::string name;
+            if (!(words >> name)) { throw fail("group needs a name"); }
+            group = &pins.group(name);
+            continue;
+        }
+        if (group == nullptr) { throw fail(keyword + " before the first group"); }
+
+        if (keyword == "vertices") {
+            uint32_t v;
+            while (words >> v) {
+                if (v >= mesh.vertexCount()) { throw fail("vertex " + std::to_string(v) + " out of range"); }
+                group->add(v);
+            }
+            if (!words.eof()) { throw fail("bad vertex index"); }
+        }
+        else if (keyword == "box") {
+            glm::vec3 lo, hi;
+            if (!(words >> lo.x >> lo.y >> lo.z >> hi.x >> hi.y >> hi.z)) { throw fail("box needs two corners"); }
+            group->selectBox(mesh, glm::min(lo, hi), glm::max(lo, hi));
+        }
+        else if (keyword == "sphere") {
+            glm::vec3 center;
+            float radius;
+            if (!(words >> center.x >> center.y >> center.z >> radius)) { throw fail("sphere needs a center and a radius"); }
+            group->selectSphere(mesh, center, radius);
+        }
+        else if (keyword == "nearest") {
+            glm::vec3 target;
+            if (!(words >> target.x >> target.y >> target.z)) { throw fail("nearest needs a point"); }
+            group->selectNearest(mesh, target);
+        }
+        else if (keyword == "color") {
+            glm::vec3 color;
+            float tolerance = 0.1f;
+            if (!(words >> color.x >> color.y >> color.z)) { throw fail("color needs r g b"); }
+            words >> tolerance;
+            if (!colorsLoaded) {
+                colors = loadObjVertexColors(objPath);
+                colorsLoaded = true;
+            }
+            if (colors.size() != mesh.vertexCount()) { throw fail(objPath + " has no vertex colors"); }
+            group->selectColor(colors, color, tolerance);
+        }
+        else if (keyword == "axis") {
+            if (!(words >> group->axis.x >> group->axis.y >> group->axis.z)) { throw fail("axis needs x y z"); }
+        }
+        else if (keyword == "key") {
+            PinKey key;
+            float degrees = 0.0f;
+            if (!(words >> key.time >> key.translation.x >> key.translation.y >> key.translation.z)) { throw fail("key needs t tx ty tz"); }
+            words >> degrees;
+            key.angle = glm::radians(degrees);
+            group->addKey(key);
+        }
+        else if (keyword == "loop") {
+            group->loop = true;
+        }
+        else {
+            throw fail("unknown statement " + keyword);
+        }
+    }
+    return pins;
+}
+
+inline std::string pinFilePath(const std::string& objPath) {
+    size_t dot = objPath.find_last_of('.');
+    size_t slash = objPath.find_last_of("/\\");
+    return (dot != std::string::npos && (slash == std::string::npos || dot > slash) ? objPath.substr(0, dot) : objPath) + ".pins";
+}
+
+// pins of an OBJ cloth: its sidecar pin file if there is one, otherwise its vertex colors (possibly none)
+inline ClothPins loadClothPins(const std::string& objPath, const ClothMesh& mesh) {
+    std::ifstream in(pinFilePath(objPath));
+    if (in) { return parseClothPins(in, objPath, mesh); }
+    std::vector<glm::vec3> colors = loadObjVertexColors(objPath);
+    return colors.size() == mesh.vertexCount() ? pinsFromVertexColors(colors) : ClothPins{};
+}
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,551 @@
+#pragma once
+#include "ClothMesh.hpp"
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Adaptive remeshing
+// A uniform mesh spends as many particles on flat, relaxed cloth as on folds. remesh() (every few frames)
+// moves them to where they matter:
+// - refine: edges folded more than refineAngle between their two triangles, or strained more than
+//   refineStrain, are split at their midpoint. Each pass splits an independent set (no two in one triangle),
+//   so every split is the textbook 2 -> 4 triangle edit
+// - coarsen: interior vertices whose edges are all flat and relaxed are collapsed into a neighbor, if the
+//   ring stays a manifold (link condition) and no triangle flips, in rest space or now
+// - compact: dead particles and triangles are squeezed out, so every solver array stays dense
+// - constraints come from the new triangles, the ones that existed before keep their color and only new
+//   (or now conflicting) ones are colored greedily around them; recolors everything only if that runs out
+//   of colors
+// Rest lengths and masses come from rest positions the remesher keeps per particle (split vertices get the
+// midpoint), so remeshing never changes the rest shape of the cloth, only how finely it is sampled.
+// Remeshing rebuilds arrays and allocates, it runs between steps and not together with ClothTearing.
+// Strain limits (ClothStrainLimit.hpp) and FEM elements (ClothFem.hpp) are dropped, the remeshed cloth has no
+// uvs to build them from and goes back to springs.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct RemeshSettings {
+    float refineAngle = 0.5f;    // radians between the normals of an edge's triangles, more gets split
+    float coarsenAngle = 0.05f;  // a vertex whose edges are all flatter than this can go
+    float refineStrain = 0.5f;   // edges stretched or squashed by more than this get split
+    float coarsenStrain = 0.05f; // a vertex whose edges are all strained less than this can go
+    float minQuality = 0.3f;     // collapses leave no rest triangle worse than this (1 = equilateral)
+    float minEdge = 0.0f;        // no splits below this rest length, 0 = half the mean edge at attach()
+    float maxEdge = 0.0f;        // no collapses that leave a longer rest edge, 0 = twice the mean edge
+    uint32_t refinePasses = 3;   // each pass splits an independent set of edges
+    uint32_t maxParticles = 0;   // budget, the worst folds are refined first; 0 = twice the particles at attach()
+};
+
+struct RemeshStats {
+    uint32_t splits = 0;
+    uint32_t collapses = 0;
+    uint32_t particlesBefore = 0;
+    uint32_t particlesAfter = 0;
+    uint32_t recolored = 0;      // constraints that needed a new color, the others kept theirs
+    bool fullRecolor = false;
+    int64_t ns = 0;
+};
+
+class ClothRemesher {
+public:
+    RemeshSettings settings;
+
+    // the solver's current positions become the rest shape, call right after building it
+    void attach(const ClothSolver& solver, const RemeshSettings& remeshSettings) {
+        settings = remeshSettings;
+        const ParticleStore& p = solver.particles;
+        rest.resize(p.size());
+        for (size_t i = 0; i < p.size(); i++) { rest[i] = p.position(i); }
+
+        const DistanceConstraints& c = solver.stretch;
+        double sum = 0.0;
+        for (size_t k = 0; k < c.size(); k++) { sum += c.restLength[k]; }
+        float mean = c.size() ? static_cast<float>(sum / c.size()) : 1.0f;
+        if (settings.minEdge <= 0.0f) { settings.minEdge = 0.5f * mean; }
+        if (settings.maxParticles == 0) { settings.maxParticles = 2 * static_cast<uint32_t>(p.size()); }
+        if (settings.maxEdge <= 0.0f) { settings.maxEdge = 2.0f * mean; }
+    }
+
+    const RemeshStats& remesh(ClothSolver& solver) {
+        PROFILE_ZONE("ClothRemesher::remesh");
+        int64_t start = CpuProfiler::nowNs();
+        stats = RemeshStats{};
+        stats.particlesBefore = static_cast<uint32_t>(solver.particles.size());
+
+        // working copy, split vertices are appended and collapsed ones are left behind for compact()
+        solver.triangles.indices(indices);
+        const size_t n = solver.particles.size();
+        origin.resize(n);
+        for (uint32_t i = 0; i < n; i++) { origin[i] = i; }
+        pinned.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            pinned[i] = solver.particles.invMass[i] != 0.0f ? 0 : solver.pins && solver.pins->kinematic(uint32_t(i)) ? KINEMATIC : 1;
+        }
+        density.clear();
+        if (solver.areaDensity.size() == n) { density = solver.areaDensity; }
+        remap.assign(n, NONE);
+
+        for (uint32_t pass = 0; pass < settings.refinePasses; pass++) {
+            if (refine(solver.particles) == 0) { break; }
+        }
+        coarsen(solver.particles);
+        compact(solver);
+        rebuildConstraints(solver);
+
+        stats.particlesAfter = static_cast<uint32_t>(solver.particles.size());
+        stats.ns = CpuProfiler::nowNs() - start;
+        return stats;
+    }
+
+    const RemeshStats& lastStats() const { return stats; }
+    const std::vector<glm::vec3>& restPositions() const { return rest; }
+
+private:
+    static constexpr uint32_t NONE = ~0u;
+    static constexpr uint8_t KINEMATIC = 2; // pinned[] value of particles a kinematic pin group moves (ClothPins.hpp)
+
+    struct Edge {
+        uint32_t a, b;
+        uint32_t t0, t1; // triangles on either side, t1 = NONE on the boundary
+    };
+
+    std::vector<glm::vec3> rest;    // rest position per particle
+    std::vector<uint32_t> indices;  // working triangles, 3 per triangle, a dead one starts with NONE
+    std::vector<uint32_t> origin;   // old particle per working vertex (NONE = made by a split)
+    std::vector<uint8_t> pinned;    // 0 = free, 1 = pinned, KINEMATIC
+    std::vector<float> density;     // area density per particle from painted fabrics (ClothMaterials.hpp), or empty
+    std::vector<uint32_t> remap;    // collapsed vertex -> the vertex it merged into
+    std::vector<uint32_t> oldToNew; // particle before the remesh -> after, NONE = gone
+    std::vector<Edge> edges;
+    std::vector<uint32_t> edgeHead;      // first edge whose lower vertex is this one
+    std::vector<uint32_t> edgeNext;      // next edge with the same lower vertex
+    std::vector<uint32_t> triangleEdges; // 3 per triangle, edge e runs from corner e to corner e + 1
+    RemeshStats stats;
+
+    struct PreviousColor {
+        uint32_t other, color, next, constraint;
+    };
+    std::vector<uint32_t> previousHead;     // recolor(): old constraint chains per lower endpoint
+    std::vector<PreviousColor> previous;
+    std::vector<uint32_t> vertexConstraint; // recolor(): some old constraint at each vertex, NONE = new vertex
+
+    // edges in first seen order, found through a chain per lower vertex instead of a hash map (this runs a few
+    // times per remesh over every triangle)
+    void buildEdges() {
+        edges.clear();
+        edgeNext.clear();
+        edgeHead.assign(rest.size(), NONE);
+        triangleEdges.assign(indices.size(), NONE);
+        for (uint32_t t = 0; t < indices.size() / 3; t++) {
+            if (indices[3 * t] == NONE) { continue; }
+            for (int e = 0; e < 3; e++) {
+                uint32_t a = indices[3 * t + e], b = indices[3 * t + (e + 1) % 3];
+                if (a > b) { std::swap(a, b); }
+                uint32_t k = edgeHead[a];
+                while (k != NONE && edges[k].b != b) { k = edgeNext[k]; }
+                if (k == NONE) {
+                    k = static_cast<uint32_t>(edges.size());
+                    edges.push_back({ a, b, t, NONE });
+                    edgeNext.push_back(edgeHead[a]);
+                    edgeHead[a] = k;
+                }
+                else if (edges[k].t1 == NONE) { edges[k].t1 = t; }
+                triangleEdges[3 * t + e] = k;
+            }
+        }
+    }
+
+    uint32_t opposite(uint32_t t, const Edge& e) const {
+        const uint32_t* tri = indices.data() + 3 * t;
+        return tri[0] != e.a && tri[0] != e.b ? tri[0] : tri[1] != e.a && tri[1] != e.b ? tri[1] : tri[2];
+    }
+
+    glm::vec3 normal(const ParticleStore& p, uint32_t t) const {
+        glm::vec3 a = p.position(indices[3 * t]), b = p.position(indices[3 * t + 1]), c = p.position(indices[3 * t + 2]);
+        return glm::cross(b - a, c - a);
+    }
+
+    glm::vec3 restNormal(uint32_t t) const {
+        const glm::vec3& a = rest[indices[3 * t]];
+        return glm::cross(rest[indices[3 * t + 1]] - a, rest[indices[3 * t + 2]] - a);
+    }
+
+    // cos of the fold angle across an interior edge, 1 = flat (also for degenerate triangles)
+    float foldCos(const ParticleStore& p, const Edge& e) const {
+        glm::vec3 n0 = normal(p, e.t0), n1 = normal(p, e.t1);
+        float l = glm::length(n0) * glm::length(n1);
+        return l > 0.0f ? glm::dot(n0, n1) / l : 1.0f;
+    }
+
+    float strain(const ParticleStore& p, const Edge& e) const {
+        float restLength = glm::distance(rest[e.a], rest[e.b]);
+        return restLength > 0.0f ? std::abs(glm::distance(p.position(e.a), p.position(e.b)) / restLength - 1.0f) : 0.0f;
+    }
+
+    // one pass of midpoint splits, returns how many
+    uint32_t refine(ParticleStore& p) {
+        buildEdges();
+        const float foldLimit = std::cos(settings.refineAngle);
+
+        // an edge that folds or strains too much flags its triangles, and a flagged triangle gets its longest
+        // rest edge split (longest edge bisection, so repeated refinement never makes slivers)
+        std::vector<std::pair<float, uint32_t>> candidates;
+        for (uint32_t k = 0; k < edges.size(); k++) {
+            const Edge& e = edges[k];
+            float fold = e.t1 != NONE ? 1.0f - foldCos(p, e) : 0.0f;
+            float s = strain(p, e);
+            if (fold > 1.0f - foldLimit || s > settings.refineStrain) {
+                float score = std::max(fold / (1.0f - foldLimit), s / settings.refineStrain);
+                for (uint32_t t : { e.t0, e.t1 }) {
+                    if (t == NONE) { continue; }
+                    uint32_t longest = longestEdge(t);
+                    if (0.5f * glm::distance(rest[edges[longest].a], rest[edges[longest].b]) >= settings.minEdge) {
+                        candidates.push_back({ score, longest });
+                    }
+                }
+            }
+        }
+        // worst first, each triangle takes part in one split at most
+        std::stable_sort(candidates.begin(), candidates.end(), [](const auto& l, const auto& r) { return l.first > r.first; });
+
+        std::vector<uint8_t> used(indices.size() / 3, 0);
+        uint32_t splits = 0;
+        for (const auto& candidate : candidates) {
+            if (p.size() >= settings.maxParticles) { break; }
+            const Edge e = edges[candidate.second];
+            if (used[e.t0] || (e.t1 != NONE && used[e.t1])) { continue; }
+            // the midpoint would be pinned in place, no kinematic group would move it
+            if (pinned[e.a] && pinned[e.b] && ((pinned[e.a] | pinned[e.b]) & KINEMATIC)) { continue; }
+            used[e.t0] = 1;
+            if (e.t1 != NONE) { used[e.t1] = 1; }
+
+            uint32_t m = addVertex(p, e.a, e.b);
+            splitTriangle(e.t0, e.a, e.b, m);
+            if (e.t1 != NONE) { splitTriangle(e.t1, e.a, e.b, m); }
+            splits++;
+        }
+        stats.splits += splits;
+        return splits;
+    }
+
+    uint32_t longestEdge(uint32_t t) const {
+        uint32_t best = NONE;
+        float bestLength = -1.0f;
+        for (int e = 0; e < 3; e++) {
+            uint32_t a = indices[3 * t + e], b = indices[3 * t + (e + 1) % 3];
+            float length = glm::distance(rest[a], rest[b]);
+            if (length > bestLength) {
+                bestLength = length;
+                best = triangleEdges[3 * t + e];
+            }
+        }
+        return best;
+    }
+
+    // 1 for an equilateral triangle, 0 for a degenerate one
+    static float quality(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+        float squares = glm::dot(b - a, b - a) + glm::dot(c - b, c - b) + glm::dot(a - c, a - c);
+        return squares > 0.0f ? 2.0f * std::sqrt(3.0f) * glm::length(glm::cross(b - a, c - a)) / squares : 0.0f;
+    }
+
+    // midpoint of a and b in every sense: position, velocity, rest position; pinned only between two pins
+    uint32_t addVertex(ParticleStore& p, uint32_t a, uint32_t b) {
+        uint32_t m = static_cast<uint32_t>(p.size());
+        p.resize(m + 1);
+        auto mid = [&](std::vector<float>& v) { v[m] = 0.5f * (v[a] + v[b]); };
+        for (auto* v : { &p.x, &p.y, &p.z, &p.px, &p.py, &p.pz, &p.vx, &p.vy, &p.vz }) { mid(*v); }
+        p.invMass[m] = 1.0f; // real masses come from the rest areas in rebuildConstraints()
+        rest.push_back(0.5f * (rest[a] + rest[b]));
+        origin.push_back(NONE);
+        pinned.push_back(pinned[a] && pinned[b]);
+        if (!density.empty()) { density.push_back(0.5f * (density[a] + density[b])); }
+        remap.push_back(NONE);
+        return m;
+    }
+
+    // triangle t has edge (a, b): t = (u, v, w) with (u, v) that edge becomes (u, m, w) and a new (m, v, w)
+    void splitTriangle(uint32_t t, uint32_t a, uint32_t b, uint32_t m) {
+        uint32_t* tri = indices.data() + 3 * t;
+        int e = 0;
+        while (!((tri[e] == a && tri[(e + 1) % 3] == b) || (tri[e] == b && tri[(e + 1) % 3] == a))) { e++; }
+        uint32_t u = tri[e], v = tri[(e + 1) % 3], w = tri[(e + 2) % 3];
+        tri[0] = u;
+        tri[1] = m;
+        tri[2] = w;
+        indices.push_back(m);
+        indices.push_back(v);
+        indices.push_back(w);
+    }
+
+    void coarsen(const ParticleStore& p) {
+        buildEdges();
+        const size_t n = p.size();
+        const float foldLimit = std::cos(settings.coarsenAngle);
+
+        // vertex -> triangles
+        std::vector<uint32_t> start(n + 1, 0), ring;
+        for (uint32_t v : indices) { if (v != NONE) { start[v + 1]++; } }
+        for (size_t i = 0; i < n; i++) { start[i + 1] += start[i]; }
+        std::vector<uint32_t> vertexTriangles(start[n]), fill(start.begin(), start.end() - 1);
+        for (uint32_t t = 0; t < indices.size() / 3; t++) {
+            if (indices[3 * t] == NONE) { continue; }
+            for (int k = 0; k < 3; k++) { vertexTriangles[fill[indices[3 * t + k]]++] = t; }
+        }
+
+        // removable = interior, free, and every edge around it flat and relaxed
+        std::vector<uint8_t> removable(n, 1);
+        for (size_t i = 0; i < n; i++) { removable[i] = !pinned[i] && start[i + 1] > start[i]; }
+        for (const Edge& e : edges) {
+            bool calm = e.t1 != NONE && foldCos(p, e) >= foldLimit && strain(p, e) <= settings.coarsenStrain;
+            if (!calm) { removable[e.a] = removable[e.b] = 0; }
+        }
+
+        std::vector<uint8_t> locked(n, 0);
+        std::vector<uint32_t> other;
+        for (uint32_t j = 0; j < n; j++) {
+            if (!removable[j] || locked[j]) { continue; }
+            ringOf(j, start, vertexTriangles, ring);
+            bool free = true;
+            for (uint32_t k : ring) { free = free && !locked[k]; }
+            if (!free) { continue; }
+
+            // the neighbor that leaves the shortest longest edge
+            uint32_t target = NONE;
+            float best = settings.maxEdge;
+            for (uint32_t i : ring) {
+                float longest = 0.0f;
+                for (uint32_t k : ring) { if (k != i) { longest = std::max(longest, glm::distance(rest[i], rest[k])); } }
+                if (longest <= best && canCollapse(p, j, i, ring, start, vertexTriangles, other)) {
+                    best = longest;
+                    target = i;
+                }
+            }
+            if (target == NONE) { continue; }
+
+            for (uint32_t s = start[j]; s < start[j + 1]; s++) {
+                uint32_t* tri = indices.data() + 3 * vertexTriangles[s];
+                if (tri[0] == target || tri[1] == target || tri[2] == target) {
+                    tri[0] = NONE; // the two triangles on the collapsed edge
+                    continue;
+                }
+                for (int k = 0; k < 3; k++) { if (tri[k] == j) { tri[k] = target; } }
+            }
+            remap[j] = target;
+            locked[j] = 1;
+            for (uint32_t k : ring) { locked[k] = 1; }
+            stats.collapses++;
+        }
+    }
+
+    // distinct neighbors of v
+    void ringOf(uint32_t v, const std::vector<uint32_t>& start, const std::vector<uint32_t>& vertexTriangles, std::vector<uint32_t>& out) const {
+        out.clear();
+        for (uint32_t s = start[v]; s < start[v + 1]; s++) {
+            const uint32_t* tri = indices.data() + 3 * vertexTriangles[s];
+            for (int k = 0; k < 3; k++) {
+                if (tri[k] != v && std::find(out.begin(), out.end(), tri[k]) == out.end()) { out.push_back(tri[k]); }
+            }
+        }
+    }
+
+    // j can merge into i if only the two triangles on edge (i, j) share both their rings (link condition) and
+    // no other triangle of j turns over (now or at rest) or turns into a sliver
+    bool canCollapse(const ParticleStore& p, uint32_t j, uint32_t i, const std::vector<uint32_t>& ring, const std::vector<uint32_t>& start,
+            const std::vector<uint32_t>& vertexTriangles, std::vector<uint32_t>& other) const {
+        ringOf(i, start, vertexTriangles, other);
+        uint32_t shared = 0, onEdge = 0;
+        for (uint32_t s = start[j]; s < start[j + 1]; s++) {
+            const uint32_t* tri = indices.data() + 3 * vertexTriangles[s];
+            onEdge += tri[0] == i || tri[1] == i || tri[2] == i;
+        }
+        for (uint32_t k : ring) { shared += std::find(other.begin(), other.end(), k) != other.end(); }
+        if (onEdge != 2 || shared != 2) { return false; }
+
+        for (uint32_t s = start[j]; s < start[j + 1]; s++) {
+            uint32_t t = vertexTriangles[s];
+            const uint32_t* tri = indices.data() + 3 * t;
+            if (tri[0] == i || tri[1] == i || tri[2] == i) { continue; }
+            glm::vec3 corners[3], restCorners[3];
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = tri[k] == j ? i : tri[k];
+                corners[k] = p.position(v);
+                restCorners[k] = rest[v];
+            }
+            glm::vec3 moved = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            glm::vec3 restMoved = glm::cross(restCorners[1] - restCorners[0], restCorners[2] - restCorners[0]);
+            if (glm::dot(moved, normal(p, t)) <= 0.0f || glm::dot(restMoved, restNormal(t)) <= 0.0f) { return false; }
+            if (quality(restCorners[0], restCorners[1], restCorners[2]) < settings.minQuality) { return false; }
+        }
+        return true;
+    }
+
+    // drops dead triangles and unreferenced vertices, renumbering in the old order (split vertices last)
+    void compact(ClothSolver& solver) {
+        ParticleStore& p = solver.particles;
+        const size_t n = p.size();
+        std::vector<uint32_t> newIndex(n, NONE);
+        size_t live = 0;
+        for (size_t t = 0; t < indices.size() / 3; t++) {
+            if (indices[3 * t] == NONE) { continue; }
+            for (int k = 0; k < 3; k++) { indices[3 * live + k] = indices[3 * t + k]; }
+            for (int k = 0; k < 3; k++) { newIndex[indices[3 * live + k]] = 0; }
+            live++;
+        }
+        indices.resize(3 * live);
+        uint32_t count = 0;
+        for (size_t i = 0; i < n; i++) { if (newIndex[i] != NONE) { newIndex[i] = count++; } }
+        for (uint32_t& v : indices) { v = newIndex[v]; }
+
+        // old particle -> new particle, following collapses (a merged vertex lives on in the one it merged into)
+        oldToNew.assign(origin.size(), NONE);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t target = static_cast<uint32_t>(i);
+            while (remap[target] != NONE) { target = remap[target]; }
+            if (origin[i] != NONE) { oldToNew[origin[i]] = newIndex[target]; }
+        }
+
+        ParticleStore compacted;
+        compacted.resize(count);
+        std::vector<glm::vec3> compactRest(count);
+        std::vector<uint8_t> compactPinned(count);
+        std::vector<float> compactDensity(density.empty() ? 0 : count);
+        ContactCache contacts;
+        contacts.resize(count);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t d = newIndex[i];
+            if (d == NONE) { continue; }
+            for (auto field : { &ParticleStore::x, &ParticleStore::y, &ParticleStore::z, &ParticleStore::px, &ParticleStore::py,
+                    &ParticleStore::pz, &ParticleStore::vx, &ParticleStore::vy, &ParticleStore::vz }) {
+                (compacted.*field)[d] = (p.*field)[i];
+            }
+            compactRest[d] = rest[i];
+            compactPinned[d] = pinned[i];
+            if (!density.empty()) { compactDensity[d] = density[i]; }
+            if (origin[i] != NONE) {
+                const ContactCache& old = solver.contacts;
+                uint32_t o = origin[i];
+                contacts.collider[d] = old.collider[o];
+                contacts.feature[d] = old.feature[o];
+                contacts.ax[d] = old.ax[o];
+                contacts.ay[d] = old.ay[o];
+                contacts.az[d] = old.az[o];
+            }
+        }
+
+        // lumped masses from the rest areas, like ClothSolver::build()
+        std::vector<float> mass(count, 0.0f);
+        for (size_t t = 0; t < live; t++) {
+            uint32_t i0 = indices[3 * t], i1 = indices[3 * t + 1], i2 = indices[3 * t + 2];
+            float area = 0.5f * glm::length(glm::cross(compactRest[i1] - compactRest[i0], compactRest[i2] - compactRest[i0]));
+            float third = area * solver.params.areaDensity / 3.0f;
+            if (!density.empty()) { third = area * (compactDensity[i0] + compactDensity[i1] + compactDensity[i2]) / 9.0f; }
+            mass[i0] += third;
+            mass[i1] += third;
+            mass[i2] += third;
+        }
+        for (size_t i = 0; i < count; i++) {
+            compacted.invMass[i] = compactPinned[i] || mass[i] <= 0.0f ? 0.0f : 1.0f / mass[i];
+        }
+
+        p = std::move(compacted);
+        solver.contacts = std::move(contacts);
+        if (solver.pins) { solver.pins = std::make_shared<const ClothPins>(solver.pins->remapped(oldToNew, count)); }
+        rest = std::move(compactRest);
+        pinned = std::move(compactPinned);
+        density = std::move(compactDensity);
+        if (!density.empty()) { solver.areaDensity = density; }
+        solver.triangles.assign(indices, count);
+        solver.strainLimits.reset(); // its triangles are gone and new vertices have no uvs
+        solver.elements.reset();     // back to springs, remeshed stretch constraints keep rest lengths
+    }
+
+    // same constraints as ClothSolver::build() gets from buildClothEdges(), stretch along every edge and bend
+    // across every interior one, but straight from the remesher's own edge list
+    void rebuildConstraints(ClothSolver& solver) {
+        buildEdges();
+        DistanceConstraints stretch, bend;
+        for (const Edge& e : edges) {
+            stretch.add(e.a, e.b, glm::distance(rest[e.a], rest[e.b]), solver.params.stretchCompliance);
+            if (e.t1 != NONE) {
+                uint32_t i = opposite(e.t0, e), j = opposite(e.t1, e);
+                bend.add(i, j, glm::distance(rest[i], rest[j]), solver.params.bendCompliance);
+            }
+        }
+        recolor(solver.stretch, stretch);
+        recolor(solver.bend, bend);
+        solver.stretch = std::move(stretch);
+        solver.bend = std::move(bend);
+        solver.topologyHash = solver.computeTopologyHash();
+    }
+
+    // colors `fresh` keeping the color every constraint already had in `old` (endpoints mapped through the
+    // remesh) where that doesn't clash, the rest go greedy around them. Compliances carry over the same way, so
+    // painted fabrics (ClothMaterials.hpp) survive: a kept edge keeps its own, a new one takes the compliance
+    // of an old constraint at one of its ends.
+    void recolor(const DistanceConstraints& old, DistanceConstraints& fresh) {
+        const uint32_t MAX_COLORS = 64;
+        // old constraints chained by their lower (new) endpoint, like buildEdges()
+        previousHead.assign(rest.size(), NONE);
+        previous.clear();
+        vertexConstraint.assign(rest.size(), NONE);
+        for (uint32_t c = 0; c < old.colorCount(); c++) {
+            for (uint32_t k = old.colorOffsets[c]; k < old.colorOffsets[c + 1]; k++) {
+                if (!old.active(k)) { continue; }
+                uint32_t i = oldToNew[old.a[k]], j = oldToNew[old.b[k]];
+                if (i == NONE || j == NONE || i == j) { continue; }
+                if (i > j) { std::swap(i, j); }
+                if (vertexConstraint[i] == NONE) { vertexConstraint[i] = k; }
+                if (vertexConstraint[j] == NONE) { vertexConstraint[j] = k; }
+                previous.push_back({ j, c, previousHead[i], k });
+                previousHead[i] = static_cast<uint32_t>(previous.size() - 1);
+            }
+        }
+
+        std::vector<uint64_t> used(rest.size(), 0);
+        std::vector<uint32_t> colors(fresh.size(), NONE);
+        uint32_t colorCount = 0;
+        for (size_t k = 0; k < fresh.size(); k++) {
+            uint32_t i = std::min(fresh.a[k], fresh.b[k]), j = std::max(fresh.a[k], fresh.b[k]);
+            uint32_t q = previousHead[i];
+            while (q != NONE && previous[q].other != j) { q = previous[q].next; }
+            if (q == NONE) {
+                uint32_t from = vertexConstraint[i] != NONE ? vertexConstraint[i] : vertexConstraint[j];
+                if (from != NONE) { fresh.compliance[k] = old.compliance[from]; }
+                continue;
+            }
+            fresh.compliance[k] = old.compliance[previous[q].constraint];
+            uint32_t c = previous[q].color;
+            uint64_t bit = 1ull << c;
+            if ((used[i] | used[j]) & bit) { continue; }
+            colors[k] = c;
+            used[i] |= bit;
+            used[j] |= bit;
+            colorCount = std::max(colorCount, c + 1);
+        }
+        for (size_t k = 0; k < fresh.size(); k++) {
+            if (colors[k] != NONE) { continue; }
+            uint64_t taken = used[fresh.a[k]] | used[fresh.b[k]];
+            uint32_t c = 0;
+            while (c < MAX_COLORS && (taken & (1ull << c))) { c++; }
+            if (c == MAX_COLORS) {
+                stats.fullRecolor = true;
+                fresh.color(rest.size());
+                return;
+            }
+            colors[k] = c;
+            used[fresh.a[k]] |= 1ull << c;
+            used[fresh.b[k]] |= 1ull << c;
+            colorCount = std::max(colorCount, c + 1);
+            stats.recolored++;
+        }
+        fresh.sortByColor(colors, colorCount);
+    }
+};
+
+#include "ClothFloatPreciseEnd.hpp"
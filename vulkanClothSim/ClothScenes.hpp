@@ -0,0 +1,124 @@
+#pragma once
+#include "ClothGrid.hpp"
+#include "ClothMaterials.hpp"
+#include "ClothMesh.hpp"
+#include "ClothPins.hpp"
+#include "ClothSolver.hpp"
+#include "MeshCache.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Standard scenes shared by the benchmark and the batch tools
+// Every scene is built from the files in resources/models (or a procedural grid) with fixed
+// parameters so results are comparable between versions.
+// Pins of the OBJ cloths come from resources/models/clothplane.pins (ClothPins.hpp), each scene picks its groups.
+//   hanging  clothplane.obj turned upright, pinned at its two top corners
+//   sphere   clothplane.obj dropped onto sphereWTex.obj
+//   bunny    clothplain.obj draped over bunny.obj
+//   grid     procedural n x n grid (ClothGrid.hpp) pinned at two corners
+//   flag     clothplane.obj upright, pinned along its left edge, turbulent wind blowing along it
+//   banner   clothplane.obj upright, pinned along its top edge, gusty wind blowing into it
+//   curtain  clothplane.obj upright, its top edge on a kinematic rail that slides, swings and tilts
+//   patchwork clothplane.obj upright, pinned along its top edge, silk and denim panels over a canvas hem
+//            (fabrics painted in clothplane.fabrics, ClothMaterials.hpp)
+
+#include "ClothFloatPreciseBegin.hpp"
+
+inline const std::vector<std::string>& standardSceneNames() {
+    static const std::vector<std::string> names = { "hanging", "sphere", "bunny", "grid", "flag", "banner", "curtain", "patchwork" };
+    return names;
+}
+
+struct SceneOptions {
+    std::string resourceDir = "../resources";
+    uint32_t gridResolution = 64;
+    std::string meshCacheDir; // binary mesh cache (MeshCache.hpp), empty = always parse the OBJ files
+    SolverParams params;
+};
+
+// fills `solver` with the named scene, returns the cloth mesh it was built from
+inline ClothMesh buildScene(const std::string& name, const SceneOptions& options, ClothSolver& solver) {
+    const std::string models = options.resourceDir + "/models/";
+    ClothMesh cloth;
+    ClothPins pins;
+    ClothMaterials materials;
+    ColliderSet colliders;
+    solver.wind.reset();
+
+    if (name == "hanging") {
+        cloth = loadClothMeshCached(models + "clothplane.obj", options.meshCacheDir);
+        pins = loadClothPins(models + "clothplane.obj", cloth).subset({ "corners" });
+        // plane is authored in XZ, stand it up so z becomes height
+        for (auto& p : cloth.positions) { p = { p.x, -p.z, 0.0f }; }
+    }
+    else if (name == "sphere") {
+        cloth = loadClothMeshCached(models + "clothplane.obj", options.meshCacheDir);
+        scaleMesh(cloth, 0.5f);
+        translateMesh(cloth, { 0.0f, 1.5f, 0.0f });
+
+        MeshCollider sphere;
+        sphere.build(loadClothMeshCached(models + "sphereWTex.obj", options.meshCacheDir));
+        colliders.meshes.push_back(std::move(sphere));
+    }
+    else if (name == "bunny") {
+        cloth = loadClothMeshCached(models + "clothplain.obj", options.meshCacheDir);
+        scaleMesh(cloth, 0.12f);
+        translateMesh(cloth, { -0.15f, 2.2f, 0.0f });
+
+        MeshCollider bunny;
+        bunny.build(loadClothMeshCached(models + "bunny.obj", options.meshCacheDir));
+        colliders.meshes.push_back(std::move(bunny));
+    }
+    else if (name == "flag" || name == "banner") {
+        cloth = loadClothMeshCached(models + "clothplane.obj", options.meshCacheDir);
+        const bool flag = name == "flag";
+        pins = loadClothPins(models + "clothplane.obj", cloth).subset({ flag ? "left" : "top" });
+        for (auto& p : cloth.positions) { p = { p.x, -p.z, 0.0f }; }
+        glm::vec3 lo, hi;
+        meshBounds(cloth, lo, hi);
+
+        WindSettings wind;
+        wind.velocity = flag ? glm::vec3(6.0f, 0.0f, 0.5f) : glm::vec3(0.0f, 0.0f, 4.0f);
+        wind.turbulence = flag ? 0.3f : 0.5f;
+        wind.gustSize = hi.x - lo.x;
+        solver.wind = std::make_shared<const WindField>(wind);
+    }
+    else if (name == "curtain") {
+        cloth = loadClothMeshCached(models + "clothplane.obj", options.meshCacheDir);
+        pins = loadClothPins(models + "clothplane.obj", cloth).subset({ "rail" });
+        for (auto& p : cloth.positions) { p = { p.x, -p.z, 0.0f }; }
+    }
+    else if (name == "patchwork") {
+        cloth = loadClothMeshCached(models + "clothplane.obj", options.meshCacheDir);
+        pins = loadClothPins(models + "clothplane.obj", cloth).subset({ "top" });
+        materials = loadClothMaterials(models + "clothplane.fabrics");
+        for (auto& p : cloth.positions) { p = { p.x, -p.z, 0.0f }; }
+    }
+    else if (name == "grid") {
+        // generated straight into the solver, big resolutions would spend most of their setup in buildClothEdges
+        GridSettings grid;
+        grid.columns = grid.rows = options.gridResolution;
+        grid.pins = GRID_PIN_TOP_CORNERS;
+        buildGridSolver(grid, options.params, solver);
+        solver.colliders.reset();
+        solver.pins.reset();
+        return makeGridClothMesh(grid);
+    }
+    else {
+        throw std::runtime_error("unknown scene: " + name);
+    }
+
+    solver.build(cloth, options.params);
+    applyClothMaterials(cloth, materials, solver);
+    solver.setPins(std::move(pins));
+    solver.colliders = std::make_shared<const ColliderSet>(std::move(colliders));
+    return cloth;
+}
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,8 @@
+#pragma once
+
+// SSE2 paths of the solver side kernels (ClothSolver, ClothFem, ClothEmbedding): CLOTH_SOLVER_SSE is 1 where SSE2 is
+// available (always on x64), each kernel keeps a scalar loop with the same operations for everything else
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLOTH_SOLVER_SSE 1
+#endif
@@ -0,0 +1,1023 @@
+#pragma once
+#include "ClothFem.hpp"
+#include "ClothMesh.hpp"
+#include "ClothPins.hpp"
+#include "ClothSimd.hpp"
+#include "ClothStrainLimit.hpp"
+#include "Colliders.hpp"
+#include "CpuProfiler.hpp"
+#include "FrameArena.hpp"
+#include "JobSystem.hpp"
+#include "WindField.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Cloth solver (XPBD, small steps)
+// Every frame is split into substeps with a single constraint iteration each, which converges better
+// than many iterations on one big step. Particles are stored as structure of arrays so the hot loops
+// touch only the components they need.
+// Stretch constraints come from the mesh edges, bending from the two vertices opposite each interior edge.
+// Both are distance constraints with their own compliance (inverse stiffness, 0 = rigid).
+//
+// Constraints are graph colored at build time and stored sorted by color, no two constraints of a color
+// share a particle, so a color can be solved in parallel without races. The order only depends on the
+// mesh, which makes the result independent of the worker count.
+// Per step scratch comes from per thread frame arenas (FrameArena.hpp) that are rewound every step, so
+// once the arenas have grown to fit, stepping doesn't allocate.
+// Deterministic mode additionally uses fixed chunk sizes, sums reductions in chunk order and hashes the
+// particle state after every step. The kernels below, and every header whose math feeds the solver state
+// (meshes, colliders, wind, pins, tearing, remeshing, ...), are compiled without FMA contraction
+// (ClothFloatPreciseBegin.hpp), so the same inputs give the same bits on every compiler/CPU and -march.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct SolverParams {
+    float timeStep = 1.0f / 60.0f;
+    uint32_t substeps = 10;
+    glm::vec3 gravity{ 0.0f, -9.81f, 0.0f };
+    float stretchCompliance = 0.0f;
+    float bendCompliance = 1e-3f;
+    float damping = 0.1f;              // fraction of velocity removed per second
+    float areaDensity = 0.2f;          // kg per m^2, particle mass is a third of its adjacent triangle area
+    float collisionThickness = 0.02f;  // particles are kept this far outside colliders
+    float contactReuse = 0.25f;        // cached contact feature is reused while the particle stays within this
+                                       // fraction of collisionThickness of where it was found, 0 = always query
+    float frictionScale = 1.0f;        // multiplies the friction coefficients of every collider, 0 = frictionless
+    float airDensity = 1.2f;           // kg per m^3, aerodynamics only run when the solver has a wind field
+    float dragCoefficient = 1.0f;      // force along the relative air flow, per unit of flow through the triangle
+    float liftCoefficient = 0.5f;      // force across the flow, strongest at 45 degrees of attack
+    bool deterministic = false;        // bitwise reproducible across runs and thread counts, checksums every step
+};
+
+struct ParticleStore {
+    std::vector<float> x, y, z;    // current positions
+    std::vector<float> px, py, pz; // positions at the start of the substep
+    std::vector<float> vx, vy, vz;
+    std::vector<float> invMass;    // 0 = pinned
+
+    size_t size() const { return x.size(); }
+
+    void resize(size_t n) {
+        for (auto* v : { &x, &y, &z, &px, &py, &pz, &vx, &vy, &vz, &invMass }) {
+            v->resize(n, 0.0f);
+        }
+    }
+
+    glm::vec3 position(size_t i) const { return { x[i], y[i], z[i] }; }
+    void setPosition(size_t i, const glm::vec3& p) { x[i] = p.x; y[i] = p.y; z[i] = p.z; }
+
+    size_t memoryBytes() const { return x.capacity() * sizeof(float) * 10; }
+};
+
+struct DistanceConstraints {
+    std::vector<uint32_t> a, b;
+    std::vector<float> restLength;
+    std::vector<float> compliance;
+    std::vector<float> lambda;           // XPBD multipliers, reset at the start of every substep
+    std::vector<uint32_t> colorOffsets;  // constraints [colorOffsets[c], colorOffsets[c + 1]) share a color
+
+    size_t size() const { return a.size(); }
+    size_t colorCount() const { return colorOffsets.empty() ? 0 : colorOffsets.size() - 1; }
+
+    // a constraint from a particle to itself is a hole: solving skips it without touching the particle, so it
+    // can sit in any color. Tearing leaves holes behind and fills them again (ClothTearing.hpp).
+    bool active(size_t k) const { return a[k] != b[k]; }
+    void disable(size_t k) { a[k] = b[k] = 0; restLength[k] = 0.0f; lambda[k] = 0.0f; }
+
+    uint32_t colorOf(size_t k) const {
+        return static_cast<uint32_t>(std::upper_bound(colorOffsets.begin(), colorOffsets.end(), static_cast<uint32_t>(k)) - colorOffsets.begin()) - 1;
+    }
+
+    void add(uint32_t i, uint32_t j, float rest, float alpha) {
+        a.push_back(i);
+        b.push_back(j);
+        restLength.push_back(rest);
+        compliance.push_back(alpha);
+        lambda.push_back(0.0f);
+    }
+
+    // greedy coloring in constraint order, then a stable counting sort by color
+    void color(size_t particleCount) {
+        const uint32_t MAX_COLORS = 64;
+        std::vector<uint64_t> used(particleCount, 0); // bit c set = particle already in a color c constraint
+        std::vector<uint32_t> colors(size());
+        uint32_t colorCount = 0;
+
+        for (size_t k = 0; k < size(); k++) {
+            uint64_t taken = used[a[k]] | used[b[k]];
+            uint32_t c = 0;
+            while (c < MAX_COLORS && (taken & (1ull << c))) { c++; }
+            if (c == MAX_COLORS) {
+                throw std::runtime_error("constraint coloring needs more than 64 colors!");
+            }
+            colors[k] = c;
+            used[a[k]] |= 1ull << c;
+            used[b[k]] |= 1ull << c;
+            colorCount = std::max(colorCount, c + 1);
+        }
+
+        sortByColor(colors, colorCount);
+    }
+
+    // groups the constraints by the given colors (stable), for colorings made elsewhere (ClothRemesh.hpp keeps
+    // the colors of constraints a remesh didn't touch)
+    void sortByColor(const std::vector<uint32_t>& colors, uint32_t colorCount) {
+        colorOffsets.assign(colorCount + 1, 0);
+        for (uint32_t c : colors) { colorOffsets[c + 1]++; }
+        for (uint32_t c = 0; c < colorCount; c++) { colorOffsets[c + 1] += colorOffsets[c]; }
+
+        std::vector<uint32_t> order(size());
+        std::vector<uint32_t> fill(colorOffsets.begin(), colorOffsets.end() - 1);
+        for (uint32_t k = 0; k < size(); k++) { order[fill[colors[k]]++] = k; }
+
+        permute(a, order);
+        permute(b, order);
+        permute(restLength, order);
+        permute(compliance, order);
+        permute(lambda, order);
+    }
+
+    // appends `count` holes to the end of every color and `extraColors` colors of only holes, room for
+    // constraints added later without recoloring (a vertex that already uses every color still fits the extras)
+    void addHoles(uint32_t count, uint32_t extraColors = 0) {
+        DistanceConstraints padded;
+        padded.colorOffsets.push_back(0);
+        const float alpha = compliance.empty() ? 0.0f : compliance[0];
+        for (size_t color = 0; color < colorCount() + extraColors; color++) {
+            if (color < colorCount()) {
+                for (uint32_t k = colorOffsets[color]; k < colorOffsets[color + 1]; k++) {
+                    padded.add(a[k], b[k], restLength[k], compliance[k]);
+                    padded.lambda.back() = lambda[k];
+                }
+            }
+            for (uint32_t h = 0; h < count; h++) { padded.add(0, 0, 0.0f, alpha); }
+            padded.colorOffsets.push_back(static_cast<uint32_t>(padded.size()));
+        }
+        *this = std::move(padded);
+    }
+
+    size_t memoryBytes() const {
+        return (a.capacity() + b.capacity() + colorOffsets.capacity()) * sizeof(uint32_t) +
+            (restLength.capacity() + compliance.capacity() + lambda.capacity()) * sizeof(float);
+    }
+
+private:
+    template <typename T>
+    static void permute(std::vector<T>& values, const std::vector<uint32_t>& order) {
+        std::vector<T> sorted(values.size());
+        for (size_t k = 0; k < order.size(); k++) { sorted[k] = values[order[k]]; }
+        values.swap(sorted);
+    }
+};
+
+// Cloth triangles for the aerodynamics pass, with a vertex -> triangle table (CSR) so every particle gathers
+// the forces of the triangles around it instead of triangles scattering into shared particles.
+// Vertex i owns the slots [vertexStart[i], vertexStart[i + 1]) and uses the first vertexValence[i] of them,
+// tearing (ClothTearing.hpp) moves triangles between vertices without relayouting.
+struct ClothTriangles {
+    std::vector<uint32_t> a, b, c;
+    std::vector<uint32_t> vertexStart;
+    std::vector<uint32_t> vertexValence;
+    std::vector<uint32_t> vertexTriangles;
+
+    size_t size() const { return a.size(); }
+
+    // `emptyCapacity` slots are reserved for vertices without triangles (spare particles new vertices come from)
+    void assign(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t emptyCapacity = 0) {
+        size_t count = indices.size() / 3;
+        a.resize(count);
+        b.resize(count);
+        c.resize(count);
+        vertexValence.assign(vertexCount, 0);
+        for (size_t t = 0; t < count; t++) {
+            a[t] = indices[3 * t];
+            b[t] = indices[3 * t + 1];
+            c[t] = indices[3 * t + 2];
+            for (int k = 0; k < 3; k++) { vertexValence[indices[3 * t + k]]++; }
+        }
+        vertexStart.assign(vertexCount + 1, 0);
+        for (size_t i = 0; i < vertexCount; i++) {
+            vertexStart[i + 1] = vertexStart[i] + (vertexValence[i] ? vertexValence[i] : emptyCapacity);
+        }
+        vertexTriangles.resize(vertexStart[vertexCount]);
+        std::fill(vertexValence.begin(), vertexValence.end(), 0);
+        for (size_t k = 0; k < indices.size(); k++) {
+            uint32_t i = indices[k];
+            vertexTriangles[vertexStart[i] + vertexValence[i]++] = static_cast<uint32_t>(k / 3);
+        }
+    }
+
+    // corners back to one index array, 3 per triangle
+    void indices(std::vector<uint32_t>& out) const {
+        out.resize(size() * 3);
+        for (size_t t = 0; t < size(); t++) {
+            out[3 * t] = a[t];
+            out[3 * t + 1] = b[t];
+            out[3 * t + 2] = c[t];
+        }
+    }
+
+    size_t memoryBytes() const {
+        return (a.capacity() + b.capacity() + c.capacity() + vertexStart.capacity() + vertexValence.capacity() +
+            vertexTriangles.capacity()) * sizeof(uint32_t);
+    }
+};
+
+// Per triangle inputs and outputs of the aerodynamics pass, structure of arrays from the frame arena like
+// ContactBatch. The wind is sampled once per particle and frame (gusts move a fraction of a texel per frame),
+// a scalar gather then fills the triangle normal (unnormalized cross product) and the air velocity relative
+// to the triangle every substep, and the force kernel runs four triangles at a time.
+struct AeroBatch {
+    float* wx = nullptr, *wy = nullptr, *wz = nullptr; // wind at every particle, this frame
+    float* cx = nullptr, *cy = nullptr, *cz = nullptr; // (b - a) x (c - a), twice the area along the normal
+    float* rx = nullptr, *ry = nullptr, *rz = nullptr; // wind minus triangle velocity, both averaged over the corners
+    float* fx = nullptr, *fy = nullptr, *fz = nullptr; // aerodynamic force on the triangle
+
+    void allocate(FrameArena& arena, size_t particles, size_t triangles) {
+        for (float** array : { &wx, &wy, &wz }) {
+            *array = arena.allocArray<float>(particles);
+        }
+        for (float** array : { &cx, &cy, &cz, &rx, &ry, &rz, &fx, &fy, &fz }) {
+            *array = arena.allocArray<float>(triangles);
+        }
+    }
+
+    // drag = kd * A * |r.n| * r along the flow, lift = kl * A * (r.n) / |r| * (n |r|^2 - r (r.n)) across it
+    // (kd, kl = 1/2 rho C), sign agnostic so triangle winding doesn't matter. Same scheme as
+    // ContactBatch::solveFriction: SSE loop plus a scalar tail with identical operations.
+    void computeForces(size_t begin, size_t end, float kd, float kl) {
+        size_t t = begin;
+#if CLOTH_SOLVER_SSE
+        const __m128 half = _mm_set1_ps(0.5f), tiny = _mm_set1_ps(1e-12f);
+        const __m128 dragK = _mm_set1_ps(kd), liftK = _mm_set1_ps(kl);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        for (; t + 4 <= end; t += 4) {
+            __m128 c0 = _mm_loadu_ps(cx + t), c1 = _mm_loadu_ps(cy + t), c2 = _mm_loadu_ps(cz + t);
+            __m128 r0 = _mm_loadu_ps(rx + t), r1 = _mm_loadu_ps(ry + t), r2 = _mm_loadu_ps(rz + t);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, c0), _mm_mul_ps(c1, c1)), _mm_mul_ps(c2, c2)));
+            __m128 area = _mm_mul_ps(half, length);
+            __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(length, tiny));
+            __m128 n0 = _mm_mul_ps(c0, inv), n1 = _mm_mul_ps(c1, inv), n2 = _mm_mul_ps(c2, inv);
+            __m128 r2sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, r0), _mm_mul_ps(r1, r1)), _mm_mul_ps(r2, r2));
+            __m128 speed = _mm_sqrt_ps(r2sum);
+            __m128 flow = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, n0), _mm_mul_ps(r1, n1)), _mm_mul_ps(r2, n2));
+            __m128 drag = _mm_mul_ps(_mm_mul_ps(dragK, area), _mm_andnot_ps(signMask, flow));
+            __m128 lift = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(liftK, area), flow), _mm_max_ps(speed, tiny));
+            // drag * r + lift * (n |r|^2 - r (r.n))
+            __m128 liftN = _mm_mul_ps(lift, r2sum), liftR = _mm_sub_ps(drag, _mm_mul_ps(lift, flow));
+            _mm_storeu_ps(fx + t, _mm_add_ps(_mm_mul_ps(liftR, r0), _mm_mul_ps(liftN, n0)));
+            _mm_storeu_ps(fy + t, _mm_add_ps(_mm_mul_ps(liftR, r1), _mm_mul_ps(liftN, n1)));
+            _mm_storeu_ps(fz + t, _mm_add_ps(_mm_mul_ps(liftR, r2), _mm_mul_ps(liftN, n2)));
+        }
+#endif
+        for (; t < end; t++) {
+            float length = std::sqrt(cx[t] * cx[t] + cy[t] * cy[t] + cz[t] * cz[t]);
+            float area = 0.5f * length;
+            float inv = 1.0f / (length > 1e-12f ? length : 1e-12f);
+            float n0 = cx[t] * inv, n1 = cy[t] * inv, n2 = cz[t] * inv;
+            float r2sum = rx[t] * rx[t] + ry[t] * ry[t] + rz[t] * rz[t];
+            float speed = std::sqrt(r2sum);
+            float flow = rx[t] * n0 + ry[t] * n1 + rz[t] * n2;
+            float drag = kd * area * std::fabs(flow);
+            float lift = kl * area * flow / (speed > 1e-12f ? speed : 1e-12f);
+            float liftN = lift * r2sum, liftR = drag - lift * flow;
+            fx[t] = liftR * rx[t] + liftN * n0;
+            fy[t] = liftR * ry[t] + liftN * n1;
+            fz[t] = liftR * rz[t] + liftN * n2;
+        }
+    }
+};
+
+// Persistent contacts, one slot per particle: the mesh collider feature (mesh + triangle) found near the
+// particle and where the particle was at the full grid query that found it. Resting cloth barely moves between substeps, so most substeps just re-test the
+// remembered triangle instead of walking the collider grid. A query that finds nothing is cached as CLEAR:
+// it searched a ball reuse distance larger than needed, so while the particle stays within the reuse
+// distance nothing can be in reach and the narrow phase is skipped entirely.
+struct ContactCache {
+    static constexpr uint32_t NONE = ~0u;      // nothing cached, query
+    static constexpr uint32_t CLEAR = ~0u - 1; // no mesh within reach of the anchor
+
+    std::vector<uint32_t> collider;   // mesh index, NONE or CLEAR
+    std::vector<uint32_t> feature;    // triangle of that mesh
+    std::vector<float> ax, ay, az;    // anchor: particle position at the last full query
+
+    size_t size() const { return collider.size(); }
+
+    void resize(size_t n) {
+        collider.assign(n, NONE);
+        feature.assign(n, 0);
+        for (auto* v : { &ax, &ay, &az }) { v->assign(n, 0.0f); }
+    }
+
+    void clear() { resize(size()); }
+
+    size_t memoryBytes() const {
+        return (collider.capacity() + feature.capacity()) * sizeof(uint32_t) +
+            (ax.capacity() + ay.capacity() + az.capacity()) * sizeof(float);
+    }
+};
+
+// Contacts of the current substep, packed as structure of arrays so friction runs over plain float arrays
+// four contacts at a time (selects instead of per contact branches). Every chunk of particles writes its
+// contacts to the slots starting at its first particle (a particle has at most one contact), so chunks fill
+// their part in parallel without a counting pass. The arrays come from the frame arena and are handed out
+// again every step.
+struct ContactBatch {
+    uint32_t* particle = nullptr;
+    float* nx = nullptr, *ny = nullptr, *nz = nullptr; // unit normal, pointing out of the collider
+    float* depth = nullptr;                            // penetration resolved along the normal
+    float* staticFriction = nullptr, *kineticFriction = nullptr, *restitution = nullptr;
+    float* approach = nullptr;                         // normal velocity before the substep, < 0 = approaching
+    float* dx = nullptr, *dy = nullptr, *dz = nullptr; // particle displacement over the substep
+    uint32_t* chunkCount = nullptr;                    // contacts per particle chunk, indexed by begin / grain
+    size_t grain = 0;
+
+    void allocate(FrameArena& arena, size_t particles, size_t chunkGrain) {
+        particle = arena.allocArray<uint32_t>(particles);
+        for (float** array : { &nx, &ny, &nz, &depth, &staticFriction, &kineticFriction, &restitution, &approach, &dx, &dy, &dz }) {
+            *array = arena.allocArray<float>(particles);
+        }
+        grain = chunkGrain;
+        chunkCount = arena.allocArray<uint32_t>(particles / grain + 1);
+    }
+
+    // Coulomb friction on contacts [begin, end): tangential slip inside the static cone is removed, beyond it
+    // the kinetic limit is taken off (Macklin et al. 2014, position based friction).
+    // The SSE loop and the scalar tail do the same IEEE operations in the same order, results are identical
+    // with and without SSE. (The auto vectorizer doesn't help here: under the optimize pragma GCC keeps
+    // std::sqrt an out of line call.)
+    void solveFriction(size_t begin, size_t end) {
+        size_t k = begin;
+#if CLOTH_SOLVER_SSE
+        const __m128 one = _mm_set1_ps(1.0f), tiny = _mm_set1_ps(1e-9f);
+        for (; k + 4 <= end; k += 4) {
+            __m128 n0 = _mm_loadu_ps(nx + k), n1 = _mm_loadu_ps(ny + k), n2 = _mm_loadu_ps(nz + k);
+            __m128 d0 = _mm_loadu_ps(dx + k), d1 = _mm_loadu_ps(dy + k), d2 = _mm_loadu_ps(dz + k);
+            __m128 d = _mm_loadu_ps(depth + k);
+            __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, n0), _mm_mul_ps(d1, n1)), _mm_mul_ps(d2, n2));
+            __m128 tx = _mm_sub_ps(d0, _mm_mul_ps(along, n0));
+            __m128 ty = _mm_sub_ps(d1, _mm_mul_ps(along, n1));
+            __m128 tz = _mm_sub_ps(d2, _mm_mul_ps(along, n2));
+            __m128 slip = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz)));
+            __m128 kinetic = _mm_min_ps(_mm_div_ps(_mm_mul_ps(_mm_loadu_ps(kineticFriction + k), d), _mm_max_ps(slip, tiny)), one);
+            __m128 stuck = _mm_cmplt_ps(slip, _mm_mul_ps(_mm_loadu_ps(staticFriction + k), d));
+            __m128 scale = _mm_or_ps(_mm_and_ps(stuck, one), _mm_andnot_ps(stuck, kinetic));
+            _mm_storeu_ps(dx + k, _mm_sub_ps(d0, _mm_mul_ps(tx, scale)));
+            _mm_storeu_ps(dy + k, _mm_sub_ps(d1, _mm_mul_ps(ty, scale)));
+            _mm_storeu_ps(dz + k, _mm_sub_ps(d2, _mm_mul_ps(tz, scale)));
+        }
+#endif
+        for (; k < end; k++) {
+            float along = dx[k] * nx[k] + dy[k] * ny[k] + dz[k] * nz[k];
+            float tx = dx[k] - along * nx[k];
+            float ty = dy[k] - along * ny[k];
+            float tz = dz[k] - along * nz[k];
+            float slip = std::sqrt(tx * tx + ty * ty + tz * tz);
+            float limit = kineticFriction[k] * depth[k] / (slip > 1e-9f ? slip : 1e-9f);
+            float kinetic = limit < 1.0f ? limit : 1.0f;
+            float scale = slip < staticFriction[k] * depth[k] ? 1.0f : kinetic;
+            dx[k] -= tx * scale;
+            dy[k] -= ty * scale;
+            dz[k] -= tz * scale;
+        }
+    }
+};
+
+// accumulated wall time per solver phase, divided by steps for per-step averages
+struct SolverStats {
+    uint64_t steps = 0;
+    int64_t integrateNs = 0;
+    int64_t constraintNs = 0;
+    int64_t collisionNs = 0;
+    int64_t velocityNs = 0;
+    int64_t aeroNs = 0;
+    int64_t strainLimitNs = 0;
+    uint64_t contacts = 0;       // particle contacts summed over substeps
+    uint64_t contactQueries = 0; // full collider grid queries
+    uint64_t contactReuses = 0;  // cached features re-tested instead
+    uint64_t strainLimited = 0;  // triangles clamped by the strain limits summed over passes and substeps
+    double kineticEnergy = 0.0; // after the last step
+    uint64_t checksum = 0;      // FNV-1a of positions and velocities after the last step (deterministic mode)
+
+    void reset() { *this = SolverStats{}; }
+};
+
+class ClothSolver {
+public:
+    SolverParams params;
+    ParticleStore particles;
+    DistanceConstraints stretch;
+    DistanceConstraints bend;
+    ContactCache contacts;
+    ContactBatch contactBatch; // this step's arena arrays, don't use outside of step()
+    AeroBatch aeroBatch;       // same
+    ClothTriangles triangles;
+    std::shared_ptr<const ColliderSet> colliders; // read only, copies of a solver (sweep workers) share it
+    std::shared_ptr<const WindField> wind;        // null = no aerodynamics, shared like colliders
+    std::shared_ptr<const ClothPins> pins;        // pin groups from setPins(), kinematic ones move every substep
+    std::shared_ptr<const StrainLimits> strainLimits; // null = no strain limiting, see setStrainLimits()
+    std::shared_ptr<const TriangleElements> elements; // null = springs, else StVK elements instead of stretch
+    SolverStats stats;
+    JobSystem* jobs = nullptr; // null = everything runs on the calling thread
+    uint64_t topologyHash = 0; // identifies particle count + constraint layout, snapshots only restore onto a match
+    bool materialCompliance = false; // compliances are per constraint from painted fabrics (ClothMaterials.hpp)
+    std::vector<float> areaDensity;  // per particle with painted fabrics, empty = params.areaDensity (remeshing
+                                     // rebuilds masses from it, stepping never reads it)
+
+    // chunk size used by deterministic mode, fixed so chunk boundaries never depend on the thread count
+    static const size_t DETERMINISTIC_GRAIN = 1024;
+
+    void build(const ClothMesh& mesh, const SolverParams& solverParams) {
+        params = solverParams;
+        size_t n = mesh.vertexCount();
+        particles.resize(n);
+
+        // lumped mass from triangle areas
+        std::vector<float> mass(n, 0.0f);
+        for (size_t t = 0; t < mesh.triangleCount(); t++) {
+            uint32_t i0 = mesh.indices[3 * t], i1 = mesh.indices[3 * t + 1], i2 = mesh.indices[3 * t + 2];
+            float area = 0.5f * glm::length(glm::cross(mesh.positions[i1] - mesh.positions[i0], mesh.positions[i2] - mesh.positions[i0]));
+            float third = area * params.areaDensity / 3.0f;
+            mass[i0] += third;
+            mass[i1] += third;
+            mass[i2] += third;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            particles.setPosition(i, mesh.positions[i]);
+            particles.px[i] = particles.x[i];
+            particles.py[i] = particles.y[i];
+            particles.pz[i] = particles.z[i];
+            particles.invMass[i] = mass[i] > 0.0f ? 1.0f / mass[i] : 0.0f;
+        }
+
+        triangles.assign(mesh.indices, n);
+        ClothEdges edges = buildClothEdges(mesh);
+        stretch = DistanceConstraints{};
+        bend = DistanceConstraints{};
+        for (size_t e = 0; e + 1 < edges.edges.size(); e += 2) {
+            uint32_t i = edges.edges[e], j = edges.edges[e + 1];
+            stretch.add(i, j, glm::distance(mesh.positions[i], mesh.positions[j]), params.stretchCompliance);
+        }
+        for (size_t e = 0; e + 1 < edges.bendPairs.size(); e += 2) {
+            uint32_t i = edges.bendPairs[e], j = edges.bendPairs[e + 1];
+            bend.add(i, j, glm::distance(mesh.positions[i], mesh.positions[j]), params.bendCompliance);
+        }
+        finishBuild();
+    }
+
+    // colors the constraints and resets stats; build() calls this, procedural generators that fill
+    // particles/stretch/bend directly (ClothGrid.hpp) call it themselves
+    void finishBuild() {
+        stretch.color(particles.size());
+        bend.color(particles.size());
+        topologyHash = computeTopologyHash();
+        contacts.resize(particles.size());
+        materialCompliance = false;
+        areaDensity.clear();
+        stats.reset();
+    }
+
+    // swap parameters without rebuilding, e.g. to fork variations from one restored snapshot; painted fabric
+    // compliances stay, the global ones don't apply to them
+    void applyParams(const SolverParams& solverParams) {
+        params = solverParams;
+        if (materialCompliance) { return; }
+        std::fill(stretch.compliance.begin(), stretch.compliance.end(), params.stretchCompliance);
+        std::fill(bend.compliance.begin(), bend.compliance.end(), params.bendCompliance);
+    }
+
+    void pin(uint32_t i) { particles.invMass[i] = 0.0f; }
+
+    // pins every vertex of every group (ClothPins.hpp); the current positions are the rest pose kinematic
+    // groups move from, so call after build() with the cloth where it starts
+    void setPins(ClothPins pinSet) {
+        pinSet.bind(particles.x.data(), particles.y.data(), particles.z.data(), particles.size());
+        pinSet.forEachPinned([&](uint32_t i) { pin(i); });
+        pins = pinSet.empty() ? nullptr : std::make_shared<const ClothPins>(std::move(pinSet));
+    }
+
+    // kinematic pins where they are at `time` seconds, step() calls this every substep; levels that don't
+    // step themselves (ClothLod.hpp) call it to keep their pins in place
+    void movePins(float time) {
+        if (pins) { pins->move(time, particles.x.data(), particles.y.data(), particles.z.data()); }
+    }
+
+    // StVK triangle elements (ClothFem.hpp) instead of the stretch constraints, which stay built but aren't
+    // solved (tearing still reads their strain); `mesh` is the one the solver was built from, its positions the rest shape
+    void setElements(const ClothMesh& mesh, const FemSettings& settings) {
+        std::vector<uint32_t> indices;
+        triangles.indices(indices);
+        if (mesh.vertexCount() != particles.size() || indices != mesh.indices) {
+            throw std::runtime_error("elements need the mesh the solver was built from!");
+        }
+        auto fem = std::make_shared<TriangleElements>();
+        fem->build(mesh, settings);
+        elements = std::move(fem);
+    }
+
+    // limits the warp and weft strain of every triangle after the constraints each substep (ClothStrainLimit.hpp);
+    // `mesh` is the one the solver was built from, its uvs give the weave directions
+    void setStrainLimits(const ClothMesh& mesh, const StrainLimitSettings& settings) {
+        std::vector<uint32_t> indices;
+        triangles.indices(indices);
+        if (mesh.vertexCount() != particles.size() || indices != mesh.indices) {
+            throw std::runtime_error("strain limits need the mesh the solver was built from!");
+        }
+        auto limits = std::make_shared<StrainLimits>();
+        limits->build(mesh, settings);
+        strainLimits = std::move(limits);
+    }
+
+    size_t constraintCount() const { return stretch.size() + bend.size(); }
+
+    // advance one frame (params.timeStep) in params.substeps substeps
+    void step() {
+        PROFILE_ZONE("ClothSolver::step");
+        float h = params.timeStep / params.substeps;
+        resetArenas();
+        contactBatch = ContactBatch{};
+        if (colliders && !colliders->empty()) {
+            contactBatch.allocate(frameArena(), particles.size(), grainFor(particles.size()));
+        }
+        aeroBatch = AeroBatch{};
+        if (wind) {
+            aeroBatch.allocate(frameArena(), particles.size(), triangles.size());
+            int64_t aeroStart = CpuProfiler::nowNs();
+            sampleWind(stats.steps * params.timeStep);
+            stats.aeroNs += CpuProfiler::nowNs() - aeroStart;
+        }
+
+        const float stepTime = stats.steps * params.timeStep;
+        const bool kinematic = pins && pins->hasKinematic();
+        for (uint32_t s = 0; s < params.substeps; s++) {
+            if (wind) {
+                int64_t aeroStart = CpuProfiler::nowNs();
+                applyAerodynamics(h);
+                stats.aeroNs += CpuProfiler::nowNs() - aeroStart;
+            }
+            int64_t t0 = CpuProfiler::nowNs();
+            integrate(h);
+            if (kinematic) { movePins(stepTime + (s + 1) * h); } // overrides wherever integrate() moved them
+            int64_t t1 = CpuProfiler::nowNs();
+            if (elements) { solveElements(h); }
+            else { solveConstraints(stretch, h); }
+            solveConstraints(bend, h);
+            int64_t t2 = CpuProfiler::nowNs();
+            if (strainLimits) {
+                limitStrain();
+                int64_t limited = CpuProfiler::nowNs();
+                stats.strainLimitNs += limited - t2;
+                t2 = limited;
+            }
+            solveCollisions(h);
+            int64_t t3 = CpuProfiler::nowNs();
+            updateVelocities(h);
+            int64_t t4 = CpuProfiler::nowNs();
+
+            stats.integrateNs += t1 - t0;
+            stats.constraintNs += t2 - t1;
+            stats.collisionNs += t3 - t2;
+            stats.velocityNs += t4 - t3;
+        }
+
+        stats.kineticEnergy = computeKineticEnergy();
+        if (params.deterministic) {
+            stats.checksum = computeChecksum();
+        }
+        stats.steps++;
+    }
+
+    void copyPositions(std::vector<glm::vec3>& out) const {
+        out.resize(particles.size());
+        for (size_t i = 0; i < particles.size(); i++) {
+            out[i] = particles.position(i);
+        }
+    }
+
+    // FNV-1a over the raw bits of positions and velocities, in particle order
+    uint64_t computeChecksum() const {
+        PROFILE_ZONE("checksum");
+        uint64_t hash = FNV_OFFSET;
+        for (const auto* values : { &particles.x, &particles.y, &particles.z, &particles.vx, &particles.vy, &particles.vz }) {
+            hash = fnv1a(hash, values->data(), values->size() * sizeof(float));
+        }
+        return hash;
+    }
+
+    static const uint64_t FNV_OFFSET = 1469598103934665603ull;
+
+    static uint64_t fnv1a(uint64_t hash, const void* data, size_t bytes) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < bytes; i++) {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    size_t memoryBytes() const {
+        size_t bytes = particles.memoryBytes() + stretch.memoryBytes() + bend.memoryBytes() + contacts.memoryBytes() +
+            triangles.memoryBytes() + (wind ? wind->memoryBytes() : 0) + (pins ? pins->memoryBytes() : 0) +
+            (strainLimits ? strainLimits->memoryBytes() : 0) + (elements ? elements->memoryBytes() : 0) +
+            areaDensity.capacity() * sizeof(float);
+        if (colliders) {
+            for (const auto& mesh : colliders->meshes) { bytes += mesh.memoryBytes(); }
+        }
+        for (const auto& arena : arenas) { bytes += arena.capacity(); }
+        return bytes;
+    }
+
+    // tearing (ClothTearing.hpp) changes the layout after finishBuild() and refreshes the hash with this
+    uint64_t computeTopologyHash() const {
+        uint64_t count = particles.size();
+        uint64_t hash = fnv1a(FNV_OFFSET, &count, sizeof(count));
+        for (const auto* c : { &stretch, &bend }) {
+            hash = fnv1a(hash, c->a.data(), c->a.size() * sizeof(uint32_t));
+            hash = fnv1a(hash, c->b.data(), c->b.size() * sizeof(uint32_t));
+        }
+        return hash;
+    }
+
+private:
+    // fast mode sizes chunks to the pool, deterministic mode keeps them fixed
+    size_t grainFor(size_t count) const {
+        if (params.deterministic || jobs == nullptr) { return DETERMINISTIC_GRAIN; }
+        size_t perThread = count / (size_t(jobs->threadCount()) * 4) + 1;
+        return std::max<size_t>(256, perThread);
+    }
+
+    template <typename Fn>
+    void forEachChunk(size_t count, const Fn& fn) {
+        size_t grain = grainFor(count);
+        if (jobs == nullptr) {
+            for (size_t begin = 0; begin < count; begin += grain) {
+                fn(begin, std::min(count, begin + grain));
+            }
+            return;
+        }
+        jobs->parallelFor(count, grain, fn);
+    }
+
+    void integrate(float h) {
+        PROFILE_ZONE("integrate");
+        ParticleStore& p = particles;
+        const float gx = params.gravity.x * h, gy = params.gravity.y * h, gz = params.gravity.z * h;
+        forEachChunk(p.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                // pinned particles keep zero velocity because gravity is scaled by the inverse mass flag
+                float free = p.invMass[i] > 0.0f ? 1.0f : 0.0f;
+                p.vx[i] += gx * free;
+                p.vy[i] += gy * free;
+                p.vz[i] += gz * free;
+                p.px[i] = p.x[i];
+                p.py[i] = p.y[i];
+                p.pz[i] = p.z[i];
+                p.x[i] += p.vx[i] * h;
+                p.y[i] += p.vy[i] * h;
+                p.z[i] += p.vz[i] * h;
+            }
+        });
+    }
+
+    void sampleWind(float time) {
+        PROFILE_ZONE("wind");
+        const ParticleStore& p = particles;
+        const WindField& field = *wind;
+        AeroBatch& batch = aeroBatch;
+        forEachChunk(p.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                glm::vec3 w = field.sample(p.position(i), time);
+                batch.wx[i] = w.x;
+                batch.wy[i] = w.y;
+                batch.wz[i] = w.z;
+            }
+        });
+    }
+
+    // Wind forces, parallel over triangles then over particles: chunks of triangles gather their corners,
+    // compute forces in the batch kernel, then every particle adds up a third of the forces of its triangles
+    // (ClothTriangles CSR) into its velocity. Nothing is written by two threads, and the sums go in a fixed
+    // order, so deterministic mode stays reproducible.
+    void applyAerodynamics(float h) {
+        PROFILE_ZONE("aerodynamics");
+        ParticleStore& p = particles;
+        const ClothTriangles& tris = triangles;
+        AeroBatch& batch = aeroBatch;
+        const float kd = 0.5f * params.airDensity * params.dragCoefficient;
+        const float kl = 0.5f * params.airDensity * params.liftCoefficient;
+        const float third = 1.0f / 3.0f;
+
+        forEachChunk(tris.size(), [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; t++) {
+                uint32_t a = tris.a[t], b = tris.b[t], c = tris.c[t];
+                glm::vec3 pa = p.position(a), pb = p.position(b), pc = p.position(c);
+                glm::vec3 normal = glm::cross(pb - pa, pc - pa);
+                batch.cx[t] = normal.x;
+                batch.cy[t] = normal.y;
+                batch.cz[t] = normal.z;
+                batch.rx[t] = (batch.wx[a] + batch.wx[b] + batch.wx[c] - p.vx[a] - p.vx[b] - p.vx[c]) * third;
+                batch.ry[t] = (batch.wy[a] + batch.wy[b] + batch.wy[c] - p.vy[a] - p.vy[b] - p.vy[c]) * third;
+                batch.rz[t] = (batch.wz[a] + batch.wz[b] + batch.wz[c] - p.vz[a] - p.vz[b] - p.vz[c]) * third;
+            }
+            batch.computeForces(begin, end, kd, kl);
+        });
+
+        forEachChunk(p.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float fx = 0.0f, fy = 0.0f, fz = 0.0f;
+                for (uint32_t k = tris.vertexStart[i]; k < tris.vertexStart[i] + tris.vertexValence[i]; k++) {
+                    uint32_t t = tris.vertexTriangles[k];
+                    fx += batch.fx[t];
+                    fy += batch.fy[t];
+                    fz += batch.fz[t];
+                }
+                float scale = h * p.invMass[i] * third;
+                p.vx[i] += fx * scale;
+                p.vy[i] += fy * scale;
+                p.vz[i] += fz * scale;
+            }
+        });
+    }
+
+    void solveElements(float h) {
+        PROFILE_ZONE("elements");
+        ParticleStore& p = particles;
+        const TriangleElements& fem = *elements;
+        for (size_t color = 0; color < fem.colorCount(); color++) {
+            size_t first = fem.colorBegin(color);
+            forEachChunk(fem.colorEnd(color) - first, [&](size_t begin, size_t end) {
+                fem.solve(p.x.data(), p.y.data(), p.z.data(), p.invMass.data(), triangles.a.data(), triangles.b.data(),
+                    triangles.c.data(), first + begin, first + end, h);
+            });
+        }
+    }
+
+    // settings.iterations passes over the triangles, color by color like the constraints
+    void limitStrain() {
+        PROFILE_ZONE("strainLimit");
+        ParticleStore& p = particles;
+        const StrainLimits& limits = *strainLimits;
+        std::atomic<uint64_t> clamped{ 0 };
+        for (uint32_t pass = 0; pass < limits.settings.iterations; pass++) {
+            for (size_t color = 0; color < limits.colorCount(); color++) {
+                size_t first = limits.colorBegin(color);
+                forEachChunk(limits.colorEnd(color) - first, [&](size_t begin, size_t end) {
+                    uint32_t n = limits.project(p.x.data(), p.y.data(), p.z.data(), p.invMass.data(), triangles.a.data(),
+                        triangles.b.data(), triangles.c.data(), first + begin, first + end);
+                    if (n) { clamped.fetch_add(n, std::memory_order_relaxed); }
+                });
+            }
+        }
+        stats.strainLimited += clamped.load(std::memory_order_relaxed);
+    }
+
+    void solveConstraints(DistanceConstraints& c, float h) {
+        PROFILE_ZONE("constraints");
+        ParticleStore& p = particles;
+        const float invH2 = 1.0f / (h * h);
+
+        std::fill(c.lambda.begin(), c.lambda.end(), 0.0f);
+        for (size_t color = 0; color < c.colorCount(); color++) {
+            size_t first = c.colorOffsets[color];
+            forEachChunk(c.colorOffsets[color + 1] - first, [&](size_t begin, size_t end) {
+                for (size_t k = first + begin; k < first + end; k++) {
+                    uint32_t i = c.a[k], j = c.b[k];
+                    if (i == j) { continue; } // hole, see DistanceConstraints::disable()
+                    float wi = p.invMass[i], wj = p.invMass[j];
+                    float alpha = c.compliance[k] * invH2;
+                    float w = wi + wj + alpha;
+                    if (w == 0.0f) { continue; }
+
+                    float dx = p.x[i] - p.x[j];
+                    float dy = p.y[i] - p.y[j];
+                    float dz = p.z[i] - p.z[j];
+                    float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+                    if (len < 1e-9f) { continue; }
+
+                    float C = len - c.restLength[k];
+                    float dLambda = (-C - alpha * c.lambda[k]) / w;
+                    c.lambda[k] += dLambda;
+
+                    float s = dLambda / len;
+                    p.x[i] += wi * s * dx; p.y[i] += wi * s * dy; p.z[i] += wi * s * dz;
+                    p.x[j] -= wj * s * dx; p.y[j] -= wj * s * dy; p.z[j] -= wj * s * dz;
+                }
+            });
+        }
+    }
+
+    void solveCollisions(float h) {
+        PROFILE_ZONE("collisions");
+        if (!colliders || colliders->empty()) { return; }
+        const ColliderSet& set = *colliders;
+
+        ParticleStore& p = particles;
+        ContactCache& cache = contacts;
+        const float thickness = params.collisionThickness;
+        const float reuse = params.contactReuse * thickness;
+        const float reach = thickness * 2.0f + reuse; // query radius, covers every position within reuse of the anchor
+        const float bounceSpeed = 2.0f * glm::length(params.gravity) * h; // slower approaches don't bounce, no jitter at rest
+        const uint32_t meshCount = static_cast<uint32_t>(set.meshes.size());
+        ContactBatch& batch = contactBatch;
+        std::atomic<uint64_t> contactCount{ 0 }, queryCount{ 0 }, reuseCount{ 0 };
+
+        forEachChunk(p.size(), [&](size_t begin, size_t end) {
+            uint64_t chunkQueries = 0, chunkReuses = 0;
+            size_t slot = begin;
+            for (size_t i = begin; i < end; i++) {
+                if (p.invMass[i] == 0.0f) {
+                    cache.collider[i] = ContactCache::NONE;
+                    continue;
+                }
+                const glm::vec3 start = p.position(i);
+                glm::vec3 pos = start;
+                glm::vec3 moved = start - glm::vec3(cache.ax[i], cache.ay[i], cache.az[i]);
+                bool nearAnchor = glm::dot(moved, moved) < reuse * reuse;
+                uint32_t nearCollider = cache.collider[i], nearFeature = cache.feature[i];
+                const ContactMaterial* material = nullptr; // of the deepest contact
+                float deepest = 0.0f;
+
+                if (nearCollider == ContactCache::CLEAR && nearAnchor) {
+                    chunkReuses++;
+                }
+                else if (meshCount > 0) {
+                    bool queried = false;
+                    uint32_t cached = nearCollider;
+                    nearCollider = ContactCache::CLEAR;
+                    for (uint32_t m = 0; m < meshCount; m++) {
+                        const MeshCollider& mesh = set.meshes[m];
+                        MeshCollider::Hit hit;
+                        bool found;
+                        if (cached == m && nearAnchor && mesh.queryTriangle(cache.feature[i], pos, reach, hit)) {
+                            found = true;
+                            chunkReuses++;
+                        }
+                        else {
+                            found = mesh.query(pos, reach, hit);
+                            queried = true;
+                            chunkQueries++;
+                        }
+                        if (found) {
+                            nearCollider = m;
+                            nearFeature = hit.triangle;
+                            if (hit.distance < thickness) {
+                                pos += hit.normal * (thickness - hit.distance);
+                                if (thickness - hit.distance > deepest) {
+                                    deepest = thickness - hit.distance;
+                                    material = &mesh.material;
+                                }
+                            }
+                        }
+                    }
+                    if (queried) {
+                        cache.ax[i] = start.x;
+                        cache.ay[i] = start.y;
+                        cache.az[i] = start.z;
+                    }
+                }
+
+                for (const auto& sphere : set.spheres) {
+                    glm::vec3 d = pos - sphere.center;
+                    float dist = glm::length(d);
+                    float minDist = sphere.radius + thickness;
+                    if (dist < minDist && dist > 1e-9f) {
+                        pos = sphere.center + d * (minDist / dist);
+                        if (minDist - dist > deepest) {
+                            deepest = minDist - dist;
+                            material = &sphere.material;
+                        }
+                    }
+                }
+
+                // a feature found near (but not touching) the particle stays cached too, the particle is
+                // likely to land on it in the next substeps
+                cache.collider[i] = nearCollider;
+                cache.feature[i] = nearFeature;
+                float correction = glm::length(pos - start);
+                p.setPosition(i, pos);
+                if (correction == 0.0f || material == nullptr) { continue; }
+
+                // one contact per particle along the total correction, with the material of the deepest collider
+                glm::vec3 n = (pos - start) / correction;
+                float approach = p.vx[i] * n.x + p.vy[i] * n.y + p.vz[i] * n.z;
+                batch.particle[slot] = static_cast<uint32_t>(i);
+                batch.nx[slot] = n.x;
+                batch.ny[slot] = n.y;
+                batch.nz[slot] = n.z;
+                batch.depth[slot] = correction;
+                batch.staticFriction[slot] = material->staticFriction * params.frictionScale;
+                batch.kineticFriction[slot] = material->kineticFriction * params.frictionScale;
+                batch.restitution[slot] = -approach > bounceSpeed ? material->restitution : 0.0f;
+                batch.approach[slot] = approach;
+                batch.dx[slot] = pos.x - p.px[i];
+                batch.dy[slot] = pos.y - p.py[i];
+                batch.dz[slot] = pos.z - p.pz[i];
+                slot++;
+            }
+
+            batch.solveFriction(begin, slot);
+            for (size_t k = begin; k < slot; k++) {
+                uint32_t i = batch.particle[k];
+                p.x[i] = p.px[i] + batch.dx[k];
+                p.y[i] = p.py[i] + batch.dy[k];
+                p.z[i] = p.pz[i] + batch.dz[k];
+            }
+
+            batch.chunkCount[begin / batch.grain] = static_cast<uint32_t>(slot - begin);
+            contactCount.fetch_add(slot - begin, std::memory_order_relaxed);
+            queryCount.fetch_add(chunkQueries, std::memory_order_relaxed);
+            reuseCount.fetch_add(chunkReuses, std::memory_order_relaxed);
+        });
+
+        stats.contacts += contactCount.load();
+        stats.contactQueries += queryCount.load();
+        stats.contactReuses += reuseCount.load();
+    }
+
+    void updateVelocities(float h) {
+        PROFILE_ZONE("velocities");
+        ParticleStore& p = particles;
+        const float invH = 1.0f / h;
+        const float keep = std::max(0.0f, 1.0f - params.damping * h);
+        const ContactBatch& batch = contactBatch;
+        forEachChunk(p.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                p.vx[i] = (p.x[i] - p.px[i]) * invH * keep;
+                p.vy[i] = (p.y[i] - p.py[i]) * invH * keep;
+                p.vz[i] = (p.z[i] - p.pz[i]) * invH * keep;
+            }
+            if (batch.chunkCount == nullptr) { return; }
+
+            // restitution: contacts that hit fast enough leave with at least restitution * approach speed
+            const size_t first = begin, last = begin + batch.chunkCount[begin / batch.grain];
+            for (size_t k = first; k < last; k++) {
+                uint32_t i = batch.particle[k];
+                float normal = p.vx[i] * batch.nx[k] + p.vy[i] * batch.ny[k] + p.vz[i] * batch.nz[k];
+                float bounce = std::max(-batch.restitution[k] * batch.approach[k] - normal, 0.0f);
+                p.vx[i] += bounce * batch.nx[k];
+                p.vy[i] += bounce * batch.ny[k];
+                p.vz[i] += bounce * batch.nz[k];
+            }
+        });
+    }
+
+    // fast mode adds chunk partials in whatever order chunks finish, deterministic mode stores one
+    // partial per fixed chunk and adds them up in chunk order
+    double computeKineticEnergy() {
+        const ParticleStore& p = particles;
+        auto chunkEnergy = [&p](size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; i++) {
+                if (p.invMass[i] == 0.0f) { continue; }
+                double v2 = double(p.vx[i]) * p.vx[i] + double(p.vy[i]) * p.vy[i] + double(p.vz[i]) * p.vz[i];
+                sum += 0.5 * v2 / p.invMass[i];
+            }
+            return sum;
+        };
+
+        if (params.deterministic) {
+            size_t chunks = (p.size() + DETERMINISTIC_GRAIN - 1) / DETERMINISTIC_GRAIN;
+            double* partials = frameArena().allocArray<double>(chunks);
+            forEachChunk(p.size(), [&](size_t begin, size_t end) {
+                partials[begin / DETERMINISTIC_GRAIN] = chunkEnergy(begin, end);
+            });
+            double total = 0.0;
+            for (size_t c = 0; c < chunks; c++) { total += partials[c]; }
+            return total;
+        }
+
+        std::atomic<double> total{ 0.0 };
+        forEachChunk(p.size(), [&](size_t begin, size_t end) {
+            double partial = chunkEnergy(begin, end);
+            double expected = total.load(std::memory_order_relaxed);
+            while (!total.compare_exchange_weak(expected, expected + partial, std::memory_order_relaxed)) {}
+        });
+        return total.load();
+    }
+
+    std::vector<FrameArena> arenas; // one per thread running passes, indexed by JobSystem::threadIndex()
+
+    // one arena per pool thread plus the calling thread, all rewound
+    void resetArenas() {
+        size_t threads = jobs ? jobs->threadCount() : 1;
+        if (arenas.size() != threads) { arenas.resize(threads); }
+        for (auto& arena : arenas) { arena.reset(); }
+    }
+
+    // scratch for the current step, from the arena of the thread this runs on
+    FrameArena& frameArena() {
+        return arenas[jobs ? JobSystem::threadIndex() : 0];
+    }
+};
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,177 @@
+#pragma once
+#include "ClothMesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Anisotropic strain limiting
+// Woven cloth barely stretches along its threads (warp and weft, usually by different amounts) and gives a lot
+// on the bias. Distance constraints can't say that: an edge doesn't know which way the weave runs, and making
+// every edge stiff enough needs more iterations. Strain limiting instead looks at each triangle as a whole,
+// in a material frame from the uvs: warp along u, weft perpendicular to it in the rest triangle's plane.
+// Per triangle, every substep after the distance constraints:
+// - the deformation gradient F (3x2, warp and weft columns) comes from the current edges and the inverse rest
+//   shape in the material frame
+// - F is divided by the allowed stretch per axis (1 + warp, 1 + weft); principal stretches above 1 of that are
+//   clamped to 1, so the warp and weft columns stay within their limits and anything in between within the
+//   ellipse they span. Compression and shear are left to the constraints and bending.
+// - the corners move to the clamped shape around their mass weighted centroid (pinned corners hold it), so
+//   the projection conserves momentum and never moves a pin
+// Triangles within the limits cost one 2x2 eigenvalue and are left alone, which is most of them. A clamped
+// triangle moves corners its neighbors share, so a couple of passes per substep settle a lot more than one.
+// Triangles are colored like the distance constraints (no two triangles of a color share a particle) and
+// processed color by color, in parallel within a color, so results don't depend on the thread count.
+// The pass reads corners from ClothTriangles, so tearing (which moves corners to new particles, never two of one
+// color onto the same one) keeps working; remeshing drops it (new vertices have no uvs).
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct StrainLimitSettings {
+    float warp = 0.02f; // largest strain along u
+    float weft = 0.05f; // largest strain along v
+    uint32_t iterations = 2; // passes over all triangles per substep, a clamp pushes its neighbors over
+};
+
+class StrainLimits {
+public:
+    StrainLimitSettings settings;
+
+    // material frames of `mesh` (rest positions and uvs), whose triangles must be the solver's in the same order
+    void build(const ClothMesh& mesh, const StrainLimitSettings& limitSettings) {
+        settings = limitSettings;
+        if (settings.warp < 0.0f || settings.weft < 0.0f) { throw std::runtime_error("strain limits can't be negative!"); }
+        if (mesh.uvs.size() != mesh.vertexCount()) { throw std::runtime_error("strain limiting needs uvs!"); }
+        const size_t count = mesh.triangleCount();
+
+        colorTriangles(mesh, triangle, colorOffsets);
+        for (auto* v : { &m1u, &m1v, &m2u, &m2v, &i11, &i12, &i21, &i22 }) { v->resize(count); }
+        for (size_t k = 0; k < count; k++) {
+            // corners in the material frame (corner 0 at the origin), and the inverse of [m1 m2]
+            glm::vec2 m1, m2;
+            triangleMaterialCoords(mesh, triangle[k], m1, m2);
+            m1u[k] = m1.x;
+            m1v[k] = m1.y;
+            m2u[k] = m2.x;
+            m2v[k] = m2.y;
+            float restDet = m1u[k] * m2v[k] - m2u[k] * m1v[k];
+            float inv = restDet != 0.0f ? 1.0f / restDet : 0.0f; // degenerate triangles get F = 0 and are never limited
+            i11[k] = m2v[k] * inv;
+            i12[k] = -m2u[k] * inv;
+            i21[k] = -m1v[k] * inv;
+            i22[k] = m1u[k] * inv;
+        }
+    }
+
+    size_t size() const { return triangle.size(); }
+    size_t colorCount() const { return colorOffsets.empty() ? 0 : colorOffsets.size() - 1; }
+    uint32_t colorBegin(size_t color) const { return colorOffsets[color]; }
+    uint32_t colorEnd(size_t color) const { return colorOffsets[color + 1]; }
+
+    // limits the triangles in color order slots [begin, end) (one color at most), returns how many were clamped
+    uint32_t project(float* x, float* y, float* z, const float* invMass, const uint32_t* ta, const uint32_t* tb,
+            const uint32_t* tc, size_t begin, size_t end) const {
+        const float su = 1.0f + settings.warp, sv = 1.0f + settings.weft;
+        const float invSu = 1.0f / su, invSv = 1.0f / sv;
+        uint32_t clamped = 0;
+        for (size_t k = begin; k < end; k++) {
+            const uint32_t t = triangle[k];
+            const uint32_t v[3] = { ta[t], tb[t], tc[t] };
+            const float e1x = x[v[1]] - x[v[0]], e1y = y[v[1]] - y[v[0]], e1z = z[v[1]] - z[v[0]];
+            const float e2x = x[v[2]] - x[v[0]], e2y = y[v[2]] - y[v[0]], e2z = z[v[2]] - z[v[0]];
+
+            // G = F diag(1 / su, 1 / sv), columns gu and gv
+            float gux = (e1x * i11[k] + e2x * i21[k]) * invSu, guy = (e1y * i11[k] + e2y * i21[k]) * invSu, guz = (e1z * i11[k] + e2z * i21[k]) * invSu;
+            float gvx = (e1x * i12[k] + e2x * i22[k]) * invSv, gvy = (e1y * i12[k] + e2y * i22[k]) * invSv, gvz = (e1z * i12[k] + e2z * i22[k]) * invSv;
+            const float c11 = gux * gux + guy * guy + guz * guz;
+            const float c12 = gux * gvx + guy * gvy + guz * gvz;
+            const float c22 = gvx * gvx + gvy * gvy + gvz * gvz;
+            const float half = 0.5f * (c11 + c22);
+            const float root = std::sqrt(0.25f * (c11 - c22) * (c11 - c22) + c12 * c12);
+            const float l1 = half + root; // largest squared principal stretch
+            if (l1 <= 1.0f) { continue; }
+            const float w[3] = { invMass[v[0]], invMass[v[1]], invMass[v[2]] };
+            const int pins = (w[0] == 0.0f) + (w[1] == 0.0f) + (w[2] == 0.0f);
+            if (pins == 3) { continue; }
+
+            // G R with R = V diag(k1, k2) V^T scales each principal stretch above 1 down to 1
+            float v1x = l1 - c22, v1y = c12;
+            if (std::abs(c12) < 1e-12f * l1) {
+                v1x = c11 >= c22 ? 1.0f : 0.0f;
+                v1y = c11 >= c22 ? 0.0f : 1.0f;
+            }
+            const float length = std::sqrt(v1x * v1x + v1y * v1y);
+            v1x /= length;
+            v1y /= length;
+            const float l2 = std::max(half - root, 0.0f);
+            const float k1 = 1.0f / std::sqrt(l1);
+            const float k2 = l2 > 1.0f ? 1.0f / std::sqrt(l2) : 1.0f;
+            const float r11 = k1 * v1x * v1x + k2 * v1y * v1y;
+            const float r12 = (k1 - k2) * v1x * v1y;
+            const float r22 = k1 * v1y * v1y + k2 * v1x * v1x;
+            const float fux = (gux * r11 + gvx * r12) * su, fuy = (guy * r11 + gvy * r12) * su, fuz = (guz * r11 + gvz * r12) * su;
+            const float fvx = (gux * r12 + gvx * r22) * sv, fvy = (guy * r12 + gvy * r22) * sv, fvz = (guz * r12 + gvz * r22) * sv;
+
+            // anchor: mass weighted centroid, or the pinned corners when there are some
+            float a[3];
+            for (int i = 0; i < 3; i++) { a[i] = pins ? (w[i] == 0.0f ? 1.0f : 0.0f) : 1.0f / w[i]; }
+            const float sum = a[0] + a[1] + a[2];
+            const float mu[3] = { 0.0f, m1u[k], m2u[k] }, mv[3] = { 0.0f, m1v[k], m2v[k] };
+            float cx = 0.0f, cy = 0.0f, cz = 0.0f, cu = 0.0f, cv = 0.0f;
+            for (int i = 0; i < 3; i++) {
+                const float s = a[i] / sum;
+                cx += s * x[v[i]];
+                cy += s * y[v[i]];
+                cz += s * z[v[i]];
+                cu += s * mu[i];
+                cv += s * mv[i];
+            }
+            for (int i = 0; i < 3; i++) {
+                if (w[i] == 0.0f) { continue; }
+                const float du = mu[i] - cu, dv = mv[i] - cv;
+                x[v[i]] = cx + fux * du + fvx * dv;
+                y[v[i]] = cy + fuy * du + fvy * dv;
+                z[v[i]] = cz + fuz * du + fvz * dv;
+            }
+            clamped++;
+        }
+        return clamped;
+    }
+
+    // largest strain along warp and weft over all triangles (the column lengths of F minus 1), and the mean
+    // magnitude of both over all triangles (compressed triangles count too instead of cancelling stretched ones)
+    void measure(const float* x, const float* y, const float* z, const uint32_t* ta, const uint32_t* tb, const uint32_t* tc,
+            float& maxWarp, float& maxWeft, float& mean) const {
+        maxWarp = maxWeft = 0.0f;
+        double sum = 0.0;
+        for (size_t k = 0; k < size(); k++) {
+            const uint32_t t = triangle[k];
+            const glm::vec3 x0(x[ta[t]], y[ta[t]], z[ta[t]]);
+            const glm::vec3 e1 = glm::vec3(x[tb[t]], y[tb[t]], z[tb[t]]) - x0, e2 = glm::vec3(x[tc[t]], y[tc[t]], z[tc[t]]) - x0;
+            float warp = glm::length(e1 * i11[k] + e2 * i21[k]) - 1.0f, weft = glm::length(e1 * i12[k] + e2 * i22[k]) - 1.0f;
+            maxWarp = std::max(maxWarp, warp);
+            maxWeft = std::max(maxWeft, weft);
+            sum += 0.5 * (std::abs(double(warp)) + std::abs(double(weft)));
+        }
+        mean = size() ? static_cast<float>(sum / size()) : 0.0f;
+    }
+
+    size_t memoryBytes() const {
+        return (triangle.capacity() + colorOffsets.capacity()) * sizeof(uint32_t) +
+            (m1u.capacity() + m1v.capacity() + m2u.capacity() + m2v.capacity() + i11.capacity() + i12.capacity() +
+                i21.capacity() + i22.capacity()) * sizeof(float);
+    }
+
+private:
+    // everything below is in color order: slot k is triangle[k]
+    std::vector<uint32_t> triangle;
+    std::vector<uint32_t> colorOffsets;  // slots [colorOffsets[c], colorOffsets[c + 1]) share a color
+    std::vector<float> m1u, m1v, m2u, m2v; // corners 1 and 2 in the material frame, corner 0 is the origin
+    std::vector<float> i11, i12, i21, i22; // inverse of the 2x2 rest shape [m1 m2]
+};
+
+#include "ClothFloatPreciseEnd.hpp"
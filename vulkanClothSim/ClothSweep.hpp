@@ -0,0 +1,310 @@
+#pragma once
+#include "ClothScenes.hpp"
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+#include "SolverSnapshot.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Parameter sweeps
+// Runs one scene many times with different solver parameters (every combination of a few stretch, bend,
+// damping... values). The scene is built once: mesh loading, constraint coloring and collider grids are
+// paid for a single time, then every worker thread takes one copy of that solver and runs whole simulations
+// on it back to back, restoring the shared start snapshot before each run. Colliders are shared read only
+// between the copies (ClothSolver::colliders).
+// Each run is single threaded (solver.jobs stays null). With hundreds of independent runs one run per
+// core scales with the core count, splitting every step across cores would not.
+//
+// spec file, one setting per line, '#' starts a comment:
+//   scene = bunny                          any standard scene (ClothScenes.hpp)
+//   steps = 300                            frames simulated per run
+//   settle = 60                            frames simulated once with the base parameters before forking
+//   grid = 64                              resolution of the grid scene
+//   deterministic = 1                      reproducible runs, the checksum column then identifies results
+//   damping = 0.05, 0.1, 0.2               swept parameter, list of values
+//   bendCompliance = 1e-5 : 1e-2 : 4 log   swept parameter, 4 values from 1e-5 to 1e-2 (lin or log spacing)
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct SweepParameter {
+    std::string name;
+    std::vector<float> values;
+};
+
+// sets one swept parameter, false if the name isn't sweepable. Parameters that change the topology or the
+// masses (areaDensity) can't be swept, the solver is only built once.
+inline bool setSweepParameter(SolverParams& params, const std::string& name, float value) {
+    if (name == "stretchCompliance") { params.stretchCompliance = value; }
+    else if (name == "bendCompliance") { params.bendCompliance = value; }
+    else if (name == "damping") { params.damping = value; }
+    else if (name == "collisionThickness") { params.collisionThickness = value; }
+    else if (name == "frictionScale") { params.frictionScale = value; }
+    else if (name == "airDensity") { params.airDensity = value; }
+    else if (name == "dragCoefficient") { params.dragCoefficient = value; }
+    else if (name == "liftCoefficient") { params.liftCoefficient = value; }
+    else if (name == "timeStep") { params.timeStep = value; }
+    else if (name == "substeps") { params.substeps = std::max(1u, static_cast<uint32_t>(value)); }
+    else { return false; }
+    return true;
+}
+
+struct SweepSpec {
+    std::string scene = "hanging";
+    uint32_t steps = 300;
+    uint32_t settleSteps = 0;
+    SceneOptions sceneOptions;
+    std::vector<SweepParameter> parameters;
+
+    size_t runCount() const {
+        size_t count = 1;
+        for (const auto& parameter : parameters) { count *= parameter.values.size(); }
+        return count;
+    }
+
+    // run index -> one value of every parameter, the last parameter varies fastest
+    SolverParams runParams(size_t run) const {
+        SolverParams params = sceneOptions.params;
+        for (size_t k = parameters.size(); k-- > 0;) {
+            const SweepParameter& parameter = parameters[k];
+            setSweepParameter(params, parameter.name, parameter.values[run % parameter.values.size()]);
+            run /= parameter.values.size();
+        }
+        return params;
+    }
+
+    float runValue(size_t run, size_t parameter) const {
+        for (size_t k = parameters.size() - 1; k > parameter; k--) { run /= parameters[k].values.size(); }
+        return parameters[parameter].values[run % parameters[parameter].values.size()];
+    }
+};
+
+// "a, b, c" or "from : to : count [lin|log]"
+inline std::vector<float> parseSweepValues(const std::string& text) {
+    std::vector<float> values;
+    if (text.find(':') == std::string::npos) {
+        std::stringstream list(text);
+        std::string item;
+        while (std::getline(list, item, ',')) {
+            values.push_back(std::stof(item));
+        }
+        return values;
+    }
+
+    std::string range = text;
+    std::replace(range.begin(), range.end(), ':', ' ');
+    std::istringstream in(range);
+    float from = 0.0f, to = 0.0f;
+    uint32_t count = 0;
+    std::string spacing = "lin";
+    in >> from >> to >> count >> spacing;
+    if (in.fail() && !in.eof()) {
+        throw std::runtime_error("failed to parse sweep range: " + text);
+    }
+    bool logSpacing = spacing == "log";
+    if (count == 0 || (logSpacing && (from <= 0.0f || to <= 0.0f)) || (spacing != "lin" && !logSpacing)) {
+        throw std::runtime_error("invalid sweep range: " + text);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        double t = count > 1 ? double(i) / (count - 1) : 0.0;
+        values.push_back(logSpacing ?
+            static_cast<float>(std::exp(std::log(from) + t * (std::log(to) - std::log(from)))) :
+            static_cast<float>(from + t * (to - from)));
+    }
+    return values;
+}
+
+inline SweepSpec parseSweepSpec(std::istream& in) {
+    SweepSpec spec;
+    std::string line;
+    while (std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        size_t equals = line.find('=');
+        if (line.find_first_not_of(" \t\r") == std::string::npos) { continue; }
+        if (equals == std::string::npos) {
+            throw std::runtime_error("failed to parse sweep spec line: " + line);
+        }
+        auto trim = [](std::string s) {
+            s.erase(0, s.find_first_not_of(" \t\r"));
+            s.erase(s.find_last_not_of(" \t\r") + 1);
+            return s;
+        };
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+
+        if (key == "scene") { spec.scene = value; }
+        else if (key == "steps") { spec.steps = static_cast<uint32_t>(std::stoul(value)); }
+        else if (key == "settle") { spec.settleSteps = static_cast<uint32_t>(std::stoul(value)); }
+        else if (key == "grid") { spec.sceneOptions.gridResolution = static_cast<uint32_t>(std::stoul(value)); }
+        else if (key == "deterministic") { spec.sceneOptions.params.deterministic = std::stoul(value) != 0; }
+        else {
+            SolverParams check;
+            if (!setSweepParameter(check, key, 0.0f)) {
+                throw std::runtime_error("unknown sweep parameter: " + key);
+            }
+            std::vector<float> values = parseSweepValues(value);
+            if (values.empty()) {
+                throw std::runtime_error("sweep parameter " + key + " has no values!");
+            }
+            // a single value just overrides the base parameters of every run
+            if (values.size() == 1) { setSweepParameter(spec.sceneOptions.params, key, values[0]); }
+            else { spec.parameters.push_back({ key, values }); }
+        }
+    }
+    return spec;
+}
+
+// `text` (optional) receives the file contents, distributed sweeps send it on to their workers
+inline SweepSpec loadSweepSpec(const std::string& filename, std::string* text = nullptr) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open sweep spec " + filename + "!");
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    if (text) { *text = contents.str(); }
+    return parseSweepSpec(contents);
+}
+
+struct SweepResult {
+    double kineticEnergy = 0.0;
+    double stretchError = 0.0; // mean |length - rest| / rest over the stretch constraints
+    float lowestY = 0.0f;
+    double seconds = 0.0;
+    uint64_t checksum = 0;
+};
+
+struct SweepStats {
+    size_t runs = 0;
+    uint32_t workers = 0;
+    double setupSeconds = 0.0; // scene build + settle, paid once
+    double seconds = 0.0;      // all runs, wall clock
+
+    double simsPerHour() const { return seconds > 0.0 ? runs * 3600.0 / seconds : 0.0; }
+};
+
+// final state metrics of one run
+inline SweepResult measureSweepRun(const ClothSolver& solver) {
+    const ParticleStore& p = solver.particles;
+    const DistanceConstraints& c = solver.stretch;
+    SweepResult result;
+    result.kineticEnergy = solver.stats.kineticEnergy;
+    result.checksum = solver.computeChecksum();
+
+    double error = 0.0;
+    size_t active = 0;
+    for (size_t k = 0; k < c.size(); k++) {
+        if (!c.active(k)) { continue; }
+        active++;
+        float length = glm::distance(p.position(c.a[k]), p.position(c.b[k]));
+        if (c.restLength[k] > 0.0f) { error += std::abs(length - c.restLength[k]) / c.restLength[k]; }
+    }
+    result.stretchError = active ? error / active : 0.0;
+    result.lowestY = p.size() ? *std::min_element(p.y.begin(), p.y.end()) : 0.0f;
+    return result;
+}
+
+// builds and settles the scene once, `start` is the state every run begins from
+inline void prepareSweep(const SweepSpec& spec, ClothSolver& base, SolverSnapshot& start) {
+    PROFILE_ZONE("prepareSweep");
+    buildScene(spec.scene, spec.sceneOptions, base);
+    for (uint32_t i = 0; i < spec.settleSteps; i++) { base.step(); }
+    captureSnapshot(base, start);
+}
+
+// one run on a solver built for `spec` (prepareSweep or a copy of its solver)
+inline SweepResult runSweepTask(const SweepSpec& spec, ClothSolver& solver, const SolverSnapshot& start, size_t run) {
+    PROFILE_ZONE("sweep run");
+    int64_t runStart = CpuProfiler::nowNs();
+    restoreSnapshot(solver, start);
+    solver.applyParams(spec.runParams(run));
+    for (uint32_t i = 0; i < spec.steps; i++) { solver.step(); }
+    SweepResult result = measureSweepRun(solver);
+    result.seconds = (CpuProfiler::nowNs() - runStart) * 1e-9;
+    return result;
+}
+
+// runs every combination in `spec` on `workers` threads (0 = one per hardware thread), results by run index
+inline std::vector<SweepResult> runSweep(const SweepSpec& spec, uint32_t workers, SweepStats& stats) {
+    PROFILE_ZONE("runSweep");
+    int64_t setupStart = CpuProfiler::nowNs();
+    ClothSolver base;
+    SolverSnapshot start;
+    prepareSweep(spec, base, start);
+
+    const size_t runs = spec.runCount();
+    if (workers == 0) { workers = std::max(1u, std::thread::hardware_concurrency()); }
+    workers = static_cast<uint32_t>(std::min<size_t>(workers, runs));
+    stats = SweepStats{};
+    stats.runs = runs;
+    stats.workers = workers;
+    stats.setupSeconds = (CpuProfiler::nowNs() - setupStart) * 1e-9;
+
+    std::vector<SweepResult> results(runs);
+    std::atomic<size_t> next{ 0 };
+    std::atomic<bool> failed{ false };
+
+    auto work = [&](std::exception_ptr& error) {
+        try {
+            ClothSolver solver = base; // one copy per worker, reused for all of its runs
+            solver.jobs = nullptr;
+            for (size_t run = next++; run < runs && !failed; run = next++) {
+                results[run] = runSweepTask(spec, solver, start, run);
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+            failed = true;
+        }
+    };
+
+    int64_t runStart = CpuProfiler::nowNs();
+    std::vector<std::exception_ptr> errors(workers);
+    std::vector<std::thread> threads;
+    for (uint32_t w = 1; w < workers; w++) {
+        threads.emplace_back(work, std::ref(errors[w]));
+    }
+    work(errors[0]); // the calling thread is worker 0
+    for (auto& thread : threads) { thread.join(); }
+    stats.seconds = (CpuProfiler::nowNs() - runStart) * 1e-9;
+
+    for (const auto& error : errors) {
+        if (error) { std::rethrow_exception(error); }
+    }
+    return results;
+}
+
+// CSV summary, one row per run: swept values then the metrics
+inline void writeSweepTable(std::ostream& out, const SweepSpec& spec, const std::vector<SweepResult>& results) {
+    out << "run";
+    for (const auto& parameter : spec.parameters) { out << "," << parameter.name; }
+    out << ",kineticEnergy,stretchError,lowestY,seconds,checksum\n";
+
+    char line[256];
+    for (size_t run = 0; run < results.size(); run++) {
+        const SweepResult& r = results[run];
+        out << run;
+        for (size_t k = 0; k < spec.parameters.size(); k++) {
+            std::snprintf(line, sizeof(line), ",%.6g", spec.runValue(run, k));
+            out << line;
+        }
+        std::snprintf(line, sizeof(line), ",%.9g,%.6g,%.6g,%.4f,%016llx\n", r.kineticEnergy, r.stretchError, r.lowestY,
+            r.seconds, static_cast<unsigned long long>(r.checksum));
+        out << line;
+    }
+}
+
+#include "ClothFloatPreciseEnd.hpp"
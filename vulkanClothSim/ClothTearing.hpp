@@ -0,0 +1,425 @@
+#pragma once
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Cloth tearing
+// After every step, stretch constraints pulled past (1 + strain) times their rest length tear. A tear splits
+// one endpoint v of the constraint: the triangles around v on the far side of a plane through v (normal
+// toward the other endpoint) move to a new vertex v', together with the constraints that only those
+// triangles use. The edges between the two sides get duplicated, one copy per side, and the bend constraint
+// across each of them is dropped, so the cloth opens up along them.
+// Everything is edited in place so a tear costs a few hundred operations instead of a rebuild:
+// - new vertices come from a pool of spare particles appended at attach() (massless and unreferenced until
+//   used), so particle arrays, vertex buffers and snapshots never resize
+// - every stretch color gets holes (DistanceConstraints::addHoles) that duplicated edges are written into,
+//   in a color neither endpoint uses yet, so no recoloring either
+// - a per vertex constraint list with some slack says which constraints follow a vertex when it splits
+// update() reports what changed (TearEvents) so renderers only rewrite those vertices and triangles.
+// Tears are processed in constraint order with a fixed scan grain, so tearing stays deterministic.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct TearSettings {
+    float strain = 0.5f;            // tear past (1 + strain) times the rest length
+    uint32_t maxTearsPerStep = 32;  // bounds the cost of one update(), the rest tears next step
+    uint32_t spareParticles = 0;    // size of the new vertex pool, 0 = a quarter of the particle count
+};
+
+// what the last update() changed, for incremental buffer updates
+struct TearEvents {
+    std::vector<uint32_t> newVertices;    // particles taken from the spare pool
+    std::vector<uint32_t> sourceVertices; // vertex each new one was split from (copy its uv and color)
+    std::vector<uint32_t> triangles;      // triangles with a corner moved to a new vertex
+    uint32_t tears = 0;
+    uint32_t droppedConstraints = 0;      // duplicated edges that found no free hole (the seam opens a bit further)
+    bool poolExhausted = false;           // tears were skipped because the spare pool ran out
+
+    void clear() {
+        newVertices.clear();
+        sourceVertices.clear();
+        triangles.clear();
+        tears = 0;
+        droppedConstraints = 0;
+        poolExhausted = false;
+    }
+};
+
+class ClothTearing {
+public:
+    TearSettings settings;
+
+    // prepares a built solver for tearing: spare particles, holes in every stretch color and the per vertex
+    // constraint lists. Call once after build() / buildGridSolver() and before stepping.
+    void attach(ClothSolver& solver, const TearSettings& tearSettings) {
+        settings = tearSettings;
+        ParticleStore& p = solver.particles;
+        const uint32_t used = static_cast<uint32_t>(p.size());
+        const uint32_t spare = settings.spareParticles ? settings.spareParticles : std::max<uint32_t>(16, used / 4);
+        p.resize(size_t(used) + spare); // spare slots stay at the origin with invMass 0, nothing references them
+        freeParticles.resize(spare);
+        for (uint32_t s = 0; s < spare; s++) { freeParticles[s] = used + spare - 1 - s; } // pop in ascending order
+        solver.contacts.resize(p.size());
+
+        // an interior tear duplicates two edges
+        DistanceConstraints& stretch = solver.stretch;
+        if (stretch.colorCount() + EXTRA_COLORS > 64) {
+            throw std::runtime_error("too many stretch colors to make room for tearing!");
+        }
+        const uint32_t colors = static_cast<uint32_t>(stretch.colorCount()) + EXTRA_COLORS;
+        stretch.addHoles(2 * spare / colors + 16, EXTRA_COLORS);
+
+        std::vector<uint32_t> indices;
+        solver.triangles.indices(indices);
+        uint32_t maxValence = 0;
+        for (uint32_t v : solver.triangles.vertexValence) { maxValence = std::max(maxValence, v); }
+        solver.triangles.assign(indices, p.size(), maxValence);
+
+        // constraint lists per vertex, ADJACENCY_SLACK free entries each for duplicated edges
+        const size_t n = p.size();
+        adjacencyCount.assign(n, 0);
+        forEachConstraint(solver, [&](uint32_t, uint32_t i, uint32_t j) { adjacencyCount[i]++; adjacencyCount[j]++; });
+        uint32_t maxCount = 0;
+        for (uint32_t count : adjacencyCount) { maxCount = std::max(maxCount, count); }
+        adjacencyStart.assign(n + 1, 0);
+        for (size_t i = 0; i < n; i++) {
+            uint32_t count = i < used ? adjacencyCount[i] : maxCount; // a new vertex can take over all of v's
+            adjacencyStart[i + 1] = adjacencyStart[i] + count + ADJACENCY_SLACK;
+        }
+        adjacency.resize(adjacencyStart[n]);
+        std::fill(adjacencyCount.begin(), adjacencyCount.end(), 0);
+        forEachConstraint(solver, [&](uint32_t entry, uint32_t i, uint32_t j) {
+            adjacency[adjacencyStart[i] + adjacencyCount[i]++] = entry;
+            adjacency[adjacencyStart[j] + adjacencyCount[j]++] = entry;
+        });
+
+        // stretch colors in use per vertex and the free holes of every color
+        stretchColors.assign(n, 0);
+        freeStretch.assign(colors, {});
+        for (uint32_t c = 0; c < stretch.colorCount(); c++) {
+            for (uint32_t k = stretch.colorOffsets[c]; k < stretch.colorOffsets[c + 1]; k++) {
+                if (stretch.active(k)) {
+                    stretchColors[stretch.a[k]] |= 1ull << c;
+                    stretchColors[stretch.b[k]] |= 1ull << c;
+                }
+                else {
+                    freeStretch[c].push_back(k);
+                }
+            }
+            std::reverse(freeStretch[c].begin(), freeStretch[c].end()); // fill holes front to back
+        }
+
+        candidates.resize(stretch.size());
+        chunkCandidates.resize((stretch.size() + SCAN_GRAIN - 1) / SCAN_GRAIN);
+        moves.resize(maxValence);
+        entries.reserve(maxCount + ADJACENCY_SLACK);
+        lastEvents.clear();
+        lastEvents.newVertices.reserve(settings.maxTearsPerStep);
+        lastEvents.sourceVertices.reserve(settings.maxTearsPerStep);
+        lastEvents.triangles.reserve(size_t(settings.maxTearsPerStep) * maxValence);
+        tearCount = 0;
+
+        solver.topologyHash = solver.computeTopologyHash();
+    }
+
+    // tears what the last step overstretched, call right after ClothSolver::step()
+    const TearEvents& update(ClothSolver& solver) {
+        PROFILE_ZONE("ClothTearing::update");
+        TearEvents& events = lastEvents;
+        events.clear();
+        const DistanceConstraints& stretch = solver.stretch;
+        const ParticleStore& p = solver.particles;
+        const float limit = (1.0f + settings.strain) * (1.0f + settings.strain);
+
+        // candidates per chunk are written from the chunk's first slot, like ContactBatch. No branch: every
+        // index is stored and only a hit advances the cursor, so a tearing frame (many hits in no particular
+        // order) costs the same as a quiet one. Holes have rest length 0 and no length, they never hit.
+        auto scan = [&](size_t begin, size_t end) {
+            const float* x = p.x.data();
+            const float* y = p.y.data();
+            const float* z = p.z.data();
+            const uint32_t* a = stretch.a.data();
+            const uint32_t* b = stretch.b.data();
+            const float* rest = stretch.restLength.data();
+            uint32_t* out = candidates.data() + begin;
+            uint32_t found = 0;
+            for (size_t k = begin; k < end; k++) {
+                uint32_t i = a[k], j = b[k];
+                float dx = x[i] - x[j], dy = y[i] - y[j], dz = z[i] - z[j];
+                out[found] = static_cast<uint32_t>(k);
+                found += dx * dx + dy * dy + dz * dz > rest[k] * rest[k] * limit;
+            }
+            chunkCandidates[begin / SCAN_GRAIN] = found;
+        };
+        if (solver.jobs) {
+            solver.jobs->parallelFor(stretch.size(), SCAN_GRAIN, scan);
+        }
+        else {
+            for (size_t begin = 0; begin < stretch.size(); begin += SCAN_GRAIN) { scan(begin, std::min(stretch.size(), begin + SCAN_GRAIN)); }
+        }
+
+        for (size_t chunk = 0; chunk < chunkCandidates.size() && events.tears < settings.maxTearsPerStep; chunk++) {
+            for (uint32_t n = 0; n < chunkCandidates[chunk] && events.tears < settings.maxTearsPerStep; n++) {
+                uint32_t k = candidates[chunk * SCAN_GRAIN + n];
+                // an earlier tear this step may have relabeled or relaxed it
+                if (!overstretched(p, stretch, k, limit)) { continue; }
+                uint32_t i = stretch.a[k], j = stretch.b[k];
+                if (split(solver, i, j) || split(solver, j, i)) {
+                    events.tears++;
+                }
+                else if (events.poolExhausted) {
+                    return events;
+                }
+            }
+        }
+        return events;
+    }
+
+    const TearEvents& events() const { return lastEvents; }
+    size_t spareLeft() const { return freeParticles.size(); }
+    uint64_t totalTears() const { return tearCount; }
+
+    size_t memoryBytes() const {
+        size_t bytes = (freeParticles.capacity() + adjacencyStart.capacity() + adjacencyCount.capacity() +
+            adjacency.capacity() + candidates.capacity() + chunkCandidates.capacity()) * sizeof(uint32_t) +
+            stretchColors.capacity() * sizeof(uint64_t);
+        for (const auto& holes : freeStretch) { bytes += holes.capacity() * sizeof(uint32_t); }
+        return bytes;
+    }
+
+private:
+    static constexpr uint32_t BEND = 0x80000000u; // adjacency entry flag, the low bits are the constraint index
+    static constexpr size_t SCAN_GRAIN = 4096;    // fixed, candidate order must not depend on the thread count
+    static constexpr uint32_t ADJACENCY_SLACK = 4;
+    static constexpr uint32_t EXTRA_COLORS = 2;   // hole only stretch colors, free for any pair at first
+
+    std::vector<uint32_t> freeParticles;                  // spare pool, popped from the back
+    std::vector<uint32_t> adjacencyStart, adjacencyCount; // vertex i owns entries [start[i], start[i + 1])
+    std::vector<uint32_t> adjacency;                      // stretch index, or bend index | BEND
+    std::vector<uint64_t> stretchColors;                  // bit c = vertex is in a color c stretch constraint
+    std::vector<std::vector<uint32_t>> freeStretch;       // holes per stretch color
+    std::vector<uint32_t> candidates, chunkCandidates;
+    std::vector<uint8_t> moves;                           // per triangle of the vertex being split: goes to v'
+    std::vector<uint32_t> entries;                        // copy of v's constraint list while it changes
+    TearEvents lastEvents;
+    uint64_t tearCount = 0;
+
+    template <typename Fn>
+    static void forEachConstraint(const ClothSolver& solver, const Fn& fn) {
+        for (uint32_t k = 0; k < solver.stretch.size(); k++) {
+            if (solver.stretch.active(k)) { fn(k, solver.stretch.a[k], solver.stretch.b[k]); }
+        }
+        for (uint32_t k = 0; k < solver.bend.size(); k++) {
+            if (solver.bend.active(k)) { fn(k | BEND, solver.bend.a[k], solver.bend.b[k]); }
+        }
+    }
+
+    static bool overstretched(const ParticleStore& p, const DistanceConstraints& c, size_t k, float limit) {
+        uint32_t i = c.a[k], j = c.b[k];
+        if (i == j) { return false; }
+        float dx = p.x[i] - p.x[j], dy = p.y[i] - p.y[j], dz = p.z[i] - p.z[j];
+        return dx * dx + dy * dy + dz * dz > c.restLength[k] * c.restLength[k] * limit;
+    }
+
+    static bool hasCorner(const ClothTriangles& tris, uint32_t t, uint32_t v) {
+        return tris.a[t] == v || tris.b[t] == v || tris.c[t] == v;
+    }
+
+    // the corner of t that is neither u nor v
+    static uint32_t thirdCorner(const ClothTriangles& tris, uint32_t t, uint32_t u, uint32_t v) {
+        if (tris.a[t] != u && tris.a[t] != v) { return tris.a[t]; }
+        if (tris.b[t] != u && tris.b[t] != v) { return tris.b[t]; }
+        return tris.c[t];
+    }
+
+    bool addEntry(uint32_t vertex, uint32_t entry) {
+        if (adjacencyStart[vertex] + adjacencyCount[vertex] == adjacencyStart[vertex + 1]) { return false; }
+        adjacency[adjacencyStart[vertex] + adjacencyCount[vertex]++] = entry;
+        return true;
+    }
+
+    void removeEntry(uint32_t vertex, uint32_t entry) {
+        uint32_t* list = adjacency.data() + adjacencyStart[vertex];
+        for (uint32_t e = 0; e < adjacencyCount[vertex]; e++) {
+            if (list[e] == entry) {
+                list[e] = list[--adjacencyCount[vertex]];
+                return;
+            }
+        }
+    }
+
+    // moves constraint `entry` from endpoint `from` to `to`
+    void relabel(ClothSolver& solver, uint32_t entry, uint32_t from, uint32_t to) {
+        DistanceConstraints& c = (entry & BEND) ? solver.bend : solver.stretch;
+        uint32_t k = entry & ~BEND;
+        (c.a[k] == from ? c.a[k] : c.b[k]) = to;
+        removeEntry(from, entry);
+        addEntry(to, entry); // to is a fresh vertex with room for all of from's constraints
+        if (!(entry & BEND)) {
+            uint64_t bit = 1ull << c.colorOf(k);
+            stretchColors[from] &= ~bit;
+            stretchColors[to] |= bit;
+        }
+    }
+
+    // copy of stretch constraint k between v' and w, in a hole of a color neither of them uses
+    void duplicate(ClothSolver& solver, uint32_t k, uint32_t v, uint32_t w) {
+        DistanceConstraints& c = solver.stretch;
+        uint64_t taken = stretchColors[v] | stretchColors[w];
+        for (uint32_t color = 0; color < freeStretch.size(); color++) {
+            if ((taken >> color) & 1 || freeStretch[color].empty()) { continue; }
+            if (adjacencyStart[w] + adjacencyCount[w] == adjacencyStart[w + 1]) { break; }
+            uint32_t slot = freeStretch[color].back();
+            freeStretch[color].pop_back();
+            c.a[slot] = v;
+            c.b[slot] = w;
+            c.restLength[slot] = c.restLength[k];
+            c.compliance[slot] = c.compliance[k];
+            c.lambda[slot] = 0.0f;
+            addEntry(v, slot);
+            addEntry(w, slot);
+            stretchColors[v] |= 1ull << color;
+            stretchColors[w] |= 1ull << color;
+            return;
+        }
+        lastEvents.droppedConstraints++;
+    }
+
+    // drops the bend constraint across edge (v, w), between the far corners of its two triangles
+    void dropBendAcross(ClothSolver& solver, uint32_t v, uint32_t w) {
+        const ClothTriangles& tris = solver.triangles;
+        uint32_t far[2], found = 0;
+        for (uint32_t s = tris.vertexStart[v]; s < tris.vertexStart[v] + tris.vertexValence[v] && found < 2; s++) {
+            uint32_t t = tris.vertexTriangles[s];
+            if (hasCorner(tris, t, w)) { far[found++] = thirdCorner(tris, t, v, w); }
+        }
+        if (found < 2) { return; }
+        const uint32_t* list = adjacency.data() + adjacencyStart[far[0]];
+        for (uint32_t e = 0; e < adjacencyCount[far[0]]; e++) {
+            uint32_t entry = list[e];
+            if (!(entry & BEND)) { continue; }
+            uint32_t k = entry & ~BEND;
+            if ((solver.bend.a[k] == far[0] && solver.bend.b[k] == far[1]) || (solver.bend.a[k] == far[1] && solver.bend.b[k] == far[0])) {
+                solver.bend.disable(k);
+                removeEntry(far[0], entry);
+                removeEntry(far[1], entry);
+                return;
+            }
+        }
+    }
+
+    // splits vertex v, the triangles on `toward`'s side go to a new vertex
+    bool split(ClothSolver& solver, uint32_t v, uint32_t toward) {
+        if (solver.pins && solver.pins->kinematic(v)) { return false; } // moved by its group, a copy couldn't follow
+        ParticleStore& p = solver.particles;
+        ClothTriangles& tris = solver.triangles;
+        const uint32_t first = tris.vertexStart[v], valence = tris.vertexValence[v];
+        if (valence < 2) { return false; }
+
+        const glm::vec3 origin = p.position(v), normal = p.position(toward) - origin;
+        uint32_t moving = 0;
+        for (uint32_t s = 0; s < valence; s++) {
+            uint32_t t = tris.vertexTriangles[first + s];
+            glm::vec3 centroid = (p.position(tris.a[t]) + p.position(tris.b[t]) + p.position(tris.c[t])) / 3.0f;
+            moves[s] = glm::dot(centroid - origin, normal) > 0.0f;
+            moving += moves[s];
+        }
+        if (moving == 0 || moving == valence) { return false; }
+        if (freeParticles.empty()) {
+            lastEvents.poolExhausted = true;
+            return false;
+        }
+        const uint32_t nv = freeParticles.back();
+        freeParticles.pop_back();
+
+        // constraints follow the triangles they belong to, edges between the two sides are kept on both.
+        // v' takes over its constraints first (each brings its own color), only then do the duplicates pick a
+        // color, so nothing lands in a color v' is about to get
+        entries.assign(adjacency.begin() + adjacencyStart[v], adjacency.begin() + adjacencyStart[v] + adjacencyCount[v]);
+        uint32_t mixed = 0;
+        for (uint32_t entry : entries) {
+            const DistanceConstraints& c = (entry & BEND) ? solver.bend : solver.stretch;
+            uint32_t k = entry & ~BEND;
+            uint32_t w = c.a[k] == v ? c.b[k] : c.a[k];
+            if (entry & BEND) {
+                // (v, w) spans the edge shared by v's triangle (v, e0, e1) and w's triangle (w, e0, e1)
+                for (uint32_t s = 0; s < valence; s++) {
+                    uint32_t t = tris.vertexTriangles[first + s];
+                    uint32_t e0 = tris.a[t] != v ? tris.a[t] : tris.b[t];
+                    uint32_t e1 = thirdCorner(tris, t, v, e0);
+                    if (!sharesEdge(tris, w, e0, e1)) { continue; }
+                    if (moves[s]) { relabel(solver, entry, v, nv); }
+                    break;
+                }
+                continue;
+            }
+            uint32_t inside = 0, outside = 0;
+            for (uint32_t s = 0; s < valence; s++) {
+                if (hasCorner(tris, tris.vertexTriangles[first + s], w)) { (moves[s] ? inside : outside)++; }
+            }
+            if (inside && !outside) {
+                relabel(solver, entry, v, nv);
+            }
+            else if (inside && outside) {
+                entries[mixed++] = entry; // already read, the front of the copy is free
+            }
+        }
+        for (uint32_t n = 0; n < mixed; n++) {
+            uint32_t k = entries[n];
+            uint32_t w = solver.stretch.a[k] == v ? solver.stretch.b[k] : solver.stretch.a[k];
+            dropBendAcross(solver, v, w);
+            duplicate(solver, k, nv, w);
+        }
+
+        // triangles, v keeps its slots in their old order
+        uint32_t kept = 0;
+        for (uint32_t s = 0; s < valence; s++) {
+            uint32_t t = tris.vertexTriangles[first + s];
+            if (!moves[s]) {
+                tris.vertexTriangles[first + kept++] = t;
+                continue;
+            }
+            (tris.a[t] == v ? tris.a[t] : tris.b[t] == v ? tris.b[t] : tris.c[t]) = nv;
+            tris.vertexTriangles[tris.vertexStart[nv] + tris.vertexValence[nv]++] = t;
+            lastEvents.triangles.push_back(t);
+        }
+        tris.vertexValence[v] = kept;
+
+        // the new particle starts where v is, mass splits with the triangles (pinned stays pinned)
+        float share = float(moving) / float(valence);
+        p.x[nv] = p.x[v]; p.y[nv] = p.y[v]; p.z[nv] = p.z[v];
+        p.px[nv] = p.px[v]; p.py[nv] = p.py[v]; p.pz[nv] = p.pz[v];
+        p.vx[nv] = p.vx[v]; p.vy[nv] = p.vy[v]; p.vz[nv] = p.vz[v];
+        float w = p.invMass[v];
+        p.invMass[nv] = w > 0.0f ? w / share : 0.0f;
+        p.invMass[v] = w > 0.0f ? w / (1.0f - share) : 0.0f;
+        ContactCache& cache = solver.contacts;
+        cache.collider[nv] = cache.collider[v];
+        cache.feature[nv] = cache.feature[v];
+        cache.ax[nv] = cache.ax[v]; cache.ay[nv] = cache.ay[v]; cache.az[nv] = cache.az[v];
+
+        lastEvents.newVertices.push_back(nv);
+        lastEvents.sourceVertices.push_back(v);
+        uint32_t record[2] = { v, nv };
+        solver.topologyHash = ClothSolver::fnv1a(solver.topologyHash, record, sizeof(record));
+        tearCount++;
+        return true;
+    }
+
+    // does one of w's triangles have the edge (e0, e1)
+    static bool sharesEdge(const ClothTriangles& tris, uint32_t w, uint32_t e0, uint32_t e1) {
+        for (uint32_t s = tris.vertexStart[w]; s < tris.vertexStart[w] + tris.vertexValence[w]; s++) {
+            uint32_t t = tris.vertexTriangles[s];
+            if (hasCorner(tris, t, e0) && hasCorner(tris, t, e1)) { return true; }
+        }
+        return false;
+    }
+};
+
+#include "ClothFloatPreciseEnd.hpp"
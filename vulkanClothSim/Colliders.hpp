@@ -0,0 +1,230 @@
+#pragma once
+#include "ClothMesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Static colliders the cloth is pushed out of
+// Spheres are analytic. Triangle meshes (sphereWTex.obj, bunny.obj) are bucketed into a uniform grid
+// once at build time so a particle only tests the triangles in the cells around it.
+// Every collider has its own surface material, the solver applies Coulomb friction and restitution per contact.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+// friction limits are relative to the penetration a contact resolves (position based Coulomb friction)
+struct ContactMaterial {
+    float staticFriction = 0.5f;  // tangential slip below staticFriction * penetration is removed completely
+    float kineticFriction = 0.4f; // larger slip is reduced by at most kineticFriction * penetration
+    float restitution = 0.0f;     // fraction of the approach speed given back as bounce, 0 = inelastic
+};
+
+struct SphereCollider {
+    glm::vec3 center{ 0.0f };
+    float radius = 1.0f;
+    ContactMaterial material;
+};
+
+// closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+inline glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    glm::vec3 ab = b - a;
+    glm::vec3 ac = c - a;
+    glm::vec3 ap = p - a;
+    float d1 = glm::dot(ab, ap);
+    float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) { return a; }
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp);
+    float d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) { return b; }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp);
+    float d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) { return c; }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+class MeshCollider {
+public:
+    struct Hit {
+        glm::vec3 point;   // closest point on the surface
+        glm::vec3 normal;  // face normal of the closest triangle
+        uint32_t triangle; // which triangle, lets callers key caches on the collider feature
+        float distance;    // signed, negative means the particle is behind the surface
+    };
+
+    ContactMaterial material;
+
+    void build(const ClothMesh& mesh, float cellSizeHint = 0.0f) {
+        positions = mesh.positions;
+        indices = mesh.indices;
+
+        size_t triangleCount = indices.size() / 3;
+        normals.resize(triangleCount);
+        float averageEdge = 0.0f;
+        for (size_t t = 0; t < triangleCount; t++) {
+            const glm::vec3& a = positions[indices[3 * t + 0]];
+            const glm::vec3& b = positions[indices[3 * t + 1]];
+            const glm::vec3& c = positions[indices[3 * t + 2]];
+            glm::vec3 n = glm::cross(b - a, c - a);
+            float len = glm::length(n);
+            normals[t] = len > 0.0f ? n / len : glm::vec3(0.0f, 1.0f, 0.0f);
+            averageEdge += glm::length(b - a);
+        }
+        averageEdge = triangleCount ? averageEdge / triangleCount : 1.0f;
+
+        meshBounds(mesh, boundsLo, boundsHi);
+        cellSize = cellSizeHint > 0.0f ? cellSizeHint : std::max(averageEdge, 1e-3f);
+        for (int axis = 0; axis < 3; axis++) {
+            dims[axis] = std::max(1, static_cast<int>(std::ceil((boundsHi[axis] - boundsLo[axis]) / cellSize)));
+        }
+
+        // counting sort of (cell, triangle) pairs into a CSR layout
+        size_t cellCount = size_t(dims[0]) * dims[1] * dims[2];
+        cellStart.assign(cellCount + 1, 0);
+        for (int pass = 0; pass < 2; pass++) {
+            if (pass == 1) {
+                for (size_t i = 0; i < cellCount; i++) { cellStart[i + 1] += cellStart[i]; }
+                cellTriangles.resize(cellStart[cellCount]);
+                cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+            }
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                glm::vec3 lo = glm::min(glm::min(positions[indices[3 * t]], positions[indices[3 * t + 1]]), positions[indices[3 * t + 2]]);
+                glm::vec3 hi = glm::max(glm::max(positions[indices[3 * t]], positions[indices[3 * t + 1]]), positions[indices[3 * t + 2]]);
+                int l[3], h[3];
+                cellRange(lo, hi, l, h);
+                for (int z = l[2]; z <= h[2]; z++) {
+                    for (int y = l[1]; y <= h[1]; y++) {
+                        for (int x = l[0]; x <= h[0]; x++) {
+                            size_t cell = cellIndex(x, y, z);
+                            if (pass == 0) { cellStart[cell + 1]++; }
+                            else { cellTriangles[cellFill[cell]++] = t; }
+                        }
+                    }
+                }
+            }
+        }
+        cellFill.clear();
+    }
+
+    // closest triangle within `radius` of p, false if nothing is that close
+    bool query(const glm::vec3& p, float radius, Hit& hit) const {
+        glm::vec3 lo = p - glm::vec3(radius);
+        glm::vec3 hi = p + glm::vec3(radius);
+        if (lo.x > boundsHi.x || lo.y > boundsHi.y || lo.z > boundsHi.z ||
+            hi.x < boundsLo.x || hi.y < boundsLo.y || hi.z < boundsLo.z) {
+            return false;
+        }
+
+        int l[3], h[3];
+        cellRange(lo, hi, l, h);
+        float bestDistSq = radius * radius;
+        bool found = false;
+
+        for (int z = l[2]; z <= h[2]; z++) {
+            for (int y = l[1]; y <= h[1]; y++) {
+                for (int x = l[0]; x <= h[0]; x++) {
+                    size_t cell = cellIndex(x, y, z);
+                    for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++) {
+                        uint32_t t = cellTriangles[i];
+                        glm::vec3 c = closestPointOnTriangle(p, positions[indices[3 * t]], positions[indices[3 * t + 1]], positions[indices[3 * t + 2]]);
+                        glm::vec3 d = p - c;
+                        float distSq = glm::dot(d, d);
+                        if (distSq < bestDistSq) {
+                            bestDistSq = distSq;
+                            hit.point = c;
+                            hit.triangle = t;
+                            found = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (found) {
+            hit.normal = normals[hit.triangle];
+            float dist = std::sqrt(bestDistSq);
+            hit.distance = glm::dot(p - hit.point, hit.normal) < 0.0f ? -dist : dist;
+        }
+        return found;
+    }
+
+    // exposed so contact caches can re-test a single feature without a grid walk
+    glm::vec3 closestPoint(uint32_t triangle, const glm::vec3& p) const {
+        return closestPointOnTriangle(p, positions[indices[3 * triangle]], positions[indices[3 * triangle + 1]], positions[indices[3 * triangle + 2]]);
+    }
+
+    // query() restricted to one triangle, what a contact cache uses to re-test the feature it remembered
+    bool queryTriangle(uint32_t triangle, const glm::vec3& p, float radius, Hit& hit) const {
+        hit.point = closestPoint(triangle, p);
+        glm::vec3 d = p - hit.point;
+        float distSq = glm::dot(d, d);
+        if (distSq >= radius * radius) { return false; }
+        hit.triangle = triangle;
+        hit.normal = normals[triangle];
+        float dist = std::sqrt(distSq);
+        hit.distance = glm::dot(d, hit.normal) < 0.0f ? -dist : dist;
+        return true;
+    }
+    const glm::vec3& triangleNormal(uint32_t triangle) const { return normals[triangle]; }
+    size_t triangleCount() const { return normals.size(); }
+
+    size_t memoryBytes() const {
+        return positions.capacity() * sizeof(glm::vec3) + indices.capacity() * sizeof(uint32_t) +
+            normals.capacity() * sizeof(glm::vec3) + cellStart.capacity() * sizeof(uint32_t) +
+            cellTriangles.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    std::vector<glm::vec3> normals;
+    glm::vec3 boundsLo{ 0.0f }, boundsHi{ 0.0f };
+    float cellSize = 1.0f;
+    int dims[3] = { 1, 1, 1 };
+    std::vector<uint32_t> cellStart;     // CSR offsets, one per cell + 1
+    std::vector<uint32_t> cellTriangles; // triangle ids bucketed by cell
+    std::vector<uint32_t> cellFill;      // build scratch
+
+    void cellRange(const glm::vec3& lo, const glm::vec3& hi, int* l, int* h) const {
+        for (int axis = 0; axis < 3; axis++) {
+            l[axis] = std::clamp(static_cast<int>((lo[axis] - boundsLo[axis]) / cellSize), 0, dims[axis] - 1);
+            h[axis] = std::clamp(static_cast<int>((hi[axis] - boundsLo[axis]) / cellSize), 0, dims[axis] - 1);
+        }
+    }
+
+    size_t cellIndex(int x, int y, int z) const {
+        return (size_t(z) * dims[1] + y) * dims[0] + x;
+    }
+};
+
+struct ColliderSet {
+    std::vector<SphereCollider> spheres;
+    std::vector<MeshCollider> meshes;
+
+    bool empty() const { return spheres.empty() && meshes.empty(); }
+};
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Frame arena
+// Bump allocator for data that only lives for one solver step (reduction partials, collision candidates,
+// contact lists...). The solver keeps one arena per thread that runs its passes (JobSystem::threadIndex())
+// and rewinds all of them at the start of every step, so a pass just takes what it needs from the arena of
+// the thread it runs on, without locks and without touching the heap.
+// Blocks are kept across resets. If a step needed more than one block, the next reset swaps them for a
+// single block of the combined size, so after a few steps every step runs out of one block and
+// steady state simulation performs no heap allocations at all.
+// Nothing allocated here gets destroyed, only trivially destructible types belong in an arena.
+
+class FrameArena {
+public:
+    static constexpr size_t MIN_BLOCK_BYTES = 64 * 1024; // constexpr: std::max takes it by reference
+
+    FrameArena() = default;
+    // scratch isn't state, copies (of a whole solver, say) start out empty
+    FrameArena(const FrameArena&) {}
+    FrameArena& operator=(const FrameArena&) { return *this; }
+    FrameArena(FrameArena&&) = default;
+    FrameArena& operator=(FrameArena&&) = default;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        if (blocks.empty() || alignedOffset(alignment) + bytes > blocks[current].size) {
+            nextBlock(bytes + alignment);
+        }
+        size_t offset = alignedOffset(alignment);
+        used = offset + bytes;
+        peak = std::max(peak, consumed + used);
+        return blocks[current].data.get() + offset;
+    }
+
+    // uninitialized array of n elements
+    template <typename T>
+    T* allocArray(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "frame arena memory is never destroyed");
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    // forgets every allocation; merges the blocks if the last frame needed more than one
+    void reset() {
+        if (blocks.size() > 1) {
+            size_t total = 0;
+            for (const auto& block : blocks) { total += block.size; }
+            blocks.clear();
+            addBlock(total);
+        }
+        current = 0;
+        used = 0;
+        consumed = 0;
+    }
+
+    size_t capacity() const {
+        size_t total = 0;
+        for (const auto& block : blocks) { total += block.size; }
+        return total;
+    }
+
+    size_t highWater() const { return peak; } // most bytes in use at once since the arena was created
+
+private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;  // block allocations come from
+    size_t used = 0;     // bytes taken in the current block
+    size_t consumed = 0; // bytes in blocks before the current one
+    size_t peak = 0;
+
+    // first offset at or after `used` in the current block that is aligned in memory
+    size_t alignedOffset(size_t alignment) const {
+        uintptr_t base = reinterpret_cast<uintptr_t>(blocks[current].data.get());
+        return ((base + used + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+    }
+
+    void addBlock(size_t bytes) {
+        Block block;
+        block.size = std::max(bytes, MIN_BLOCK_BYTES);
+        block.data.reset(new uint8_t[block.size]);
+        blocks.push_back(std::move(block));
+    }
+
+    void nextBlock(size_t bytes) {
+        if (!blocks.empty()) {
+            consumed += blocks[current].size;
+            current++;
+        }
+        // later blocks were sized for earlier frames, skip the ones too small for this request
+        while (current < blocks.size() && blocks[current].size < bytes) {
+            consumed += blocks[current].size;
+            current++;
+        }
+        if (current >= blocks.size()) {
+            addBlock(std::max(bytes, blocks.empty() ? 0 : blocks.back().size * 2));
+            current = blocks.size() - 1;
+        }
+        used = 0;
+    }
+};
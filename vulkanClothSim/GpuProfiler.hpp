@@ -0,0 +1,239 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// GPU timing with timestamp queries
+// Each frame in flight owns a slice of one query pool. Scopes write a timestamp at the start and end
+// and the results are read back the next time that frame slot comes around (MAX_FRAMES_IN_FLIGHT frames later),
+// after its fence has already been waited on, so vkGetQueryPoolResults never has to block.
+// One extra "immediate" slice is used by single time command buffers (uploads) which are already
+// synchronous because of vkQueueWaitIdle.
+// Works on any implementation that reports timestampValidBits, including lavapipe (software Vulkan).
+
+class GpuProfiler {
+public:
+    static const uint32_t MAX_SCOPES_PER_SLOT = 32;
+    static const uint32_t HISTORY_SIZE = 240; // rolling window of samples per scope
+
+    struct Stats {
+        uint32_t samples = 0;
+        double avgMs = 0.0;
+        double p50Ms = 0.0;
+        double p95Ms = 0.0;
+        double p99Ms = 0.0;
+        double maxMs = 0.0;
+    };
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight) {
+        device = logicalDevice;
+
+        // a queue family with 0 valid bits does not support timestamps at all, profiler stays disabled
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+        uint32_t validBits = queueFamilyIndex < queueFamilyCount ? queueFamilies[queueFamilyIndex].timestampValidBits : 0;
+        if (validBits == 0) {
+            enabled = false;
+            return;
+        }
+        timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        nsPerTick = properties.limits.timestampPeriod;
+
+        slotCount = framesInFlight + 1; // last slot is the immediate one
+        slots.assign(slotCount, Slot{});
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = slotCount * MAX_SCOPES_PER_SLOT * 2;
+
+        if (vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+        enabled = true;
+    }
+
+    void destroy() {
+        if (queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, queryPool, nullptr);
+            queryPool = VK_NULL_HANDLE;
+        }
+        enabled = false;
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    // call right after vkBeginCommandBuffer for a frame slot whose fence has been waited on
+    // collects whatever this slot recorded last time, then resets its queries for reuse
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        if (!enabled) { return; }
+        collect(frameIndex, false);
+        resetSlot(commandBuffer, frameIndex);
+        activeSlot = frameIndex;
+    }
+
+    // single time commands (uploads): reset the immediate slice and route scopes to it
+    void beginImmediate(VkCommandBuffer commandBuffer) {
+        if (!enabled) { return; }
+        resetSlot(commandBuffer, slotCount - 1);
+        activeSlot = slotCount - 1;
+    }
+
+    // call after the immediate command buffer finished executing (after vkQueueWaitIdle)
+    void endImmediate() {
+        if (!enabled) { return; }
+        collect(slotCount - 1, true);
+    }
+
+    // returns a scope id to pass to endScope, or UINT32_MAX when disabled/out of queries
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) {
+        if (!enabled) { return UINT32_MAX; }
+        Slot& slot = slots[activeSlot];
+        if (slot.scopeCount >= MAX_SCOPES_PER_SLOT) { return UINT32_MAX; }
+
+        uint32_t scope = slot.scopeCount++;
+        slot.scopeIds[scope] = findOrAddScope(name);
+        vkCmdWriteTimestamp(commandBuffer, stage, queryPool, firstQuery(activeSlot) + scope * 2);
+        return scope;
+    }
+
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) {
+        if (!enabled || scope == UINT32_MAX) { return; }
+        vkCmdWriteTimestamp(commandBuffer, stage, queryPool, firstQuery(activeSlot) + scope * 2 + 1);
+    }
+
+    Stats stats(const std::string& name) const {
+        Stats result{};
+        for (const auto& scope : scopes) {
+            if (scope.name == name) {
+                return computeStats(scope);
+            }
+        }
+        return result;
+    }
+
+    void printSummary(std::ostream& out) const {
+        if (!enabled) {
+            out << "gpu profiler: timestamps not supported on this queue\n";
+            return;
+        }
+        out << "gpu timings (ms)          samples      avg      p50      p95      p99      max\n";
+        for (const auto& scope : scopes) {
+            Stats s = computeStats(scope);
+            out << std::left << std::setw(24) << scope.name << std::right << std::fixed << std::setprecision(3)
+                << std::setw(9) << s.samples
+                << std::setw(9) << s.avgMs << std::setw(9) << s.p50Ms << std::setw(9) << s.p95Ms
+                << std::setw(9) << s.p99Ms << std::setw(9) << s.maxMs << "\n";
+        }
+    }
+
+private:
+    struct Slot {
+        uint32_t scopeCount = 0;
+        std::array<uint32_t, MAX_SCOPES_PER_SLOT> scopeIds{};
+    };
+
+    struct ScopeHistory {
+        std::string name;
+        std::vector<double> samplesMs; // ring buffer
+        uint32_t next = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    bool enabled = false;
+    float nsPerTick = 1.0f;
+    uint64_t timestampMask = ~0ull;
+    uint32_t slotCount = 0;
+    uint32_t activeSlot = 0;
+    std::vector<Slot> slots;
+    std::vector<ScopeHistory> scopes;
+
+    uint32_t firstQuery(uint32_t slot) const { return slot * MAX_SCOPES_PER_SLOT * 2; }
+
+    void resetSlot(VkCommandBuffer commandBuffer, uint32_t slot) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery(slot), MAX_SCOPES_PER_SLOT * 2);
+        slots[slot].scopeCount = 0;
+    }
+
+    uint32_t findOrAddScope(const char* name) {
+        for (uint32_t i = 0; i < scopes.size(); i++) {
+            if (scopes[i].name == name) { return i; }
+        }
+        scopes.push_back(ScopeHistory{ name, {}, 0 });
+        return static_cast<uint32_t>(scopes.size() - 1);
+    }
+
+    void collect(uint32_t slotIndex, bool immediate) {
+        Slot& slot = slots[slotIndex];
+        if (slot.scopeCount == 0) { return; }
+
+        // pairs of (timestamp, availability) so a not yet written query never blocks us
+        std::array<uint64_t, MAX_SCOPES_PER_SLOT * 2 * 2> results{};
+        VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+        VkResult result = vkGetQueryPoolResults(device, queryPool, firstQuery(slotIndex), slot.scopeCount * 2,
+            sizeof(results), results.data(), sizeof(uint64_t) * 2, flags);
+
+        if (result == VK_SUCCESS || result == VK_NOT_READY) {
+            for (uint32_t i = 0; i < slot.scopeCount; i++) {
+                const uint64_t* begin = &results[i * 4];
+                const uint64_t* end = &results[i * 4 + 2];
+                if (begin[1] == 0 || end[1] == 0) { continue; } // unavailable, drop this sample
+
+                uint64_t ticks = ((end[0] & timestampMask) - (begin[0] & timestampMask)) & timestampMask;
+                pushSample(scopes[slot.scopeIds[i]], ticks * static_cast<double>(nsPerTick) * 1e-6);
+            }
+        }
+
+        // immediate scopes are consumed once, frame scopes are reset by the next beginFrame
+        if (immediate) { slot.scopeCount = 0; }
+    }
+
+    static void pushSample(ScopeHistory& scope, double ms) {
+        if (scope.samplesMs.size() < HISTORY_SIZE) {
+            scope.samplesMs.push_back(ms);
+        }
+        else {
+            scope.samplesMs[scope.next] = ms;
+        }
+        scope.next = (scope.next + 1) % HISTORY_SIZE;
+    }
+
+    static Stats computeStats(const ScopeHistory& scope) {
+        Stats s{};
+        if (scope.samplesMs.empty()) { return s; }
+
+        std::vector<double> sorted = scope.samplesMs;
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+        for (double v : sorted) { sum += v; }
+
+        auto percentile = [&](double p) {
+            size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+            return sorted[std::min(index, sorted.size() - 1)];
+        };
+
+        s.samples = static_cast<uint32_t>(sorted.size());
+        s.avgMs = sum / sorted.size();
+        s.p50Ms = percentile(0.50);
+        s.p95Ms = percentile(0.95);
+        s.p99Ms = percentile(0.99);
+        s.maxMs = sorted.back();
+        return s;
+    }
+};
@@ -0,0 +1,256 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Small job system
+// A fixed pool of worker threads pulling from one shared queue. Threads that wait on a counter run
+// queued jobs themselves instead of sleeping, so nested waits can't deadlock the pool.
+// parallelFor splits a range into chunks of `grain` items; the chunk boundaries only depend on the
+// grain, never on how many workers there are. It doesn't allocate: chunk jobs point at the caller's
+// functor instead of wrapping it in a std::function, and the queue is a ring that only ever grows.
+// TaskGraph runs named tasks as soon as all the tasks they depend on have finished (used by initVulkan).
+
+class JobSystem {
+public:
+    struct Counter {
+        std::atomic<uint32_t> pending{ 0 };
+    };
+
+    // workerCount 0 = one thread per hardware thread, minus the calling thread
+    explicit JobSystem(uint32_t workerCount = 0) {
+        if (workerCount == 0) {
+            uint32_t hw = std::max(1u, std::thread::hardware_concurrency());
+            workerCount = hw > 1 ? hw - 1 : 0;
+        }
+        queue.resize(64);
+        for (uint32_t i = 0; i < workerCount; i++) {
+            workers.emplace_back([this, i] {
+                currentThreadIndex() = i + 1;
+                workerLoop();
+            });
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) { worker.join(); }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // threads that execute jobs, including the one calling wait()/parallelFor()
+    uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+    // 1..workers on pool threads, 0 on every other thread; indexes per thread data like frame arenas
+    static uint32_t threadIndex() { return currentThreadIndex(); }
+
+    void submit(std::function<void()> job, Counter& counter) {
+        Job j;
+        j.fn = std::move(job);
+        push(std::move(j), counter);
+    }
+
+    // helps with queued work until the counter drops to zero
+    void wait(Counter& counter) {
+        while (counter.pending.load(std::memory_order_acquire) != 0) {
+            if (!runOne()) {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_for(lock, std::chrono::microseconds(100), [&] {
+                    return queued != 0 || counter.pending.load(std::memory_order_acquire) == 0;
+                });
+            }
+        }
+    }
+
+    // fn(begin, end) for chunks of [0, count); runs inline when there is only one chunk or no workers
+    template <typename Fn>
+    void parallelFor(size_t count, size_t grain, const Fn& fn) {
+        if (count == 0) { return; }
+        grain = std::max<size_t>(1, grain);
+        if (count <= grain || workers.empty()) {
+            for (size_t begin = 0; begin < count; begin += grain) {
+                fn(begin, std::min(count, begin + grain));
+            }
+            return;
+        }
+
+        Counter counter;
+        for (size_t begin = grain; begin < count; begin += grain) {
+            Job j;
+            j.range = [](const void* context, size_t b, size_t e) { (*static_cast<const Fn*>(context))(b, e); };
+            j.context = &fn;
+            j.begin = begin;
+            j.end = std::min(count, begin + grain);
+            push(std::move(j), counter);
+        }
+        fn(0, grain); // caller takes the first chunk
+        wait(counter);
+    }
+
+private:
+    // either a std::function (submit) or one parallelFor chunk calling back into the caller's functor
+    struct Job {
+        std::function<void()> fn;
+        void (*range)(const void*, size_t, size_t) = nullptr;
+        const void* context = nullptr;
+        size_t begin = 0, end = 0;
+        Counter* counter = nullptr;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<Job> queue; // ring buffer, [head, head + queued) wrapped
+    size_t head = 0;
+    size_t queued = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    static uint32_t& currentThreadIndex() {
+        thread_local uint32_t index = 0;
+        return index;
+    }
+
+    void push(Job&& job, Counter& counter) {
+        counter.pending.fetch_add(1, std::memory_order_relaxed);
+        job.counter = &counter;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queued == queue.size()) {
+                // full: unwrap into a ring twice the size
+                std::vector<Job> bigger(queue.size() * 2);
+                for (size_t i = 0; i < queued; i++) { bigger[i] = std::move(queue[(head + i) % queue.size()]); }
+                queue.swap(bigger);
+                head = 0;
+            }
+            queue[(head + queued) % queue.size()] = std::move(job);
+            queued++;
+        }
+        wake.notify_one();
+    }
+
+    bool runOne() {
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queued == 0) { return false; }
+            job = std::move(queue[head]);
+            head = (head + 1) % queue.size();
+            queued--;
+        }
+        if (job.range) { job.range(job.context, job.begin, job.end); }
+        else { job.fn(); }
+        if (job.counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            // wake waiters parked in wait() so they notice the counter hit zero
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_all();
+        }
+        return true;
+    }
+
+    void workerLoop() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || queued != 0; });
+                if (stopping && queued == 0) { return; }
+            }
+            runOne();
+        }
+    }
+};
+
+class TaskGraph {
+public:
+    // returns the task id to use in later dependency lists
+    uint32_t add(const char* name, std::function<void()> fn, std::initializer_list<uint32_t> dependencies = {}) {
+        uint32_t id = static_cast<uint32_t>(tasks.size());
+        tasks.push_back({ name, std::move(fn), {}, 0 });
+        for (uint32_t dependency : dependencies) {
+            tasks[dependency].dependents.push_back(id);
+            tasks[id].dependencyCount++;
+        }
+        return id;
+    }
+
+    // runs every task, independent ones concurrently; rethrows the first exception once the graph drained
+    // (tasks depending on a failed task are skipped)
+    void run(JobSystem& jobs) {
+        remaining.reset(new std::atomic<uint32_t>[tasks.size()]);
+        for (size_t i = 0; i < tasks.size(); i++) {
+            remaining[i].store(tasks[i].dependencyCount, std::memory_order_relaxed);
+        }
+        failure = nullptr;
+        failed.store(false);
+
+        JobSystem::Counter counter;
+        for (uint32_t i = 0; i < tasks.size(); i++) {
+            if (tasks[i].dependencyCount == 0) {
+                schedule(jobs, counter, i);
+            }
+        }
+        jobs.wait(counter);
+
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    // same tasks one after another in the order they were added (always a valid order, since
+    // dependencies have to exist before they can be named)
+    void runSerial() {
+        for (auto& task : tasks) {
+            task.fn();
+        }
+    }
+
+private:
+    struct Task {
+        const char* name;
+        std::function<void()> fn;
+        std::vector<uint32_t> dependents;
+        uint32_t dependencyCount;
+    };
+
+    std::vector<Task> tasks;
+    std::unique_ptr<std::atomic<uint32_t>[]> remaining;
+    std::mutex failureMutex;
+    std::exception_ptr failure;
+    std::atomic<bool> failed{ false };
+
+    void schedule(JobSystem& jobs, JobSystem::Counter& counter, uint32_t id) {
+        jobs.submit([this, &jobs, &counter, id] {
+            if (!failed.load(std::memory_order_acquire)) {
+                try {
+                    tasks[id].fn();
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(failureMutex);
+                    if (!failure) { failure = std::current_exception(); }
+                    failed.store(true, std::memory_order_release);
+                }
+            }
+
+            for (uint32_t dependent : tasks[id].dependents) {
+                if (remaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    schedule(jobs, counter, dependent);
+                }
+            }
+        }, counter);
+    }
+};
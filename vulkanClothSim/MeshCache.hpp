@@ -0,0 +1,104 @@
+#pragma once
+#include "ClothMesh.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+// Binary mesh cache
+// Parsing the OBJ is most of the setup time of the model based scenes. The first load of an OBJ writes
+// the welded ClothMesh (positions, uvs, indices as raw arrays) to <cacheDir>/<name>.cmesh, later loads
+// read it back with three bulk reads. The cache remembers size and modification time of the OBJ and is
+// rebuilt when either changes.
+// Files are written under a temporary name and renamed into place, so several processes sharing one cache
+// directory (sweep workers) never read a half written file.
+
+struct MeshCacheHeader {
+    uint32_t magic = 0x48534d43; // "CMSH"
+    uint32_t version = 1;
+    uint64_t sourceBytes = 0;
+    int64_t sourceTime = 0;
+    uint64_t vertexCount = 0;
+    uint64_t indexCount = 0;
+};
+
+inline MeshCacheHeader meshCacheSource(const std::filesystem::path& objPath) {
+    MeshCacheHeader header;
+    header.sourceBytes = std::filesystem::file_size(objPath);
+    header.sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(objPath).time_since_epoch().count());
+    return header;
+}
+
+// false if the file is missing, stale or damaged; `mesh` is only valid on true
+inline bool readMeshCache(const std::filesystem::path& cachePath, const MeshCacheHeader& source, ClothMesh& mesh) {
+    std::FILE* file = std::fopen(cachePath.string().c_str(), "rb");
+    if (file == nullptr) { return false; }
+
+    MeshCacheHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == source.magic && header.version == source.version &&
+        header.sourceBytes == source.sourceBytes && header.sourceTime == source.sourceTime;
+    std::error_code error;
+    uint64_t fileBytes = std::filesystem::file_size(cachePath, error);
+    ok = ok && !error && fileBytes == sizeof(header) + header.vertexCount * (sizeof(glm::vec3) + sizeof(glm::vec2)) + header.indexCount * sizeof(uint32_t);
+    if (ok) {
+        mesh.positions.resize(header.vertexCount);
+        mesh.uvs.resize(header.vertexCount);
+        mesh.indices.resize(header.indexCount);
+        ok = std::fread(mesh.positions.data(), sizeof(glm::vec3), mesh.positions.size(), file) == mesh.positions.size() &&
+            std::fread(mesh.uvs.data(), sizeof(glm::vec2), mesh.uvs.size(), file) == mesh.uvs.size() &&
+            std::fread(mesh.indices.data(), sizeof(uint32_t), mesh.indices.size(), file) == mesh.indices.size();
+    }
+    std::fclose(file);
+    return ok;
+}
+
+inline void writeMeshCache(const std::filesystem::path& cachePath, MeshCacheHeader header, const ClothMesh& mesh) {
+    header.vertexCount = mesh.positions.size();
+    header.indexCount = mesh.indices.size();
+
+    std::error_code error;
+    std::filesystem::create_directories(cachePath.parent_path(), error);
+    // random suffix so concurrent writers don't share a temporary, rename() then replaces the file in one step
+    std::filesystem::path temporary = cachePath;
+    temporary += ".tmp" + std::to_string(std::random_device{}());
+
+    std::FILE* file = std::fopen(temporary.string().c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("failed to create mesh cache file " + temporary.string() + "!");
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+        std::fwrite(mesh.positions.data(), sizeof(glm::vec3), mesh.positions.size(), file) == mesh.positions.size() &&
+        std::fwrite(mesh.uvs.data(), sizeof(glm::vec2), mesh.uvs.size(), file) == mesh.uvs.size() &&
+        std::fwrite(mesh.indices.data(), sizeof(uint32_t), mesh.indices.size(), file) == mesh.indices.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (ok) {
+        std::filesystem::rename(temporary, cachePath, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("failed to write mesh cache file " + cachePath.string() + "!");
+    }
+}
+
+// loadClothMesh() through the cache in `cacheDir`, an empty cacheDir just parses the OBJ
+inline ClothMesh loadClothMeshCached(const std::string& objPath, const std::string& cacheDir) {
+    if (cacheDir.empty()) {
+        return loadClothMesh(objPath);
+    }
+
+    const MeshCacheHeader source = meshCacheSource(objPath);
+    const std::filesystem::path cachePath = std::filesystem::path(cacheDir) / (std::filesystem::path(objPath).stem().string() + ".cmesh");
+    ClothMesh mesh;
+    if (readMeshCache(cachePath, source, mesh)) {
+        return mesh;
+    }
+    mesh = loadClothMesh(objPath);
+    writeMeshCache(cachePath, source, mesh);
+    return mesh;
+}
@@ -0,0 +1,335 @@
+#pragma once
+#include "ClothMesh.hpp"
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per frame mesh export (OBJ or binary little endian PLY sequences for downstream tools)
+// Everything that doesn't change between frames (uvs, faces, the PLY header) is formatted once in open(),
+// a frame then only formats its positions (std::to_chars, no iostreams) in front of the shared block.
+// Frames are formatted and written by a few dedicated writer threads, not the job system, so a slow disk
+// never stalls solver jobs. addFrame() copies positions and returns; it only waits when maxQueuedFrames
+// frames are already pending, which keeps memory bounded if the disk can't keep up.
+//
+// files: <directory>/<prefix>_00000.obj, _00001.obj, ...
+
+enum class ExportFormat { OBJ, PLY };
+
+struct ExportSettings {
+    ExportFormat format = ExportFormat::OBJ;
+    std::string prefix = "frame";
+    uint32_t writerThreads = 0;   // 0 = half the hardware threads (at least 1)
+    uint32_t maxQueuedFrames = 16;
+};
+
+class FrameExporter {
+public:
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t bytes = 0;
+        int64_t formatNs = 0; // summed over writer threads
+        int64_t writeNs = 0;
+        uint64_t stalls = 0;  // addFrame() calls that had to wait for a writer
+    };
+
+    ~FrameExporter() {
+        try { close(); }
+        catch (...) {}
+    }
+
+    void open(const std::string& outputDirectory, const ClothMesh& mesh, const ExportSettings& exportSettings = {}) {
+        close();
+        directory = outputDirectory;
+        settings = exportSettings;
+        settings.maxQueuedFrames = std::max(1u, settings.maxQueuedFrames);
+        particleCount = mesh.vertexCount();
+        nextFrame = 0;
+        stats = Stats{};
+        failure = nullptr;
+        stopping = false;
+
+        if (settings.format == ExportFormat::OBJ) {
+            buildObjStatic(mesh);
+        }
+        else {
+            buildPlyStatic(mesh);
+        }
+
+        uint32_t threads = settings.writerThreads;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency() / 2);
+        }
+        for (uint32_t i = 0; i < threads; i++) {
+            writers.emplace_back([this] { writerLoop(); });
+        }
+    }
+
+    void addFrame(const ParticleStore& particles) {
+        PROFILE_ZONE("FrameExporter::addFrame");
+        if (particles.size() != particleCount) {
+            throw std::runtime_error("export frame has the wrong particle count!");
+        }
+
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+            if (queue.size() + busy >= settings.maxQueuedFrames) {
+                stats.stalls++;
+                drained.wait(lock, [&] { return queue.size() + busy < settings.maxQueuedFrames || failure; });
+            }
+            if (!freeBuffers.empty()) {
+                job.xyz.swap(freeBuffers.back());
+                freeBuffers.pop_back();
+            }
+        }
+
+        const size_t n = particleCount;
+        job.frame = nextFrame++;
+        job.xyz.resize(n * 3);
+        std::copy(particles.x.begin(), particles.x.end(), job.xyz.begin());
+        std::copy(particles.y.begin(), particles.y.end(), job.xyz.begin() + n);
+        std::copy(particles.z.begin(), particles.z.end(), job.xyz.begin() + 2 * n);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    // waits for every queued frame, rethrows the first write failure
+    void close() {
+        if (writers.empty()) { return; }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& writer : writers) { writer.join(); }
+        writers.clear();
+
+        if (failure) {
+            std::exception_ptr error = failure;
+            failure = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    Stats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+private:
+    struct Job {
+        uint32_t frame = 0;
+        std::vector<float> xyz; // x values, then y, then z
+    };
+
+    ExportSettings settings;
+    std::string directory;
+    size_t particleCount = 0;
+    uint32_t nextFrame = 0;
+
+    std::vector<char> staticHead; // PLY header (OBJ has none)
+    std::vector<char> staticTail; // written after the positions: OBJ vt + f lines, PLY face block
+    std::vector<float> uvs;       // PLY stores uvs next to every position
+
+    std::vector<std::thread> writers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::deque<Job> queue;
+    std::vector<std::vector<float>> freeBuffers;
+    uint32_t busy = 0; // jobs taken by a writer but not finished
+    bool stopping = false;
+    std::exception_ptr failure;
+    Stats stats;
+
+    static char* writeFloat(char* p, char* end, float v) {
+        return std::to_chars(p, end, v).ptr;
+    }
+
+    static char* writeUint(char* p, char* end, uint32_t v) {
+        return std::to_chars(p, end, v).ptr;
+    }
+
+    static void append(std::vector<char>& out, const char* text) {
+        out.insert(out.end(), text, text + std::strlen(text));
+    }
+
+    template <typename T>
+    static void appendBinary(std::vector<char>& out, const T& value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T)); // PLY is declared little endian, like every platform we ship on
+    }
+
+    void buildObjStatic(const ClothMesh& mesh) {
+        staticHead.clear();
+        staticTail.clear();
+        uvs.clear();
+
+        // worst case: "vt " + 2 floats (15 chars each) + "\n", "f " + 3 x "a/a " (2 x 10 digits + 2)
+        staticTail.resize(mesh.uvs.size() * 36 + mesh.triangleCount() * 70);
+        char* p = staticTail.data();
+        char* end = p + staticTail.size();
+        for (const glm::vec2& uv : mesh.uvs) {
+            *p++ = 'v'; *p++ = 't'; *p++ = ' ';
+            p = writeFloat(p, end, uv.x);
+            *p++ = ' ';
+            p = writeFloat(p, end, 1.0f - uv.y); // ClothMesh flipped v for Vulkan, undo it for the file
+            *p++ = '\n';
+        }
+        for (size_t t = 0; t < mesh.triangleCount(); t++) {
+            *p++ = 'f';
+            for (int k = 0; k < 3; k++) {
+                uint32_t index = mesh.indices[3 * t + k] + 1;
+                *p++ = ' ';
+                p = writeUint(p, end, index);
+                *p++ = '/';
+                p = writeUint(p, end, index);
+            }
+            *p++ = '\n';
+        }
+        staticTail.resize(p - staticTail.data());
+    }
+
+    void buildPlyStatic(const ClothMesh& mesh) {
+        staticHead.clear();
+        staticTail.clear();
+
+        char line[64];
+        append(staticHead, "ply\nformat binary_little_endian 1.0\ncomment vulkanClothSim frame export\n");
+        std::snprintf(line, sizeof(line), "element vertex %zu\n", mesh.vertexCount());
+        append(staticHead, line);
+        append(staticHead, "property float x\nproperty float y\nproperty float z\nproperty float s\nproperty float t\n");
+        std::snprintf(line, sizeof(line), "element face %zu\n", mesh.triangleCount());
+        append(staticHead, line);
+        append(staticHead, "property list uchar int vertex_indices\nend_header\n");
+
+        uvs.resize(mesh.vertexCount() * 2);
+        for (size_t i = 0; i < mesh.vertexCount(); i++) {
+            uvs[2 * i] = mesh.uvs[i].x;
+            uvs[2 * i + 1] = 1.0f - mesh.uvs[i].y;
+        }
+
+        staticTail.reserve(mesh.triangleCount() * 13);
+        for (size_t t = 0; t < mesh.triangleCount(); t++) {
+            staticTail.push_back(3);
+            for (int k = 0; k < 3; k++) {
+                appendBinary(staticTail, static_cast<int32_t>(mesh.indices[3 * t + k]));
+            }
+        }
+    }
+
+    // positions in front of the shared blocks; `out` is the writer's own buffer and keeps its capacity
+    void formatFrame(const std::vector<float>& xyz, std::vector<char>& out) const {
+        const size_t n = particleCount;
+        if (settings.format == ExportFormat::OBJ) {
+            // "v " + 3 floats (at most 15 chars each with separators) + "\n"
+            out.resize(n * 50);
+            char* p = out.data();
+            char* end = p + out.size();
+            for (size_t i = 0; i < n; i++) {
+                *p++ = 'v';
+                *p++ = ' ';
+                p = writeFloat(p, end, xyz[i]);
+                *p++ = ' ';
+                p = writeFloat(p, end, xyz[n + i]);
+                *p++ = ' ';
+                p = writeFloat(p, end, xyz[2 * n + i]);
+                *p++ = '\n';
+            }
+            out.resize(p - out.data());
+        }
+        else {
+            out.resize(staticHead.size() + n * 5 * sizeof(float));
+            std::memcpy(out.data(), staticHead.data(), staticHead.size());
+            float* v = reinterpret_cast<float*>(out.data() + staticHead.size());
+            for (size_t i = 0; i < n; i++) {
+                float vertex[5] = { xyz[i], xyz[n + i], xyz[2 * n + i], uvs[2 * i], uvs[2 * i + 1] };
+                std::memcpy(v + 5 * i, vertex, sizeof(vertex));
+            }
+        }
+    }
+
+    void writeFile(uint32_t frame, const std::vector<char>& body) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "_%05u.%s", frame, settings.format == ExportFormat::OBJ ? "obj" : "ply");
+        std::string path = directory + "/" + settings.prefix + name;
+
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            throw std::runtime_error("failed to open export file " + path + "!");
+        }
+        bool ok = std::fwrite(body.data(), 1, body.size(), file) == body.size() &&
+            std::fwrite(staticTail.data(), 1, staticTail.size(), file) == staticTail.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok) {
+            throw std::runtime_error("failed to write export file " + path + "!");
+        }
+    }
+
+    void writerLoop() {
+        std::vector<char> body;
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty()) { return; }
+                job = std::move(queue.front());
+                queue.pop_front();
+                busy++;
+            }
+
+            int64_t formatNs = 0, writeNs = 0;
+            std::exception_ptr error;
+            {
+                PROFILE_ZONE("FrameExporter::write");
+                try {
+                    int64_t t0 = CpuProfiler::nowNs();
+                    formatFrame(job.xyz, body);
+                    int64_t t1 = CpuProfiler::nowNs();
+                    writeFile(job.frame, body);
+                    formatNs = t1 - t0;
+                    writeNs = CpuProfiler::nowNs() - t1;
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                busy--;
+                if (error && !failure) { failure = error; }
+                if (!error) {
+                    stats.frames++;
+                    stats.bytes += body.size() + staticTail.size();
+                    stats.formatNs += formatNs;
+                    stats.writeNs += writeNs;
+                }
+                freeBuffers.push_back(std::move(job.xyz));
+            }
+            drained.notify_one();
+        }
+    }
+};
@@ -0,0 +1,455 @@
+#pragma once
+#include "ClothSolver.hpp"
+#include "CpuProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Baked simulation cache
+// Simulate once, play back many times. Positions are quantized to a fixed grid (CacheSettings::quantization,
+// the max error is half a step) and stored per frame as
+//   keyframe:    difference to the previous particle of the same frame
+//   other frame: difference to the same particle in the previous frame
+// The signed differences are zigzag + varint coded and the resulting bytes go through an order-0 rANS coder
+// (the frame keeps the plain varint bytes if rANS doesn't win). Quantization happens before the delta, so
+// decoding is exact with respect to the quantized values and errors never accumulate over frames.
+// Keyframes every keyframeInterval frames plus an index at the end of the file give random access: decode
+// the closest keyframe at or before a frame and roll forward.
+//
+// file: CacheHeader | frame 0 | frame 1 | ... | CacheIndexEntry[frameCount]
+// header.frameCount/indexOffset are patched when the writer is closed.
+
+struct CacheHeader {
+    uint32_t magic = 0x45484343; // "CCHE"
+    uint32_t version = 1;
+    uint32_t particleCount = 0;
+    uint32_t frameCount = 0;
+    uint32_t keyframeInterval = 0;
+    float quantization = 0.0f;
+    float frameTime = 0.0f;      // seconds between frames
+    uint32_t reserved = 0;
+    uint64_t indexOffset = 0;
+};
+
+struct CacheIndexEntry {
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t keyframe;
+};
+
+struct CacheSettings {
+    float quantization = 1e-4f;     // 0.1 mm
+    uint32_t keyframeInterval = 30;
+};
+
+// byte wise rANS (32 bit state, 12 bit probabilities), static frequencies per block
+class RansCoder {
+public:
+    static const uint32_t PROB_BITS = 12;
+    static const uint32_t PROB_SCALE = 1u << PROB_BITS;
+    static const uint32_t RANS_L = 1u << 23;
+
+    // appends the frequency table and the coded bytes of `in` to `out`
+    static void encode(const std::vector<uint8_t>& in, std::vector<uint8_t>& out, std::vector<uint8_t>& scratch) {
+        uint32_t freq[256], cum[257];
+        buildFrequencies(in, freq);
+        buildCumulative(freq, cum);
+
+        uint32_t symbolCount = 0;
+        for (uint32_t s = 0; s < 256; s++) { symbolCount += freq[s] ? 1 : 0; }
+        writeVarint(out, symbolCount);
+        for (uint32_t s = 0; s < 256; s++) {
+            if (freq[s]) {
+                out.push_back(static_cast<uint8_t>(s));
+                writeVarint(out, freq[s]);
+            }
+        }
+
+        // rANS encodes back to front, the bytes come out reversed
+        scratch.clear();
+        uint32_t x = RANS_L;
+        for (size_t i = in.size(); i-- > 0;) {
+            uint32_t s = in[i];
+            uint32_t f = freq[s];
+            uint32_t xMax = ((RANS_L >> PROB_BITS) << 8) * f;
+            while (x >= xMax) {
+                scratch.push_back(static_cast<uint8_t>(x & 0xff));
+                x >>= 8;
+            }
+            x = ((x / f) << PROB_BITS) + (x % f) + cum[s];
+        }
+        for (int i = 0; i < 4; i++) {
+            scratch.push_back(static_cast<uint8_t>(x & 0xff));
+            x >>= 8;
+        }
+        out.insert(out.end(), scratch.rbegin(), scratch.rend());
+    }
+
+    // decodes `count` symbols, p is advanced past the frequency table and the coded bytes
+    static void decode(const uint8_t*& p, const uint8_t* end, size_t count, std::vector<uint8_t>& out) {
+        uint32_t freq[256] = {}, cum[257];
+        uint32_t symbolCount = readVarint(p, end);
+        for (uint32_t i = 0; i < symbolCount; i++) {
+            if (p >= end) { throw std::runtime_error("failed to decode cache frame, truncated frequency table!"); }
+            uint8_t s = *p++;
+            freq[s] = readVarint(p, end);
+        }
+        buildCumulative(freq, cum);
+        if (cum[256] != PROB_SCALE) {
+            throw std::runtime_error("failed to decode cache frame, bad frequency table!");
+        }
+
+        uint8_t slotToSymbol[PROB_SCALE];
+        for (uint32_t s = 0; s < 256; s++) {
+            std::memset(slotToSymbol + cum[s], static_cast<int>(s), freq[s]);
+        }
+
+        if (end - p < 4) { throw std::runtime_error("failed to decode cache frame, truncated rANS state!"); }
+        uint32_t x = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        p += 4;
+
+        out.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t slot = x & (PROB_SCALE - 1);
+            uint8_t s = slotToSymbol[slot];
+            out[i] = s;
+            x = freq[s] * (x >> PROB_BITS) + slot - cum[s];
+            while (x < RANS_L && p < end) {
+                x = (x << 8) | *p++;
+            }
+        }
+    }
+
+    static void writeVarint(std::vector<uint8_t>& out, uint32_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    static uint32_t readVarint(const uint8_t*& p, const uint8_t* end) {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p >= end) { throw std::runtime_error("failed to decode cache frame, truncated varint!"); }
+            uint8_t byte = *p++;
+            v |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) { return v; }
+        }
+        throw std::runtime_error("failed to decode cache frame, bad varint!");
+    }
+
+private:
+    // counts scaled to PROB_SCALE, every symbol that occurs keeps at least 1
+    static void buildFrequencies(const std::vector<uint8_t>& in, uint32_t* freq) {
+        uint64_t counts[256] = {};
+        for (uint8_t s : in) { counts[s]++; }
+
+        uint32_t total = 0;
+        for (uint32_t s = 0; s < 256; s++) {
+            freq[s] = counts[s] ? std::max<uint32_t>(1, static_cast<uint32_t>(counts[s] * PROB_SCALE / in.size())) : 0;
+            total += freq[s];
+        }
+        // hand the rounding error to (or take it from) the most frequent symbols
+        while (total != PROB_SCALE) {
+            uint32_t largest = static_cast<uint32_t>(std::max_element(freq, freq + 256) - freq);
+            if (total < PROB_SCALE) {
+                freq[largest] += PROB_SCALE - total;
+                total = PROB_SCALE;
+            }
+            else {
+                // can't reach 1: at most 256 symbols are bumped up to 1, far below PROB_SCALE
+                uint32_t take = std::min(total - PROB_SCALE, freq[largest] - 1);
+                freq[largest] -= take;
+                total -= take;
+            }
+        }
+    }
+
+    static void buildCumulative(const uint32_t* freq, uint32_t* cum) {
+        cum[0] = 0;
+        for (uint32_t s = 0; s < 256; s++) { cum[s + 1] = cum[s] + freq[s]; }
+    }
+};
+
+// quantize + delta + zigzag/varint + rANS, keeps the previous frame for temporal deltas
+class CacheFrameCodec {
+public:
+    enum Mode : uint8_t { MODE_VARINT = 0, MODE_RANS = 1 };
+
+    void reset(uint32_t particles, float quantizationStep) {
+        particleCount = particles;
+        quantization = quantizationStep;
+        previous.assign(size_t(particles) * 3, 0);
+    }
+
+    // xyz holds particleCount x values, then y, then z
+    void encode(const float* xyz, bool keyframe, std::vector<uint8_t>& out) {
+        const float scale = 1.0f / quantization;
+
+        stream.clear();
+        for (size_t component = 0; component < 3; component++) {
+            int32_t last = 0;
+            for (size_t i = component * particleCount; i < (component + 1) * particleCount; i++) {
+                int32_t q = static_cast<int32_t>(std::lround(xyz[i] * scale));
+                int32_t delta = keyframe ? q - last : q - previous[i];
+                last = q;
+                previous[i] = q;
+                RansCoder::writeVarint(stream, zigzag(delta));
+            }
+        }
+
+        out.clear();
+        out.push_back(MODE_RANS);
+        RansCoder::writeVarint(out, static_cast<uint32_t>(stream.size()));
+        size_t prefix = out.size();
+        if (!stream.empty()) {
+            RansCoder::encode(stream, out, scratch);
+        }
+        // small or noisy frames can come out bigger with the frequency table, store them plain
+        if (out.size() - prefix >= stream.size()) {
+            out[0] = MODE_VARINT;
+            out.resize(prefix);
+            out.insert(out.end(), stream.begin(), stream.end());
+        }
+    }
+
+    // frames that aren't keyframes need the frame before them to have been decoded by this codec
+    void decode(const uint8_t* data, size_t bytes, bool keyframe, float* xyz) {
+        const uint8_t* p = data;
+        const uint8_t* end = data + bytes;
+        if (p >= end) { throw std::runtime_error("failed to decode cache frame, empty frame!"); }
+        uint8_t mode = *p++;
+        uint32_t streamBytes = RansCoder::readVarint(p, end);
+
+        const uint8_t* s;
+        const uint8_t* sEnd;
+        if (mode == MODE_RANS) {
+            RansCoder::decode(p, end, streamBytes, stream);
+            s = stream.data();
+            sEnd = s + stream.size();
+        }
+        else if (mode == MODE_VARINT) {
+            if (size_t(end - p) < streamBytes) { throw std::runtime_error("failed to decode cache frame, truncated data!"); }
+            s = p;
+            sEnd = p + streamBytes;
+        }
+        else {
+            throw std::runtime_error("failed to decode cache frame, unknown mode!");
+        }
+
+        for (size_t component = 0; component < 3; component++) {
+            int32_t last = 0;
+            for (size_t i = component * particleCount; i < (component + 1) * particleCount; i++) {
+                int32_t delta = unzigzag(RansCoder::readVarint(s, sEnd));
+                int32_t q = keyframe ? last + delta : previous[i] + delta;
+                last = q;
+                previous[i] = q;
+                xyz[i] = q * quantization;
+            }
+        }
+    }
+
+    static uint32_t zigzag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+    static int32_t unzigzag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+private:
+    uint32_t particleCount = 0;
+    float quantization = 1e-4f;
+    std::vector<int32_t> previous; // quantized positions of the last encoded/decoded frame
+    std::vector<uint8_t> stream;   // varint bytes
+    std::vector<uint8_t> scratch;  // reversed rANS output
+};
+
+// Streams frames to disk on its own thread. addFrame() only copies the positions into a pooled buffer and
+// queues it, the solver never waits on encoding or IO (the pool grows instead if the writer falls behind).
+class CacheWriter {
+public:
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t rawBytes = 0;     // what float xyz would have taken
+        uint64_t encodedBytes = 0; // frame data only, without header and index
+        uint64_t fileBytes = 0;
+        int64_t encodeNs = 0;
+        int64_t writeNs = 0;
+        size_t maxQueued = 0;      // deepest the queue got, > a few means the writer can't keep up
+        size_t buffers = 0;        // frame buffers allocated by the pool
+
+        double bytesPerFrame() const { return frames ? double(encodedBytes) / frames : 0.0; }
+        double ratio() const { return encodedBytes ? double(rawBytes) / encodedBytes : 0.0; }
+    };
+
+    ~CacheWriter() {
+        if (thread.joinable()) {
+            try { close(); }
+            catch (...) {}
+        }
+    }
+
+    void open(const std::string& filename, uint32_t particleCount, float frameTime, const CacheSettings& cacheSettings = {}) {
+        if (thread.joinable()) {
+            throw std::runtime_error("cache writer is already open!");
+        }
+        file.open(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open cache file!");
+        }
+
+        settings = cacheSettings;
+        settings.keyframeInterval = std::max(1u, settings.keyframeInterval);
+        header = CacheHeader{};
+        header.particleCount = particleCount;
+        header.keyframeInterval = settings.keyframeInterval;
+        header.quantization = settings.quantization;
+        header.frameTime = frameTime;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        codec.reset(particleCount, settings.quantization);
+        index.clear();
+        offset = sizeof(header);
+        stats = Stats{};
+        stopping = false;
+        failure = nullptr;
+        thread = std::thread([this] { writerLoop(); });
+    }
+
+    void addFrame(const ParticleStore& particles) {
+        PROFILE_ZONE("CacheWriter::addFrame");
+        const size_t n = header.particleCount;
+        if (particles.size() != n) {
+            throw std::runtime_error("cache frame has the wrong particle count!");
+        }
+
+        std::vector<float> buffer;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeBuffers.empty()) {
+                buffer.swap(freeBuffers.back());
+                freeBuffers.pop_back();
+            }
+            else {
+                stats.buffers++;
+            }
+        }
+        buffer.resize(n * 3);
+        std::copy(particles.x.begin(), particles.x.end(), buffer.begin());
+        std::copy(particles.y.begin(), particles.y.end(), buffer.begin() + n);
+        std::copy(particles.z.begin(), particles.z.end(), buffer.begin() + 2 * n);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(buffer));
+            stats.maxQueued = std::max(stats.maxQueued, queue.size());
+        }
+        wake.notify_one();
+    }
+
+    // drains the queue, writes the index and patches the header; rethrows a failure from the writer thread
+    void close() {
+        if (!thread.joinable()) { return; }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+
+        if (!failure) {
+            header.frameCount = static_cast<uint32_t>(index.size());
+            header.indexOffset = offset;
+            file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(CacheIndexEntry));
+            file.seekp(0);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            stats.fileBytes = offset + index.size() * sizeof(CacheIndexEntry);
+            if (!file) {
+                failure = std::make_exception_ptr(std::runtime_error("failed to write cache index!"));
+            }
+        }
+        file.close();
+
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    // safe to read after close()
+    const Stats& getStats() const { return stats; }
+
+private:
+    CacheSettings settings;
+    CacheHeader header;
+    CacheFrameCodec codec;
+    std::vector<CacheIndexEntry> index;
+    std::ofstream file;
+    uint64_t offset = 0;
+    Stats stats;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::vector<float>> queue;
+    std::vector<std::vector<float>> freeBuffers;
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    void writerLoop() {
+        std::vector<uint8_t> encoded;
+        while (true) {
+            std::vector<float> buffer;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (queue.empty()) { return; }
+                buffer = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            if (!failure) {
+                try {
+                    writeFrame(buffer, encoded);
+                }
+                catch (...) {
+                    failure = std::current_exception();
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBuffers.push_back(std::move(buffer));
+        }
+    }
+
+    void writeFrame(const std::vector<float>& xyz, std::vector<uint8_t>& encoded) {
+        PROFILE_ZONE("CacheWriter::writeFrame");
+        bool keyframe = index.size() % settings.keyframeInterval == 0;
+
+        int64_t t0 = CpuProfiler::nowNs();
+        codec.encode(xyz.data(), keyframe, encoded);
+        int64_t t1 = CpuProfiler::nowNs();
+        file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        if (!file) {
+            throw std::runtime_error("failed to write cache frame!");
+        }
+        int64_t t2 = CpuProfiler::nowNs();
+
+        index.push_back({ offset, static_cast<uint32_t>(encoded.size()), keyframe ? 1u : 0u });
+        offset += encoded.size();
+
+        // only this thread touches these until close() has joined it
+        stats.frames++;
+        stats.rawBytes += xyz.size() * sizeof(float);
+        stats.encodedBytes += encoded.size();
+        stats.encodeNs += t1 - t0;
+        stats.writeNs += t2 - t1;
+    }
+};
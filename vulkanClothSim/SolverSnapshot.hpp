@@ -0,0 +1,204 @@
+#pragma once
+#include "ClothSolver.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Solver state snapshots
+// Captures everything that evolves while simulating (positions, velocities, inverse masses, XPBD
+// multipliers, contact cache, step count) into one flat binary blob, so a settled drape can be restored and forked into
+// many parameter variations (ClothSolver::applyParams) without simulating the settling phase again.
+// Topology, rest lengths and colliders are not stored: a snapshot restores onto a solver built from the
+// same mesh, checked with ClothSolver::topologyHash.
+//
+// layout: Header, then sections of { tag, size in bytes, raw data }. Unknown tags are skipped on restore,
+// so later state (collision caches...) can be added as new sections without breaking old files.
+
+struct SolverSnapshot {
+    std::vector<uint8_t> data;
+
+    size_t size() const { return data.size(); }
+    bool empty() const { return data.empty(); }
+
+    // format details, used by the functions below
+    static const uint32_t MAGIC = 0x504e5343; // "CSNP"
+    static const uint32_t VERSION = 1;
+
+    enum Section : uint32_t {
+        SECTION_POSITIONS = 1,  // x, y, z
+        SECTION_VELOCITIES = 2, // vx, vy, vz
+        SECTION_INV_MASS = 3,
+        SECTION_LAMBDAS = 4,    // stretch then bend
+        SECTION_CONTACT_FEATURES = 5, // ContactCache collider, feature
+        SECTION_CONTACT_ANCHORS = 6,  // ContactCache anchor x, y, z
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t topologyHash;
+        uint64_t particleCount;
+        uint64_t stretchCount;
+        uint64_t bendCount;
+        uint64_t steps;
+    };
+
+    struct SectionHeader {
+        uint32_t tag;
+        uint32_t reserved;
+        uint64_t bytes;
+    };
+
+    class Writer {
+    public:
+        explicit Writer(std::vector<uint8_t>& target) : out(target) { out.clear(); }
+
+        void raw(const void* src, size_t bytes) {
+            size_t offset = out.size();
+            out.resize(offset + bytes);
+            if (bytes) { std::memcpy(out.data() + offset, src, bytes); }
+        }
+
+        // one section made of several arrays of the same type back to back
+        template <typename T>
+        void section(uint32_t tag, std::initializer_list<const std::vector<T>*> arrays) {
+            SectionHeader header{ tag, 0, 0 };
+            for (const auto* a : arrays) { header.bytes += a->size() * sizeof(T); }
+            raw(&header, sizeof(header));
+            for (const auto* a : arrays) { raw(a->data(), a->size() * sizeof(T)); }
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+    };
+
+    class Reader {
+    public:
+        Reader(const uint8_t* begin, size_t size) : p(begin), end(begin + size) {}
+
+        void raw(void* dst, size_t bytes) {
+            if (size_t(end - p) < bytes) {
+                throw std::runtime_error("failed to restore snapshot, data is truncated!");
+            }
+            if (bytes) { std::memcpy(dst, p, bytes); }
+            p += bytes;
+        }
+
+        void skip(uint64_t bytes) {
+            if (uint64_t(end - p) < bytes) {
+                throw std::runtime_error("failed to restore snapshot, data is truncated!");
+            }
+            p += bytes;
+        }
+
+        // fills arrays that were sized by the caller, the section has to match their total size exactly
+        template <typename T>
+        void arrays(const SectionHeader& header, std::initializer_list<std::vector<T>*> arrays) {
+            uint64_t expected = 0;
+            for (auto* a : arrays) { expected += a->size() * sizeof(T); }
+            if (expected != header.bytes) {
+                throw std::runtime_error("failed to restore snapshot, section size mismatch!");
+            }
+            for (auto* a : arrays) { raw(a->data(), a->size() * sizeof(T)); }
+        }
+
+        bool done() const { return p == end; }
+
+    private:
+        const uint8_t* p;
+        const uint8_t* end;
+    };
+};
+
+// `out` keeps its capacity, capturing into the same snapshot repeatedly doesn't allocate
+inline void captureSnapshot(const ClothSolver& solver, SolverSnapshot& out) {
+    using S = SolverSnapshot;
+    PROFILE_ZONE("captureSnapshot");
+    const ParticleStore& p = solver.particles;
+
+    S::Writer writer(out.data);
+    S::Header header{ S::MAGIC, S::VERSION, solver.topologyHash, p.size(), solver.stretch.size(), solver.bend.size(), solver.stats.steps };
+    writer.raw(&header, sizeof(header));
+    writer.section(S::SECTION_POSITIONS, { &p.x, &p.y, &p.z });
+    writer.section(S::SECTION_VELOCITIES, { &p.vx, &p.vy, &p.vz });
+    writer.section(S::SECTION_INV_MASS, { &p.invMass });
+    writer.section(S::SECTION_LAMBDAS, { &solver.stretch.lambda, &solver.bend.lambda });
+    const ContactCache& c = solver.contacts;
+    writer.section(S::SECTION_CONTACT_FEATURES, { &c.collider, &c.feature });
+    writer.section(S::SECTION_CONTACT_ANCHORS, { &c.ax, &c.ay, &c.az });
+}
+
+inline SolverSnapshot captureSnapshot(const ClothSolver& solver) {
+    SolverSnapshot snapshot;
+    captureSnapshot(solver, snapshot);
+    return snapshot;
+}
+
+// solver has to be built from the same mesh the snapshot was taken from; parameters are left alone
+inline void restoreSnapshot(ClothSolver& solver, const SolverSnapshot& snapshot) {
+    using S = SolverSnapshot;
+    PROFILE_ZONE("restoreSnapshot");
+    ParticleStore& p = solver.particles;
+
+    S::Reader reader(snapshot.data.data(), snapshot.data.size());
+    S::Header header;
+    reader.raw(&header, sizeof(header));
+    if (header.magic != S::MAGIC || header.version > S::VERSION) {
+        throw std::runtime_error("failed to restore snapshot, unknown format!");
+    }
+    if (header.topologyHash != solver.topologyHash || header.particleCount != p.size() ||
+        header.stretchCount != solver.stretch.size() || header.bendCount != solver.bend.size()) {
+        throw std::runtime_error("failed to restore snapshot, solver was built from a different mesh!");
+    }
+
+    // snapshots from before the contact cache existed restore with an empty one
+    ContactCache& c = solver.contacts;
+    c.clear();
+
+    while (!reader.done()) {
+        S::SectionHeader section;
+        reader.raw(&section, sizeof(section));
+        switch (section.tag) {
+        case S::SECTION_POSITIONS: reader.arrays(section, { &p.x, &p.y, &p.z }); break;
+        case S::SECTION_VELOCITIES: reader.arrays(section, { &p.vx, &p.vy, &p.vz }); break;
+        case S::SECTION_INV_MASS: reader.arrays(section, { &p.invMass }); break;
+        case S::SECTION_LAMBDAS: reader.arrays(section, { &solver.stretch.lambda, &solver.bend.lambda }); break;
+        case S::SECTION_CONTACT_FEATURES: reader.arrays(section, { &c.collider, &c.feature }); break;
+        case S::SECTION_CONTACT_ANCHORS: reader.arrays(section, { &c.ax, &c.ay, &c.az }); break;
+        default: reader.skip(section.bytes); break;
+        }
+    }
+
+    // previous positions are overwritten by the next integrate, keep them consistent anyway
+    p.px = p.x;
+    p.py = p.y;
+    p.pz = p.z;
+    solver.stats.reset();
+    solver.stats.steps = header.steps;
+}
+
+inline void saveSnapshot(const SolverSnapshot& snapshot, const std::string& filename) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open snapshot file for writing!");
+    }
+    file.write(reinterpret_cast<const char*>(snapshot.data.data()), snapshot.data.size());
+}
+
+inline SolverSnapshot loadSnapshot(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open snapshot file!");
+    }
+
+    SolverSnapshot snapshot;
+    snapshot.data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(snapshot.data.data()), snapshot.data.size());
+    return snapshot;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "CpuProfiler.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Startup time breakdown
+// Times every stage of initVulkan() (plus anything nested inside, e.g. texture decode vs upload) relative
+// to the moment start() was called, and writes the result as JSON so cold start changes can be compared.
+// Stages may run on any thread; each stage also shows up as a zone in the CPU trace.
+
+class StartupTracer {
+public:
+    struct Stage {
+        std::string name;
+        int64_t startNs = 0;
+        int64_t endNs = 0;
+        uint32_t thread = 0;
+        uint32_t depth = 0;   // nesting level on its thread
+        uint64_t bytes = 0;   // optional payload size (file size, upload size...)
+    };
+
+    class Scope {
+    public:
+        Scope(StartupTracer& owner, const char* name) : tracer(owner), zone(name) {
+            index = tracer.open(name);
+        }
+        ~Scope() { tracer.close(index); }
+
+        void setBytes(uint64_t bytes) { tracer.setBytes(index, bytes); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StartupTracer& tracer;
+        CpuZone zone;
+        size_t index;
+    };
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stages.clear();
+        originNs = CpuProfiler::nowNs();
+    }
+
+    // times a single call, the usual way to wrap the create* functions
+    void run(const char* name, const std::function<void()>& fn) {
+        Scope scope(*this, name);
+        fn();
+    }
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishNs = CpuProfiler::nowNs();
+    }
+
+    double totalMs() const { return (finishNs - originNs) * 1e-6; }
+
+    const std::vector<Stage>& getStages() const { return stages; }
+
+    void writeJson(const std::string& filename) const {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open startup report file!");
+        }
+
+        char line[512];
+        std::snprintf(line, sizeof(line), "{\n  \"totalMs\": %.3f,\n  \"stages\": [\n", totalMs());
+        file << line;
+        for (size_t i = 0; i < stages.size(); i++) {
+            const Stage& s = stages[i];
+            std::snprintf(line, sizeof(line),
+                "    {\"name\": \"%s\", \"startMs\": %.3f, \"durationMs\": %.3f, \"thread\": %u, \"depth\": %u, \"bytes\": %llu}%s\n",
+                s.name.c_str(), (s.startNs - originNs) * 1e-6, (s.endNs - s.startNs) * 1e-6, s.thread, s.depth,
+                static_cast<unsigned long long>(s.bytes), i + 1 < stages.size() ? "," : "");
+            file << line;
+        }
+        file << "  ]\n}\n";
+    }
+
+    void print(std::ostream& out) const {
+        out << "startup stages (ms)              start  duration  thread\n";
+        for (const Stage& s : stages) {
+            out << std::left << std::setw(28) << (std::string(s.depth * 2, ' ') + s.name) << std::right << std::fixed
+                << std::setprecision(3) << std::setw(10) << (s.startNs - originNs) * 1e-6
+                << std::setw(10) << (s.endNs - s.startNs) * 1e-6 << std::setw(8) << s.thread << "\n";
+        }
+        out << "total startup: " << std::fixed << std::setprecision(3) << totalMs() << " ms\n";
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<Stage> stages;
+    std::unordered_map<std::thread::id, uint32_t> threadIds; // small stable ids for the report
+    std::unordered_map<std::thread::id, uint32_t> openDepth;
+    int64_t originNs = CpuProfiler::nowNs();
+    int64_t finishNs = 0;
+
+    size_t open(const char* name) {
+        int64_t now = CpuProfiler::nowNs();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto id = std::this_thread::get_id();
+        auto it = threadIds.find(id);
+        if (it == threadIds.end()) {
+            it = threadIds.emplace(id, static_cast<uint32_t>(threadIds.size())).first;
+        }
+
+        Stage stage;
+        stage.name = name;
+        stage.startNs = now;
+        stage.thread = it->second;
+        stage.depth = openDepth[id]++;
+        stages.push_back(stage);
+        return stages.size() - 1;
+    }
+
+    void close(size_t index) {
+        int64_t now = CpuProfiler::nowNs();
+        std::lock_guard<std::mutex> lock(mutex);
+        stages[index].endNs = now;
+        openDepth[std::this_thread::get_id()]--;
+    }
+
+    void setBytes(size_t index, uint64_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stages[index].bytes = bytes;
+    }
+};
@@ -0,0 +1,609 @@
+#pragma once
+#include "ClothSweep.hpp"
+#include "CpuProfiler.hpp"
+#include "SolverSnapshot.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Distributed sweeps
+// A coordinator process owns the sweep and hands its runs out to any number of worker processes that
+// connect over TCP (127.0.0.1 to use one box, any reachable address to span machines).
+//   - leasing: a worker leases one run at a time. A lease goes back to the queue when its worker
+//     disconnects or doesn't report within leaseSeconds, so a crashed or hung worker only costs its run.
+//   - results are appended to a checkpoint file as they arrive; restarting the coordinator with the same
+//     spec and checkpoint only runs what is missing.
+//   - the coordinator builds and settles the scene once. Workers receive the spec text and the settled
+//     start snapshot, build the scene themselves through the binary mesh cache (MeshCache.hpp), and after
+//     that every run only costs a snapshot restore.
+//
+// protocol, one text line per message (SPEC and START are followed by <bytes> of payload):
+//   coordinator -> worker   SPEC <bytes>, START <bytes>, RUN <run>, WAIT <ms>, DONE
+//   worker -> coordinator   LEASE, RESULT <run> <metrics as in the checkpoint>
+
+// TCP socket with a small receive buffer for line based messages. Blocking by default (workers); the
+// coordinator makes its client sockets non-blocking and queues what it sends, see queue()/flush().
+class SweepSocket {
+public:
+#ifdef _WIN32
+    typedef SOCKET Handle;
+    static constexpr Handle INVALID = INVALID_SOCKET;
+#else
+    typedef int Handle;
+    static constexpr Handle INVALID = -1;
+#endif
+
+    SweepSocket() = default;
+    explicit SweepSocket(Handle h) : handle(h) {}
+    ~SweepSocket() { close(); }
+
+    SweepSocket(SweepSocket&& other) noexcept
+        : handle(other.handle), inbox(std::move(other.inbox)), outbox(std::move(other.outbox)), outboxSent(other.outboxSent) {
+        other.handle = INVALID;
+    }
+    SweepSocket& operator=(SweepSocket&& other) noexcept {
+        if (this != &other) {
+            close();
+            handle = other.handle;
+            inbox = std::move(other.inbox);
+            outbox = std::move(other.outbox);
+            outboxSent = other.outboxSent;
+            other.handle = INVALID;
+        }
+        return *this;
+    }
+
+    // addresses are "host:port" or just "port" (= 127.0.0.1)
+    static SweepSocket listen(const std::string& address) {
+        addrinfo* info = resolve(address, true);
+        SweepSocket s(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+        int yes = 1;
+        setsockopt(s.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+        bool ok = s.valid() && ::bind(s.handle, info->ai_addr, static_cast<int>(info->ai_addrlen)) == 0 && ::listen(s.handle, 64) == 0;
+        freeaddrinfo(info);
+        if (!ok) {
+            throw std::runtime_error("failed to listen on " + address + "!");
+        }
+        return s;
+    }
+
+    // invalid socket if nobody is listening (yet)
+    static SweepSocket connect(const std::string& address) {
+        addrinfo* info = resolve(address, false);
+        SweepSocket s(::socket(info->ai_family, info->ai_socktype, info->ai_protocol));
+        if (s.valid() && ::connect(s.handle, info->ai_addr, static_cast<int>(info->ai_addrlen)) != 0) {
+            s.close();
+        }
+        freeaddrinfo(info);
+        if (s.valid()) { s.setNoDelay(); }
+        return s;
+    }
+
+    SweepSocket accept() {
+        SweepSocket s(::accept(handle, nullptr, nullptr));
+        if (s.valid()) { s.setNoDelay(); }
+        return s;
+    }
+
+    bool send(const std::string& message) { return send(message.data(), message.size()); }
+
+    bool send(const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            int chunk = static_cast<int>(std::min<size_t>(bytes, 1 << 20));
+            auto sent = ::send(handle, p, chunk, SEND_FLAGS);
+            if (sent <= 0) { return false; }
+            p += sent;
+            bytes -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    void setNonBlocking() {
+#ifdef _WIN32
+        u_long yes = 1;
+        ioctlsocket(handle, FIONBIO, &yes);
+#else
+        fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    }
+
+    // non-blocking sending: queue() appends to the outbox, flush() sends as much of it as the socket takes
+    // right now (false once the peer is gone), the rest waits for the next flush when poll reports POLLOUT
+    void queue(const std::string& message) { outbox.append(message); }
+    bool wantsWrite() const { return outboxSent < outbox.size(); }
+
+    bool flush() {
+        while (outboxSent < outbox.size()) {
+            int chunk = static_cast<int>(std::min<size_t>(outbox.size() - outboxSent, 1 << 20));
+            auto sent = ::send(handle, outbox.data() + outboxSent, chunk, SEND_FLAGS);
+            if (sent < 0 && wouldBlock()) { break; }
+            if (sent <= 0) { return false; }
+            outboxSent += static_cast<size_t>(sent);
+        }
+        if (outboxSent == outbox.size()) {
+            outbox.clear();
+            outboxSent = 0;
+        }
+        return true;
+    }
+
+    // blocks until some data arrives (on a blocking socket), false once the peer closed the connection
+    bool receive() {
+        char buffer[4096];
+        auto received = ::recv(handle, buffer, sizeof(buffer), 0);
+        if (received <= 0) { return false; }
+        inbox.append(buffer, static_cast<size_t>(received));
+        return true;
+    }
+
+    // next complete line already received (without the '\n')
+    bool popLine(std::string& line) {
+        size_t end = inbox.find('\n');
+        if (end == std::string::npos) { return false; }
+        line.assign(inbox, 0, end);
+        inbox.erase(0, end + 1);
+        return true;
+    }
+
+    bool readLine(std::string& line) {
+        while (!popLine(line)) {
+            if (!receive()) { return false; }
+        }
+        return true;
+    }
+
+    bool readBytes(size_t bytes, std::string& out) {
+        while (inbox.size() < bytes) {
+            if (!receive()) { return false; }
+        }
+        out.assign(inbox, 0, bytes);
+        inbox.erase(0, bytes);
+        return true;
+    }
+
+    Handle get() const { return handle; }
+    bool valid() const { return handle != INVALID; }
+
+    void close() {
+        if (!valid()) { return; }
+#ifdef _WIN32
+        closesocket(handle);
+#else
+        ::close(handle);
+#endif
+        handle = INVALID;
+    }
+
+private:
+#ifdef MSG_NOSIGNAL
+    static const int SEND_FLAGS = MSG_NOSIGNAL; // a dead peer is a failed send, not SIGPIPE
+#else
+    static const int SEND_FLAGS = 0;
+#endif
+
+    Handle handle = INVALID;
+    std::string inbox;
+    std::string outbox;
+    size_t outboxSent = 0; // bytes at the front of outbox already sent
+
+    static bool wouldBlock() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+
+    void setNoDelay() {
+        // messages are tiny request/response pairs, don't let Nagle hold them back
+        int yes = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&yes), sizeof(yes));
+    }
+
+    static addrinfo* resolve(const std::string& address, bool passive) {
+#ifdef _WIN32
+        static const bool started = [] {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        if (!started) {
+            throw std::runtime_error("failed to initialize winsock!");
+        }
+#endif
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr(0, colon);
+        std::string port = colon == std::string::npos ? address : address.substr(colon + 1);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        addrinfo* info = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0 || info == nullptr) {
+            throw std::runtime_error("failed to resolve sweep address " + address + "!");
+        }
+        return info;
+    }
+};
+
+// one line per result, used by the checkpoint file and RESULT messages; doubles keep all their digits so
+// a resumed table is identical to an uninterrupted one
+inline std::string formatSweepResult(size_t run, const SweepResult& r) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%zu %.17g %.17g %.9g %.17g %016llx", run, r.kineticEnergy, r.stretchError,
+        r.lowestY, r.seconds, static_cast<unsigned long long>(r.checksum));
+    return line;
+}
+
+inline bool parseSweepResult(const std::string& line, size_t& run, SweepResult& r) {
+    unsigned long long checksum = 0;
+    if (std::sscanf(line.c_str(), "%zu %lf %lf %f %lf %llx", &run, &r.kineticEnergy, &r.stretchError, &r.lowestY,
+        &r.seconds, &checksum) != 6) {
+        return false;
+    }
+    r.checksum = checksum;
+    return true;
+}
+
+struct SweepCoordinatorSettings {
+    std::string address = "7700";
+    std::string checkpointFile; // empty = no checkpoint, nothing to resume from
+    double leaseSeconds = 600.0;
+};
+
+class SweepCoordinator {
+public:
+    // serves every run of `spec` (parsed from specText) until all of them have a result
+    std::vector<SweepResult> run(const SweepSpec& spec, const std::string& specText, const SweepCoordinatorSettings& coordinatorSettings, SweepStats& sweepStats) {
+        PROFILE_ZONE("SweepCoordinator::run");
+        settings = coordinatorSettings;
+        runs = spec.runCount();
+        results.assign(runs, SweepResult{});
+        state.assign(runs, PENDING);
+        finished = 0;
+        sweepStats = SweepStats{};
+        sweepStats.runs = runs;
+
+        int64_t setupStart = CpuProfiler::nowNs();
+        openCheckpoint(specText);
+        sweepStats.runs = runs - finished; // throughput only counts what this session runs
+        pending.clear();
+        for (size_t r = 0; r < runs; r++) {
+            if (state[r] == PENDING) { pending.push_back(r); }
+        }
+        if (finished == runs) {
+            closeCheckpoint();
+            return results;
+        }
+
+        // one settle here instead of one per worker; also fills the mesh cache for the workers
+        ClothSolver base;
+        SolverSnapshot start;
+        prepareSweep(spec, base, start);
+        hello = "SPEC " + std::to_string(specText.size()) + "\n" + specText +
+            "START " + std::to_string(start.size()) + "\n" + std::string(start.data.begin(), start.data.end());
+
+        listener = SweepSocket::listen(settings.address);
+        sweepStats.setupSeconds = (CpuProfiler::nowNs() - setupStart) * 1e-9;
+        int64_t runStart = CpuProfiler::nowNs();
+        try {
+            serve(sweepStats);
+        }
+        catch (...) {
+            shutdown();
+            throw;
+        }
+        shutdown();
+        sweepStats.seconds = (CpuProfiler::nowNs() - runStart) * 1e-9;
+        return results;
+    }
+
+private:
+    enum RunState : uint8_t { PENDING, LEASED, FINISHED };
+
+    struct Lease {
+        size_t run;
+        int64_t deadlineNs;
+    };
+
+    struct Client {
+        SweepSocket socket;
+        std::vector<Lease> leases;
+    };
+
+    SweepCoordinatorSettings settings;
+    size_t runs = 0;
+    size_t finished = 0;
+    std::vector<SweepResult> results;
+    std::vector<RunState> state;
+    std::deque<size_t> pending;
+    std::string hello; // SPEC + START, queued for every new worker
+    SweepSocket listener;
+    std::vector<Client> clients;
+    std::FILE* checkpoint = nullptr;
+
+    void serve(SweepStats& sweepStats) {
+#ifdef _WIN32
+        typedef WSAPOLLFD PollFd;
+#else
+        typedef pollfd PollFd;
+#endif
+        std::vector<PollFd> fds;
+        while (finished < runs) {
+            fds.assign(clients.size() + 1, PollFd{});
+            fds[0].fd = listener.get();
+            fds[0].events = POLLIN;
+            for (size_t c = 0; c < clients.size(); c++) {
+                fds[c + 1].fd = clients[c].socket.get();
+                fds[c + 1].events = POLLIN | (clients[c].socket.wantsWrite() ? POLLOUT : 0);
+            }
+#ifdef _WIN32
+            WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), 1000);
+#else
+            ::poll(fds.data(), fds.size(), 1000);
+#endif
+
+            // clients first, accepting appends to `clients` and fds only covers the ones polled. Nothing here
+            // blocks on a client: replies and the multi MB hello go out as fast as each worker takes them, so a
+            // slow one can't hold up leases, results and accepts for the others.
+            for (size_t c = clients.size(); c-- > 0;) {
+                const auto revents = fds[c + 1].revents;
+                bool ok = true;
+                if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                    ok = clients[c].socket.receive() && handleMessages(clients[c]);
+                }
+                if (ok && (revents & (POLLIN | POLLOUT))) {
+                    ok = clients[c].socket.flush();
+                }
+                if (!ok) {
+                    dropClient(c);
+                }
+            }
+
+            if (fds[0].revents & POLLIN) {
+                Client client;
+                client.socket = listener.accept();
+                if (client.socket.valid()) {
+                    client.socket.setNonBlocking();
+                    client.socket.queue(hello);
+                }
+                if (client.socket.valid() && client.socket.flush()) {
+                    clients.push_back(std::move(client));
+                    sweepStats.workers = std::max(sweepStats.workers, static_cast<uint32_t>(clients.size()));
+                }
+            }
+
+            expireLeases();
+        }
+    }
+
+    // false = protocol error, drop the worker
+    bool handleMessages(Client& client) {
+        std::string line;
+        while (client.socket.popLine(line)) {
+            if (line == "LEASE") {
+                client.socket.queue(lease(client));
+            }
+            else if (line.rfind("RESULT ", 0) == 0) {
+                size_t run;
+                SweepResult result;
+                if (!parseSweepResult(line.substr(7), run, result) || run >= runs) { return false; }
+                for (size_t l = 0; l < client.leases.size(); l++) {
+                    if (client.leases[l].run == run) {
+                        client.leases.erase(client.leases.begin() + l);
+                        break;
+                    }
+                }
+                // a run whose lease expired can come back twice, the first result wins
+                if (state[run] != FINISHED) {
+                    finish(run, result);
+                }
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string lease(Client& client) {
+        while (!pending.empty()) {
+            size_t run = pending.front();
+            pending.pop_front();
+            if (state[run] == FINISHED) { continue; }
+            state[run] = LEASED;
+            client.leases.push_back({ run, CpuProfiler::nowNs() + static_cast<int64_t>(settings.leaseSeconds * 1e9) });
+            return "RUN " + std::to_string(run) + "\n";
+        }
+        // everything is leased: ask again later, a lease may still come back
+        return finished == runs ? "DONE\n" : "WAIT 200\n";
+    }
+
+    void finish(size_t run, const SweepResult& result) {
+        results[run] = result;
+        state[run] = FINISHED;
+        finished++;
+        if (checkpoint) {
+            std::fprintf(checkpoint, "%s\n", formatSweepResult(run, result).c_str());
+            std::fflush(checkpoint);
+        }
+    }
+
+    void requeue(size_t run) {
+        if (state[run] == LEASED) {
+            state[run] = PENDING;
+            pending.push_front(run);
+        }
+    }
+
+    void dropClient(size_t c) {
+        for (const Lease& l : clients[c].leases) { requeue(l.run); }
+        clients.erase(clients.begin() + c);
+    }
+
+    void expireLeases() {
+        int64_t now = CpuProfiler::nowNs();
+        for (auto& client : clients) {
+            for (size_t l = client.leases.size(); l-- > 0;) {
+                if (client.leases[l].deadlineNs < now) {
+                    requeue(client.leases[l].run);
+                    client.leases.erase(client.leases.begin() + l);
+                }
+            }
+        }
+    }
+
+    void shutdown() {
+        // best effort: a worker that doesn't get DONE sees the connection close and stops all the same
+        for (auto& client : clients) {
+            client.socket.queue("DONE\n");
+            client.socket.flush();
+        }
+        clients.clear();
+        listener.close();
+        closeCheckpoint();
+    }
+
+    // header line identifies the spec, then one formatSweepResult line per finished run
+    void openCheckpoint(const std::string& specText) {
+        if (settings.checkpointFile.empty()) { return; }
+        char header[128];
+        std::snprintf(header, sizeof(header), "clothSweep checkpoint %016llx %zu",
+            static_cast<unsigned long long>(ClothSolver::fnv1a(ClothSolver::FNV_OFFSET, specText.data(), specText.size())), runs);
+
+        if (std::filesystem::exists(settings.checkpointFile)) {
+            std::ifstream in(settings.checkpointFile);
+            std::string line;
+            std::getline(in, line);
+            if (line != header) {
+                throw std::runtime_error("checkpoint " + settings.checkpointFile + " belongs to a different sweep spec!");
+            }
+            while (std::getline(in, line)) {
+                size_t run;
+                SweepResult result;
+                // a torn last line from a crash just gets run again
+                if (parseSweepResult(line, run, result) && run < runs && state[run] != FINISHED) {
+                    results[run] = result;
+                    state[run] = FINISHED;
+                    finished++;
+                }
+            }
+            checkpoint = std::fopen(settings.checkpointFile.c_str(), "a");
+        }
+        else {
+            checkpoint = std::fopen(settings.checkpointFile.c_str(), "w");
+            if (checkpoint) { std::fprintf(checkpoint, "%s\n", header); }
+        }
+        if (checkpoint == nullptr) {
+            throw std::runtime_error("failed to open checkpoint " + settings.checkpointFile + "!");
+        }
+        std::fflush(checkpoint);
+    }
+
+    void closeCheckpoint() {
+        if (checkpoint) { std::fclose(checkpoint); }
+        checkpoint = nullptr;
+    }
+};
+
+struct SweepWorkerSettings {
+    std::string address = "7700";
+    std::string resourceDir;      // overrides the spec's scene options when set
+    std::string meshCacheDir;
+    double connectSeconds = 30.0; // workers may start before the coordinator
+};
+
+struct SweepWorkerStats {
+    size_t runs = 0;
+    double setupSeconds = 0.0; // connect + scene build
+    double seconds = 0.0;
+};
+
+// leases and runs tasks until the coordinator is done or goes away
+inline SweepWorkerStats runSweepWorker(const SweepWorkerSettings& settings) {
+    PROFILE_ZONE("runSweepWorker");
+    SweepWorkerStats stats;
+    int64_t start = CpuProfiler::nowNs();
+
+    SweepSocket socket;
+    while (!(socket = SweepSocket::connect(settings.address)).valid()) {
+        if ((CpuProfiler::nowNs() - start) * 1e-9 > settings.connectSeconds) {
+            throw std::runtime_error("failed to connect to sweep coordinator " + settings.address + "!");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    std::string line, specText, snapshotBytes;
+    size_t bytes = 0;
+    bool ok = socket.readLine(line) && std::sscanf(line.c_str(), "SPEC %zu", &bytes) == 1 && socket.readBytes(bytes, specText) &&
+        socket.readLine(line) && std::sscanf(line.c_str(), "START %zu", &bytes) == 1 && socket.readBytes(bytes, snapshotBytes);
+    if (!ok) {
+        throw std::runtime_error("failed to receive the sweep from the coordinator!");
+    }
+
+    std::istringstream specStream(specText);
+    SweepSpec spec = parseSweepSpec(specStream);
+    if (!settings.resourceDir.empty()) { spec.sceneOptions.resourceDir = settings.resourceDir; }
+    spec.sceneOptions.meshCacheDir = settings.meshCacheDir;
+    SolverSnapshot startState;
+    startState.data.assign(snapshotBytes.begin(), snapshotBytes.end());
+
+    ClothSolver solver;
+    buildScene(spec.scene, spec.sceneOptions, solver);
+    restoreSnapshot(solver, startState); // checks that this worker built the same topology as the coordinator
+    stats.setupSeconds = (CpuProfiler::nowNs() - start) * 1e-9;
+
+    int64_t runStart = CpuProfiler::nowNs();
+    while (socket.send(std::string("LEASE\n")) && socket.readLine(line)) {
+        size_t run = 0;
+        unsigned waitMs = 0;
+        if (std::sscanf(line.c_str(), "RUN %zu", &run) == 1) {
+            SweepResult result = runSweepTask(spec, solver, startState, run);
+            stats.runs++;
+            if (!socket.send("RESULT " + formatSweepResult(run, result) + "\n")) { break; }
+        }
+        else if (std::sscanf(line.c_str(), "WAIT %u", &waitMs) == 1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+        }
+        else {
+            break; // DONE
+        }
+    }
+    stats.seconds = (CpuProfiler::nowNs() - runStart) * 1e-9;
+    return stats;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Wind for the aerodynamics pass (ClothSolver::applyAerodynamics)
+// Uniform wind is one velocity everywhere. Turbulent wind adds gusts from a tiling 3D noise texture that is
+// computed once at build time (hashed white noise, box blurred into smooth blobs, one vec3 per texel in
+// three float arrays) and sampled with trilinear filtering. The texture drifts along with the mean wind
+// (frozen turbulence), so gusts travel across a flag instead of flickering in place.
+// The noise comes from an integer hash, not <random>, so every platform builds the same texture.
+
+#include "ClothFloatPreciseBegin.hpp"
+
+struct WindSettings {
+    glm::vec3 velocity{ 0.0f }; // mean wind, m/s
+    float turbulence = 0.0f;    // gust strength relative to the mean wind speed, 0 = uniform wind
+    float gustSize = 1.0f;      // world size of one noise texture tile, m
+    uint32_t resolution = 32;   // texels per side of the noise texture, rounded up to a power of two
+    uint32_t seed = 1;
+};
+
+class WindField {
+public:
+    WindField() = default;
+    explicit WindField(const WindSettings& windSettings) { build(windSettings); }
+
+    void build(const WindSettings& windSettings) {
+        config = windSettings;
+        uint32_t n = 4;
+        while (n < config.resolution) { n *= 2; }
+        config.resolution = n;
+        mask = n - 1;
+        amplitude = config.turbulence * glm::length(config.velocity);
+        texels.clear();
+        if (amplitude == 0.0f) { return; }
+
+        const size_t count = size_t(n) * n * n;
+        texels.resize(count * 3);
+        std::vector<float> values(count), scratch(count);
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            for (size_t t = 0; t < count; t++) {
+                uint32_t h = hash(static_cast<uint32_t>(t) * 3 + axis + config.seed * 0x9e3779b9u);
+                values[t] = (h >> 8) * (2.0f / 16777216.0f) - 1.0f;
+            }
+            // two box blurs per axis, wrapping around so the texture tiles
+            for (int pass = 0; pass < 2; pass++) {
+                for (size_t stride : { size_t(1), size_t(n), size_t(n) * n }) {
+                    blur(values, scratch, stride, n);
+                }
+            }
+            // unit RMS, turbulence then directly scales the gust speed
+            double sum = 0.0;
+            for (float v : values) { sum += double(v) * v; }
+            float scale = sum > 0.0 ? static_cast<float>(amplitude / std::sqrt(sum / count)) : 0.0f;
+            for (size_t t = 0; t < count; t++) { texels[3 * t + axis] = values[t] * scale; }
+        }
+    }
+
+    const WindSettings& settings() const { return config; }
+
+    // wind velocity at p, `time` in seconds moves the gusts along the mean wind
+    glm::vec3 sample(const glm::vec3& p, float time) const {
+        if (texels.empty()) { return config.velocity; }
+
+        const float scale = config.resolution / config.gustSize;
+        size_t i0[3], i1[3];
+        float f[3];
+        for (int axis = 0; axis < 3; axis++) {
+            float q = (p[axis] - config.velocity[axis] * time) * scale;
+            int64_t i = static_cast<int64_t>(q); // floor without the libm call
+            i -= q < static_cast<float>(i) ? 1 : 0;
+            f[axis] = q - static_cast<float>(i);
+            i0[axis] = static_cast<size_t>(i & mask);
+            i1[axis] = static_cast<size_t>((i + 1) & mask);
+        }
+        const size_t n = config.resolution;
+        const size_t z0 = i0[2] * n * n, z1 = i1[2] * n * n, y0 = i0[1] * n, y1 = i1[1] * n;
+
+        // trilinear, texels are interleaved xyz so every corner is one 12 byte read
+        glm::vec3 gust;
+        for (int axis = 0; axis < 3; axis++) {
+            auto at = [&](size_t z, size_t y, size_t x) { return texels[3 * (z + y + x) + axis]; };
+            float c00 = at(z0, y0, i0[0]) + (at(z0, y0, i1[0]) - at(z0, y0, i0[0])) * f[0];
+            float c10 = at(z0, y1, i0[0]) + (at(z0, y1, i1[0]) - at(z0, y1, i0[0])) * f[0];
+            float c01 = at(z1, y0, i0[0]) + (at(z1, y0, i1[0]) - at(z1, y0, i0[0])) * f[0];
+            float c11 = at(z1, y1, i0[0]) + (at(z1, y1, i1[0]) - at(z1, y1, i0[0])) * f[0];
+            float c0 = c00 + (c10 - c00) * f[1];
+            float c1 = c01 + (c11 - c01) * f[1];
+            gust[axis] = c0 + (c1 - c0) * f[2];
+        }
+        return config.velocity + gust;
+    }
+
+    size_t memoryBytes() const { return texels.capacity() * sizeof(float); }
+
+private:
+    WindSettings config;
+    float amplitude = 0.0f;    // gust speed, m/s
+    int64_t mask = 0;          // resolution - 1
+    std::vector<float> texels; // gust velocity per texel, x y z interleaved, already scaled by amplitude
+
+    static uint32_t hash(uint32_t v) {
+        v ^= v >> 16;
+        v *= 0x7feb352du;
+        v ^= v >> 15;
+        v *= 0x846ca68bu;
+        v ^= v >> 16;
+        return v;
+    }
+
+    // 5 texel box filter along one axis (stride 1, n or n*n), wrapping at the texture edge
+    static void blur(std::vector<float>& values, std::vector<float>& scratch, size_t stride, uint32_t n) {
+        const size_t line = stride * n;
+        for (size_t t = 0; t < values.size(); t++) {
+            size_t base = t - t % line + t % stride; // first texel of t's line
+            size_t k = (t % line) / stride;
+            float sum = 0.0f;
+            for (size_t o = n - 2; o <= n + 2; o++) {
+                sum += values[base + ((k + o) & (n - 1)) * stride];
+            }
+            scratch[t] = sum * 0.2f;
+        }
+        values.swap(scratch);
+    }
+};
+
+#include "ClothFloatPreciseEnd.hpp"
@@ -5,6 +5,16 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "Debugging.hpp"
 #include "Vertex.hpp"
+#include "GpuProfiler.hpp"
+#include "CpuProfiler.hpp"
+#include "StartupTracer.hpp"
+#include "JobSystem.hpp"
+// sim headers pull in tiny_obj_loader.h, they have to come before TINYOBJLOADER_IMPLEMENTATION (see ClothMesh.hpp)
+#include "ClothEmbedding.hpp"
+#include "ClothLod.hpp"
+#include "ClothScenes.hpp"
+#include "ClothTearing.hpp"
+#include "CachePlayer.hpp"
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
 #include <glm/glm.hpp>
@@ -23,6 +33,7 @@
 //Check "TextureMapping/Images" section of vulkan tutorial
 
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
@@ -34,6 +45,7 @@
 #include <limits> // Necessary for std::numeric_limits
 #include <algorithm> // Necessary for std::clamp
 #include <fstream> // Necessary for file management
+#include <mutex>
 
 // This Vulkan Project was built using https://vulkan-tutorial.com/Introduction as a foundation
 // Claire Ogawa and Aidan Ream
@@ -114,11 +126,40 @@ const bool enableValidationLayers = true;
 
 class Application {
 public:
+    uint32_t maxFrames = 0; // 0 runs until the window is closed, otherwise exit after this many frames (CI runs)
+    std::string traceFile; // when set, cpu zones are recorded and dumped here as chrome trace json on exit
+    std::string startupReportFile; // when set, the per stage startup timings are written here as json
+    bool serialInit = false; // run the initVulkan() stages one after another instead of on the job system
+    std::string playbackFile; // baked .ccache to play back instead of showing MODEL_PATH
+    std::string playbackScene; // scene the cache was baked from (topology + uvs), defaults to the cache file name
+    uint32_t gridColumns = 0; // --grid: simulate a procedural hanging grid live instead of showing MODEL_PATH
+    uint32_t gridRows = 0;
+    float tearStrain = 0.0f; // --tear: the --grid cloth tears past this strain, 0 = no tearing
+    uint32_t lodLevels = 0; // --lod: simulation levels of the --grid cloth, 0 or 1 = always full resolution
+    float cameraDistance = 9.0f; // --camera-distance, up/down arrows move it while a --lod cloth runs
+    uint32_t embedLevels = 0; // --embed: the --grid cloth is drawn with 2^K times the cells per side, 0 = as simulated
+    std::string meshCacheDir = "../cache"; // --mesh-cache: parsed OBJ files and render embeddings, empty = always rebuild
+
     void run() {
-        initWindow();
+        CpuProfiler::setEnabled(!traceFile.empty());
+
+        startupTracer.start();
+        startupTracer.run("window", [&] { initWindow(); });
         initVulkan();
+        startupTracer.finish();
+
+        if (!startupReportFile.empty()) {
+            startupTracer.print(std::cout);
+            startupTracer.writeJson(startupReportFile);
+        }
+
         mainLoop();
         cleanup();
+
+        if (!traceFile.empty()) {
+            CpuProfiler::instance().writeChromeTrace(traceFile);
+            std::cout << "wrote cpu trace to " << traceFile << "\n";
+        }
     }
 
 private:
@@ -180,8 +221,59 @@ private:
     //Fences are used to pause the CPU until a GPU process is complete used 
     std::vector<VkFence> inFlightFences;
     uint32_t currentFrame = 0;
+    uint32_t framesDrawn = 0;
     bool framebufferResized = false; // in case driver doesnt catch resizing
 
+    // timestamp queries around the render pass and uploads
+    GpuProfiler gpuProfiler;
+    // timings of every initVulkan() stage
+    StartupTracer startupTracer;
+
+    JobSystem jobs;
+
+    // moving cloth (--play or --grid): vertex data lives in host visible buffers, one per frame in flight so
+    // a frame can be rewritten while the other is drawn
+    std::vector<VkBuffer> clothVertexBuffers;
+    std::vector<VkDeviceMemory> clothVertexBuffersMemory;
+    std::vector<void*> clothVertexBuffersMapped;
+
+    // live simulation (--grid), stepped once per drawn frame on the job system
+    ClothSolver solver;
+
+    // tearing (--tear): the index buffer is per frame and host visible too. A tear queues its new vertices and
+    // moved triangles for every frame in flight, each frame then rewrites only those parts of its own buffers.
+    ClothTearing tearing;
+    std::vector<VkBuffer> clothIndexBuffers;
+    std::vector<VkDeviceMemory> clothIndexBuffersMemory;
+    std::vector<void*> clothIndexBuffersMapped;
+    std::vector<std::vector<uint32_t>> pendingVertices;  // per frame in flight, vertices it hasn't written yet
+    std::vector<std::vector<uint32_t>> pendingTriangles; // same for triangles
+
+    // simulation lods (--lod): coarser grids step instead of `solver` when the cloth is small on screen,
+    // `solver` still gets every frame's positions so the buffers always hold the full mesh
+    ClothLod clothLod;
+    double lodSimulatedParticles = 0.0; // summed per simulated frame, for the average on exit
+    uint64_t lodFrames = 0;
+
+    // embedded render mesh (--embed): `vertices` is a finer grid than the solver's, deformed from the
+    // particles every frame (ClothEmbedding.hpp)
+    RenderEmbedding renderEmbedding;
+    std::vector<float> renderX, renderY, renderZ;
+
+    // cache playback (--play): the cloth comes from a baked cache instead of MODEL_PATH
+    CachePlayer cachePlayer;
+    std::vector<uint32_t> playbackBufferFrame; // cache frame currently in each cloth vertex buffer
+    std::vector<float> playbackPositions; // last frame picked up from the player (x..., y..., z...)
+    uint32_t playbackShownFrame = ~0u;
+    double playbackTime = 0.0; // seconds into the cache
+    bool playbackPaused = false;
+    std::chrono::high_resolution_clock::time_point playbackClock;
+
+    // single time command buffers share commandPool and graphicsQueue, which Vulkan requires us to
+    // synchronize ourselves, so only one thread records/submits one at a time (held from begin to end).
+    // createCommandBuffers() runs next to the upload stages and takes it to allocate from the pool too.
+    std::mutex singleTimeCommandsMutex;
+
     const std::vector<const char*> deviceExtensions = {
            VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
@@ -209,6 +301,12 @@ private:
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
         //glfwSetKeyCallback(window, keyCallback);
+        if (!playbackFile.empty()) {
+            glfwSetKeyCallback(window, playbackKeyCallback);
+        }
+        else if (lodCloth()) {
+            glfwSetKeyCallback(window, cameraKeyCallback);
+        }
     }
 
     static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -216,6 +314,32 @@ private:
         app->framebufferResized = true;
     }
 
+    // up/down arrows move the camera away from / toward the cloth, to watch the lod levels switch
+    static void cameraKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        if (action != GLFW_PRESS && action != GLFW_REPEAT) { return; }
+        auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+        if (key == GLFW_KEY_UP) { app->cameraDistance *= 1.1f; }
+        else if (key == GLFW_KEY_DOWN) { app->cameraDistance = std::max(1.0f, app->cameraDistance / 1.1f); }
+    }
+
+    // playback scrubbing: space pauses, left/right step a frame (paused) or a second, home restarts,
+    // 0-9 jump to that tenth of the cache
+    static void playbackKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+        if (action != GLFW_PRESS && action != GLFW_REPEAT) { return; }
+        auto app = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+        double frameTime = app->cachePlayer.frameTime();
+        double length = app->cachePlayer.frameCount() * frameTime;
+        double step = app->playbackPaused ? frameTime : 1.0;
+
+        if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) { app->playbackPaused = !app->playbackPaused; }
+        else if (key == GLFW_KEY_RIGHT) { app->playbackTime += step; }
+        else if (key == GLFW_KEY_LEFT) { app->playbackTime -= step; }
+        else if (key == GLFW_KEY_HOME) { app->playbackTime = 0.0; }
+        else if (key >= GLFW_KEY_0 && key <= GLFW_KEY_9) { app->playbackTime = length * (key - GLFW_KEY_0) / 10.0; }
+
+        app->playbackTime = std::fmod(app->playbackTime + length, length);
+    }
+
     // creates instance of vulkan (connection between app and the Vulkan library)
     void createInstance() {
 
@@ -724,11 +848,15 @@ private:
     }
 
     void createGraphicsPipeline() {
+        PROFILE_ZONE("createGraphicsPipeline");
         // retrieve spv bytecode compiled shaders
-        auto vertShaderCode = readFile("../resources/vert.spv");
-        auto fragShaderCode = readFile("../resources/frag.spv");
-        std::cout << "check length of vert buffer: " << vertShaderCode.size() << "\n";
-        std::cout << "check length of frag buffer: " << fragShaderCode.size() << "\n";
+        std::vector<char> vertShaderCode, fragShaderCode;
+        {
+            StartupTracer::Scope shaderScope(startupTracer, "shader read");
+            vertShaderCode = readFile("../resources/vert.spv");
+            fragShaderCode = readFile("../resources/frag.spv");
+            shaderScope.setBytes(vertShaderCode.size() + fragShaderCode.size()); // replaces the old buffer length prints
+        }
         
         // create module
         VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
@@ -1018,7 +1146,14 @@ private:
 
     }
 
+    // query pool for gpu timestamps, one slice per frame in flight plus one for uploads
+    void createGpuProfiler() {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+        gpuProfiler.init(physicalDevice, device, queueFamilyIndices.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT);
+    }
+
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        PROFILE_ZONE("recordCommandBuffer");
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         beginInfo.flags = 0; // how to use command buffer
@@ -1028,6 +1163,9 @@ private:
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
+        // reads back this slot's timestamps from MAX_FRAMES_IN_FLIGHT frames ago (fence already waited on)
+        gpuProfiler.beginFrame(commandBuffer, currentFrame);
+        uint32_t renderPassScope = gpuProfiler.beginScope(commandBuffer, "render pass");
 
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1066,12 +1204,12 @@ private:
 
         // Send in the vertex buffer to display our triangle
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-        VkBuffer vertexBuffers[] = { vertexBuffer };
+        VkBuffer vertexBuffers[] = { dynamicCloth() ? clothVertexBuffers[currentFrame] : vertexBuffer };
         VkDeviceSize offsets[] = { 0 };
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
         //vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
-        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, tearingCloth() ? clothIndexBuffers[currentFrame] : indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
         //vertecies.size() is how many vertices to draw
@@ -1079,6 +1217,7 @@ private:
         vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
        
         vkCmdEndRenderPass(commandBuffer);
+        gpuProfiler.endScope(commandBuffer, renderPassScope);
 
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to record command buffer!");
@@ -1098,6 +1237,7 @@ private:
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
         allocInfo.commandBufferCount = (uint32_t) commandBuffers.size(); // num buffers
 
+        std::lock_guard<std::mutex> lock(singleTimeCommandsMutex);
         if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate command buffers!");
         }
@@ -1163,6 +1303,8 @@ private:
     }
 
     VkCommandBuffer beginSingleTimeCommands() {
+        singleTimeCommandsMutex.lock(); // released in endSingleTimeCommands
+
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -1177,6 +1319,7 @@ private:
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
         vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        gpuProfiler.beginImmediate(commandBuffer);
 
         return commandBuffer;
     }
@@ -1191,16 +1334,20 @@ private:
 
         vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
         vkQueueWaitIdle(graphicsQueue);
+        gpuProfiler.endImmediate(); // already idle, reading the upload timestamps can't stall
 
         vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        singleTimeCommandsMutex.unlock();
     }
 
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
+        uint32_t uploadScope = gpuProfiler.beginScope(commandBuffer, "upload buffer");
         VkBufferCopy copyRegion{};
         copyRegion.size = size;
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+        gpuProfiler.endScope(commandBuffer, uploadScope);
 
         endSingleTimeCommands(commandBuffer);
     }
@@ -1225,6 +1372,7 @@ private:
             1
         };
 
+        uint32_t uploadScope = gpuProfiler.beginScope(commandBuffer, "upload image");
         vkCmdCopyBufferToImage(
             commandBuffer,
             buffer,
@@ -1233,6 +1381,7 @@ private:
             1,
             &region
         );
+        gpuProfiler.endScope(commandBuffer, uploadScope);
 
         endSingleTimeCommands(commandBuffer);
 
@@ -1308,6 +1457,11 @@ private:
     }
    
     void createVertexBuffer() {
+        if (dynamicCloth()) {
+            createClothVertexBuffers();
+            return;
+        }
+
         //Creates the vertex buffer
         //-- arbitrary memory dedicated so the GPU can access it to pass vertex data along
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
@@ -1335,7 +1489,130 @@ private:
         vkFreeMemory(device, stagingBufferMemory, nullptr);
     }
 
+    bool simulating() const { return gridColumns != 0; }
+    bool dynamicCloth() const { return simulating() || !playbackFile.empty(); }
+    bool tearingCloth() const { return simulating() && tearStrain > 0.0f; }
+    bool lodCloth() const { return simulating() && lodLevels > 1; }
+    bool embeddedCloth() const { return simulating() && embedLevels > 0; }
+
+    // same layout as the static vertex buffer, but host visible and persistently mapped like the uniform buffers,
+    // only positions get rewritten per frame
+    void createClothVertexBuffers() {
+        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+        vertexBuffer = VK_NULL_HANDLE;
+        vertexBufferMemory = VK_NULL_HANDLE;
+
+        clothVertexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        clothVertexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        clothVertexBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        playbackBufferFrame.assign(MAX_FRAMES_IN_FLIGHT, ~0u);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, clothVertexBuffers[i], clothVertexBuffersMemory[i]);
+
+            vkMapMemory(device, clothVertexBuffersMemory[i], 0, bufferSize, 0, &clothVertexBuffersMapped[i]);
+            memcpy(clothVertexBuffersMapped[i], vertices.data(), (size_t) bufferSize);
+        }
+    }
+
+    // picks the cache frame for the current playback time and writes it into this frame's vertex buffer
+    // (called after the frame's fence, so the gpu is done reading it). If the decoder hasn't caught up yet
+    // the last frame stays on screen.
+    void updatePlayback(uint32_t currentImage) {
+        PROFILE_ZONE("updatePlayback");
+        auto now = std::chrono::high_resolution_clock::now();
+        double elapsed = std::chrono::duration<double, std::chrono::seconds::period>(now - playbackClock).count();
+        playbackClock = now;
+
+        double frameTime = cachePlayer.frameTime();
+        double length = cachePlayer.frameCount() * frameTime;
+        if (!playbackPaused) {
+            playbackTime = std::fmod(playbackTime + elapsed, length);
+        }
+
+        uint32_t frame = std::min(cachePlayer.frameCount() - 1, static_cast<uint32_t>(playbackTime / frameTime));
+        if (frame != playbackShownFrame) {
+            if (const float* xyz = cachePlayer.frame(frame)) {
+                playbackPositions.assign(xyz, xyz + vertices.size() * 3);
+                playbackShownFrame = frame;
+            }
+        }
+
+        if (playbackBufferFrame[currentImage] != playbackShownFrame && !playbackPositions.empty()) {
+            const size_t n = vertices.size();
+            writeClothPositions(currentImage, playbackPositions.data(), playbackPositions.data() + n, playbackPositions.data() + 2 * n);
+            playbackBufferFrame[currentImage] = playbackShownFrame;
+        }
+    }
+
+    // one solver frame, then the new positions go into this frame's vertex buffer (its fence was waited on)
+    void simulateCloth(uint32_t currentImage) {
+        PROFILE_ZONE("simulateCloth");
+        if (lodCloth()) {
+            clothLod.step(solver);
+            lodSimulatedParticles += clothLod.simulatedParticles(solver);
+            lodFrames++;
+        }
+        else {
+            solver.step();
+        }
+        if (tearingCloth()) {
+            applyTears(currentImage);
+        }
+        if (embeddedCloth()) {
+            renderEmbedding.deform(solver, renderX.data(), renderY.data(), renderZ.data());
+            writeClothPositions(currentImage, renderX.data(), renderY.data(), renderZ.data());
+            return;
+        }
+        const ParticleStore& p = solver.particles;
+        writeClothPositions(currentImage, p.x.data(), p.y.data(), p.z.data());
+    }
+
+    // tears what the step overstretched. New vertices take the uv and color of the vertex they split from,
+    // then this frame writes every change it hasn't seen yet into its buffers, the other frame catches up
+    // when it comes around (a few vertices and triangles per tear, never the whole mesh)
+    void applyTears(uint32_t currentImage) {
+        PROFILE_ZONE("applyTears");
+        const TearEvents& events = tearing.update(solver);
+        for (size_t n = 0; n < events.newVertices.size(); n++) {
+            vertices[events.newVertices[n]] = vertices[events.sourceVertices[n]];
+        }
+        const ClothTriangles& tris = solver.triangles;
+        for (uint32_t t : events.triangles) {
+            indices[3 * t] = tris.a[t];
+            indices[3 * t + 1] = tris.b[t];
+            indices[3 * t + 2] = tris.c[t];
+        }
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            pendingVertices[i].insert(pendingVertices[i].end(), events.newVertices.begin(), events.newVertices.end());
+            pendingTriangles[i].insert(pendingTriangles[i].end(), events.triangles.begin(), events.triangles.end());
+        }
+
+        Vertex* mappedVertices = static_cast<Vertex*>(clothVertexBuffersMapped[currentImage]);
+        for (uint32_t v : pendingVertices[currentImage]) {
+            mappedVertices[v] = vertices[v];
+        }
+        uint32_t* mappedIndices = static_cast<uint32_t*>(clothIndexBuffersMapped[currentImage]);
+        for (uint32_t t : pendingTriangles[currentImage]) {
+            memcpy(mappedIndices + 3 * t, indices.data() + 3 * t, 3 * sizeof(uint32_t));
+        }
+        pendingVertices[currentImage].clear();
+        pendingTriangles[currentImage].clear();
+    }
+
+    void writeClothPositions(uint32_t currentImage, const float* x, const float* y, const float* z) {
+        Vertex* mapped = static_cast<Vertex*>(clothVertexBuffersMapped[currentImage]);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            mapped[i].pos = { x[i], y[i], z[i] };
+        }
+    }
+
     void createIndexBuffer() {
+        if (tearingCloth()) {
+            createClothIndexBuffers();
+            return;
+        }
+
         //Uses staging buffer for better memory copying preformance
         VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
@@ -1357,6 +1634,29 @@ private:
 
     }
 
+    // like createClothVertexBuffers(), tearing rewrites the triangles that moved to new vertices
+    void createClothIndexBuffers() {
+        VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+        indexBuffer = VK_NULL_HANDLE;
+        indexBufferMemory = VK_NULL_HANDLE;
+
+        clothIndexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        clothIndexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        clothIndexBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        pendingVertices.assign(MAX_FRAMES_IN_FLIGHT, {});
+        pendingTriangles.assign(MAX_FRAMES_IN_FLIGHT, {});
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, clothIndexBuffers[i], clothIndexBuffersMemory[i]);
+
+            vkMapMemory(device, clothIndexBuffersMemory[i], 0, bufferSize, 0, &clothIndexBuffersMapped[i]);
+            memcpy(clothIndexBuffersMapped[i], indices.data(), (size_t) bufferSize);
+            // room for a frame's worth of changes up front, so queueing tears doesn't allocate
+            pendingVertices[i].reserve(tearing.settings.maxTearsPerStep * 4);
+            pendingTriangles[i].reserve(tearing.settings.maxTearsPerStep * 16);
+        }
+    }
+
     void createDescriptorSetLayout() {
         //This is for sending Descriptor Sets to the GPU!
         //MVP is an example use case, where we are sending a package of uniforms we need on the other side
@@ -1403,6 +1703,7 @@ private:
     }
 
     void updateUniformBuffer(uint32_t currentImage) {
+        PROFILE_ZONE("updateUniformBuffer");
         static auto startTime = std::chrono::high_resolution_clock::now();
 
         auto currentTime = std::chrono::high_resolution_clock::now();
@@ -1411,13 +1712,27 @@ private:
         UniformBufferObject ubo{};
         //ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        if (dynamicCloth()) {
+            ubo.model = glm::mat4(1.0f); // simulated/baked positions are already in world space
+        }
 
 
         //ubo.model = glm::scale(ubo.model, glm::vec3(0.5, 0.5, 0.5)); 
-        ubo.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 9.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, 20.0f);
+        ubo.view = glm::lookAt(glm::vec3(0.0f, 0.0f, cameraDistance), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f, std::max(20.0f, 2.0f * cameraDistance));
         ubo.proj[1][1] *= -1;
 
+        if (lodCloth()) {
+            // proj[1][1] scales view space y at depth 1 to half the viewport height, so one meter at the
+            // cloth's depth covers this many pixels
+            glm::vec4 center = ubo.view * glm::vec4(clothLod.center(solver), 1.0f);
+            float pixelsPerMeter = std::abs(ubo.proj[1][1]) * 0.5f * swapChainExtent.height / std::max(0.1f, -center.z);
+            if (clothLod.select(solver, pixelsPerMeter)) {
+                std::cout << "cloth lod " << clothLod.activeLevel() << ": simulating " << clothLod.simulatedParticles(solver)
+                    << " of " << clothLod.sceneParticles(solver) << " particles\n";
+            }
+        }
+
         memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
     }
 
@@ -1492,17 +1807,25 @@ private:
     }
 
     void createTextureImage() {
+        PROFILE_ZONE("createTextureImage");
         // using command buffers, load an image and upload it into a Vulkan image object
         int texWidth, texHeight, texChannels;
         // use stbi_image to load in image to buffers
         //stbi_uc* pixels = stbi_load("../resources/textures/vox.png", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        stbi_uc* pixels = nullptr;
+        {
+            StartupTracer::Scope decodeScope(startupTracer, "texture decode");
+            pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        }
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
         if (!pixels) {
             throw std::runtime_error("failed to load texture image!");
         }
 
+        StartupTracer::Scope uploadScope(startupTracer, "texture upload");
+        uploadScope.setBytes(imageSize);
+
         // create buffer to copy pixels to
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferMemory;
@@ -1691,15 +2014,29 @@ private:
     }*/
 
     void loadModel() {
+        PROFILE_ZONE("loadModel");
+        if (!playbackFile.empty()) {
+            loadPlaybackMesh();
+            return;
+        }
+        if (simulating()) {
+            loadGridCloth();
+            return;
+        }
+
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
         std::string err;
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, MODEL_PATH.c_str())) {
-            throw std::runtime_error(err);
+        {
+            StartupTracer::Scope parseScope(startupTracer, "obj parse");
+            if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, MODEL_PATH.c_str())) {
+                throw std::runtime_error(err);
+            }
         }
 
+        StartupTracer::Scope dedupScope(startupTracer, "vertex dedup");
         std::unordered_map<Vertex, uint32_t> uniqueVertices{};
 
         std::cout << shapes.size() << "\n";
@@ -1731,34 +2068,147 @@ private:
         }
     }
 
+    // the cache only holds positions, topology and uvs come from rebuilding the scene it was baked from.
+    // Cloth vertices are welded, so render vertices map 1:1 to cache particles.
+    void loadPlaybackMesh() {
+        {
+            StartupTracer::Scope openScope(startupTracer, "cache open");
+            cachePlayer.open(playbackFile);
+        }
+
+        StartupTracer::Scope sceneScope(startupTracer, "cache scene");
+        std::string scene = playbackScene;
+        if (scene.empty()) {
+            // "out/bunny.ccache" -> "bunny"
+            size_t slash = playbackFile.find_last_of("/\\");
+            scene = playbackFile.substr(slash == std::string::npos ? 0 : slash + 1);
+            scene = scene.substr(0, scene.find('.'));
+        }
+
+        ClothSolver solver;
+        SceneOptions sceneOptions;
+        sceneOptions.meshCacheDir = meshCacheDir;
+        ClothMesh cloth = buildScene(scene, sceneOptions, solver);
+        if (cloth.vertexCount() != cachePlayer.particleCount()) {
+            throw std::runtime_error("cache particle count doesn't match scene " + scene + " (pass --scene)!");
+        }
+
+        vertices.resize(cloth.vertexCount());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            vertices[i].pos = cloth.positions[i];
+            vertices[i].color = { 1.0f, 1.0f, 1.0f };
+            vertices[i].texCoord = cloth.uvs[i];
+        }
+        indices = cloth.indices;
+        playbackClock = std::chrono::high_resolution_clock::now();
+    }
+
+    // procedural grid hanging from its top corners, written straight into the solver and the render arrays
+    // (no OBJ parsing, so even very large grids start quickly)
+    void loadGridCloth() {
+        StartupTracer::Scope gridScope(startupTracer, "grid cloth");
+        GridSettings grid;
+        grid.columns = gridColumns;
+        grid.rows = gridRows ? gridRows : gridColumns;
+        grid.width = 4.0f;
+        grid.height = 4.0f * grid.rows / grid.columns;
+        grid.vertical = true;
+        grid.center = glm::vec3(0.0f, 1.0f, 0.0f); // top edge near the top of the view
+        grid.diagonal = GridDiagonal::ALTERNATING;
+        grid.pins = GRID_PIN_TOP_CORNERS;
+
+        buildGridSolver(grid, SolverParams{}, solver);
+        solver.jobs = &jobs;
+        writeGridRenderMesh(grid, vertices, indices);
+
+        if (embeddedCloth()) {
+            if (tearingCloth()) { throw std::runtime_error("--embed can't be combined with --tear!"); }
+            // same rectangle with more cells, every render vertex lies on a simulated triangle
+            GridSettings render = grid;
+            render.columns = grid.columns << embedLevels;
+            render.rows = grid.rows << embedLevels;
+            writeGridRenderMesh(render, vertices, indices);
+            std::vector<glm::vec3> renderPositions(vertices.size()), rest(solver.particles.size());
+            for (size_t i = 0; i < vertices.size(); i++) { renderPositions[i] = vertices[i].pos; }
+            for (size_t i = 0; i < rest.size(); i++) { rest[i] = solver.particles.position(i); }
+            std::vector<uint32_t> simIndices;
+            solver.triangles.indices(simIndices);
+            renderEmbedding.buildCached(renderPositions, rest, simIndices, meshCacheDir,
+                "grid" + std::to_string(grid.columns) + "x" + std::to_string(grid.rows) + "_x" + std::to_string(embedLevels), &jobs);
+            for (auto* v : { &renderX, &renderY, &renderZ }) { v->resize(vertices.size()); }
+        }
+
+        if (lodCloth()) {
+            if (tearingCloth()) { throw std::runtime_error("--lod can't be combined with --tear!"); }
+            // exact coarse grids over the same rectangle, every level halves the cells per side
+            std::vector<ClothSolver> coarser(lodLevels - 1);
+            for (uint32_t k = 0; k < coarser.size(); k++) {
+                GridSettings coarse = grid;
+                coarse.columns = std::max(1u, grid.columns >> (k + 1));
+                coarse.rows = std::max(1u, grid.rows >> (k + 1));
+                buildGridSolver(coarse, SolverParams{}, coarser[k]);
+            }
+            LodSettings settings;
+            settings.levels = lodLevels;
+            clothLod.attach(solver, settings, std::move(coarser));
+        }
+
+        if (tearingCloth()) {
+            TearSettings settings;
+            settings.strain = tearStrain;
+            tearing.attach(solver, settings);
+            // spare particles get render vertices too (unreferenced until a tear hands them out)
+            vertices.resize(solver.particles.size(), Vertex{});
+        }
+    }
+
     // connects application to vulkan
+    // every stage goes through startupTracer so --startup-report shows where cold start time goes
+    // Once the logical device exists most stages only depend on a few others (the pipeline needs the render pass,
+    // uploads need the command pool...) so they are run as a dependency graph on the job system.
+    // Cold start then takes about as long as the slowest chain instead of the sum of every stage.
     void initVulkan() {
-        createInstance();
-        createSurface(); // platform agnostic with GLFW
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain(); //  get format, present mode, extent
-        createImageViews(); // sets up using images as textures
-        createRenderPass(); 
-        createDescriptorSetLayout();
-        createGraphicsPipeline(); 
-        createCommandPool();
-        createDepthResources();
-        createFramebuffers();
-        createTextureImage();
-        createTextureImageView();
-        createTextureSampler();
+        startupTracer.run("instance", [&] { createInstance(); });
+        startupTracer.run("surface", [&] { createSurface(); }); // platform agnostic with GLFW
+        startupTracer.run("pick device", [&] { pickPhysicalDevice(); });
+        startupTracer.run("logical device", [&] { createLogicalDevice(); });
+        // stays on the main thread, chooseSwapExtent() asks GLFW for the framebuffer size
+        startupTracer.run("swapchain", [&] { createSwapChain(); }); //  get format, present mode, extent
+
+        TaskGraph graph;
+        auto stage = [&](const char* name, void (Application::*create)(), std::initializer_list<uint32_t> dependencies) {
+            return graph.add(name, [this, name, create] { startupTracer.run(name, [&] { (this->*create)(); }); }, dependencies);
+        };
+
+        uint32_t imageViews = stage("image views", &Application::createImageViews, {}); // sets up using images as textures
+        uint32_t renderPass = stage("render pass", &Application::createRenderPass, {});
+        uint32_t setLayout = stage("descriptor set layout", &Application::createDescriptorSetLayout, {});
+        stage("graphics pipeline", &Application::createGraphicsPipeline, { renderPass, setLayout });
+        uint32_t commandPool = stage("command pool", &Application::createCommandPool, {});
+        uint32_t profiler = stage("gpu profiler", &Application::createGpuProfiler, {});
+        uint32_t depth = stage("depth resources", &Application::createDepthResources, {});
+        stage("framebuffers", &Application::createFramebuffers, { imageViews, renderPass, depth });
+        uint32_t texture = stage("texture image", &Application::createTextureImage, { commandPool, profiler });
+        uint32_t textureView = stage("texture image view", &Application::createTextureImageView, { texture });
+        uint32_t sampler = stage("texture sampler", &Application::createTextureSampler, {});
 
-        loadModel();
+        uint32_t model = stage("model load", &Application::loadModel, {}); // cpu only
 
-        createVertexBuffer();
-        createIndexBuffer();
-        createUniformBuffers();
+        stage("vertex buffer upload", &Application::createVertexBuffer, { model, commandPool, profiler });
+        stage("index buffer upload", &Application::createIndexBuffer, { model, commandPool, profiler });
+        uint32_t uniforms = stage("uniform buffers", &Application::createUniformBuffers, {});
 
-        createDescriptorPool();
-        createDescriptorSets();
-        createCommandBuffers();
-        createSyncObjects();
+        uint32_t pool = stage("descriptor pool", &Application::createDescriptorPool, {});
+        stage("descriptor sets", &Application::createDescriptorSets, { pool, setLayout, uniforms, textureView, sampler });
+        stage("command buffers", &Application::createCommandBuffers, { commandPool });
+        stage("sync objects", &Application::createSyncObjects, {});
+
+        if (serialInit) {
+            graph.runSerial();
+        }
+        else {
+            graph.run(jobs);
+        }
     }
 
     // renders a single frame 
@@ -1766,13 +2216,38 @@ private:
         while (!glfwWindowShouldClose(window)) {
             glfwPollEvents();
             drawFrame();
+
+            if (maxFrames != 0 && framesDrawn >= maxFrames) {
+                break;
+            }
+        }
+
+        vkDeviceWaitIdle(device);
+        gpuProfiler.printSummary(std::cout);
+
+        if (lodCloth() && lodFrames) {
+            std::cout << "cloth lod: " << lodSimulatedParticles / lodFrames << " of " << clothLod.sceneParticles(solver)
+                << " particles simulated on average, " << clothLod.switchCount() << " switches, "
+                << (clothLod.switchCount() ? clothLod.transferTimeNs() * 1e-3 / clothLod.switchCount() : 0.0) << " us per switch\n";
+        }
+
+        if (!playbackFile.empty()) {
+            CachePlayer::Stats stats = cachePlayer.getStats();
+            std::cout << "cache playback: " << stats.decodedFrames << " frames decoded, "
+                << (stats.decodedFrames ? stats.decodeNs * 1e-3 / stats.decodedFrames : 0.0) << " us/frame, "
+                << stats.misses << " late frames\n";
+            cachePlayer.close();
         }
     }
 
     void drawFrame() {
+        PROFILE_ZONE("drawFrame");
         //Pause CPU until fences are cleared so we have the async info we need to continue
         //Note: we need to create the fence signaled already so the first drawFrame call can get past this step
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        {
+            PROFILE_ZONE("waitForFence");
+            vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        }
         //Takes an array of fences and waits for one or all. VK_TRUE here indicates waiting for all, UINT64_MAX effectivly disables timeout
         vkResetFences(device, 1, &inFlightFences[currentFrame]); //Resets fence to unsignaled state
 
@@ -1791,6 +2266,12 @@ private:
 
         //Updates the MVP for model changes w/ time
         updateUniformBuffer(currentFrame);
+        if (!playbackFile.empty()) {
+            updatePlayback(currentFrame);
+        }
+        else if (simulating()) {
+            simulateCloth(currentFrame);
+        }
 
         // Only reset the fence if we are submitting work
         vkResetFences(device, 1, &inFlightFences[currentFrame]);
@@ -1816,8 +2297,11 @@ private:
         VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame]};
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+        {
+            PROFILE_ZONE("queueSubmit");
+            if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
         }
         
         //Submitting the result back to the swap chain
@@ -1835,7 +2319,10 @@ private:
         //presentInfo.pResults = nullptr; //Optional
         //checks for every individual swap chain if presentation was successful, we just have one so we can use return val
 
-        result = vkQueuePresentKHR(presentQueue, &presentInfo);     
+        {
+            PROFILE_ZONE("queuePresent");
+            result = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || result == framebufferResized) {
             framebufferResized = false;
@@ -1846,6 +2333,7 @@ private:
         }
 
         currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        framesDrawn++;
         
 
     }
@@ -1881,6 +2369,16 @@ private:
         vkDestroyBuffer(device, vertexBuffer, nullptr);
         vkFreeMemory(device, vertexBufferMemory, nullptr);
 
+        for (size_t i = 0; i < clothVertexBuffers.size(); i++) {
+            vkDestroyBuffer(device, clothVertexBuffers[i], nullptr);
+            vkFreeMemory(device, clothVertexBuffersMemory[i], nullptr);
+        }
+
+        for (size_t i = 0; i < clothIndexBuffers.size(); i++) {
+            vkDestroyBuffer(device, clothIndexBuffers[i], nullptr);
+            vkFreeMemory(device, clothIndexBuffersMemory[i], nullptr);
+        }
+
         //No more syncronization necessary
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
             vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
@@ -1888,6 +2386,7 @@ private:
             vkDestroyFence(device, inFlightFences[i], nullptr);
         }
 
+        gpuProfiler.destroy();
         vkDestroyCommandPool(device, commandPool, nullptr);
 
         vkDestroyDevice(device, nullptr); 
@@ -1898,10 +2397,72 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
     // create instance of sample app
     Application app;
 
+    // --frames N renders N frames and exits, handy for checking the gpu timings on a software driver
+    // --trace file.json records cpu zones and writes a chrome trace on exit
+    // --startup-report file.json writes the initVulkan() stage timings
+    // --serial-init runs the init stages one by one (to compare against the parallel startup)
+    // --play cache.ccache plays a baked simulation cache (clothBench --cache), --scene names the scene it came from
+    // --grid N or --grid NxM simulates a procedural N x M grid live, --tear S lets it tear past strain S
+    // --lod N gives the --grid cloth N simulation levels picked by its size on screen, --camera-distance D
+    // starts the camera D away (up/down arrows move it)
+    // --embed K draws the --grid cloth as a grid with 2^K times the cells per side, deformed from the simulated one
+    // --mesh-cache DIR keeps parsed OBJ files and --embed embeddings there (default ../cache, "" turns it off)
+    const char* usage = "usage: vulkanClothSim [--frames N] [--trace FILE] [--startup-report FILE] [--serial-init]\n"
+        "                      [--play CACHE [--scene NAME]] [--grid N|NxM] [--tear S] [--lod N]\n"
+        "                      [--camera-distance D] [--embed K] [--mesh-cache DIR]\n";
+    int i = 1;
+    try {
+        for (; i < argc; i++) {
+            if (std::string(argv[i]) == "--frames" && i + 1 < argc) {
+                app.maxFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (std::string(argv[i]) == "--trace" && i + 1 < argc) {
+                app.traceFile = argv[++i];
+            }
+            else if (std::string(argv[i]) == "--startup-report" && i + 1 < argc) {
+                app.startupReportFile = argv[++i];
+            }
+            else if (std::string(argv[i]) == "--serial-init") {
+                app.serialInit = true;
+            }
+            else if (std::string(argv[i]) == "--play" && i + 1 < argc) {
+                app.playbackFile = argv[++i];
+            }
+            else if (std::string(argv[i]) == "--scene" && i + 1 < argc) {
+                app.playbackScene = argv[++i];
+            }
+            else if (std::string(argv[i]) == "--grid" && i + 1 < argc) {
+                std::string size = argv[++i];
+                size_t x = size.find('x');
+                app.gridColumns = static_cast<uint32_t>(std::stoul(size.substr(0, x)));
+                app.gridRows = x == std::string::npos ? app.gridColumns : static_cast<uint32_t>(std::stoul(size.substr(x + 1)));
+            }
+            else if (std::string(argv[i]) == "--tear" && i + 1 < argc) {
+                app.tearStrain = std::stof(argv[++i]);
+            }
+            else if (std::string(argv[i]) == "--lod" && i + 1 < argc) {
+                app.lodLevels = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (std::string(argv[i]) == "--camera-distance" && i + 1 < argc) {
+                app.cameraDistance = std::stof(argv[++i]);
+            }
+            else if (std::string(argv[i]) == "--embed" && i + 1 < argc) {
+                app.embedLevels = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (std::string(argv[i]) == "--mesh-cache" && i + 1 < argc) {
+                app.meshCacheDir = argv[++i];
+            }
+        }
+    }
+    catch (const std::logic_error&) { // std::stoul/stof: not a number or out of range
+        std::cerr << "invalid value " << argv[i] << " for " << argv[i - 1] << "\n" << usage;
+        return EXIT_FAILURE;
+    }
+
     try {
         app.run();
     }